@@ -88,6 +88,9 @@ static int run(int argc, const char **argv) {
 		readbuf = NULL;
 	}
 
+	/* keep the device fed when the system is busy (needs root, plays normally otherwise) */
+	ec_setprio(ec_getpid(), ECSCHED_RT, ECSCHED_RT_MAX);
+
 	/* play sound */
 	ec_ioctl(fd, ECIO_SND_START, 0);
 
@@ -0,0 +1,110 @@
+/*
+ * Copyright 2025-2026, Elliot Kohlmyer
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <ec.h>
+
+#define MAXPROCS 128
+
+static ec_pinfo_t procs[MAXPROCS];
+static const char states[] = "RRPSZGW"; /* indexed by ECP_* */
+
+/* collect process info, returns number of processes */
+static int collect(void) {
+
+	int n = 0;
+	for (int pid = 0; n < MAXPROCS && (pid = ec_pinfo(pid, &procs[n])) >= 0; pid++)
+		n++;
+	return n;
+}
+
+/* sort by resident memory, largest first */
+static void sort(int n) {
+
+	for (int i = 1; i < n; i++) {
+
+		ec_pinfo_t p = procs[i];
+		int j = i;
+		for (; j > 0 && procs[j-1].mem_resident < p.mem_resident; j--)
+			procs[j] = procs[j-1];
+		procs[j] = p;
+	}
+}
+
+/* print process table */
+static void print(int n) {
+
+	printf("%5s %5s %c %3s %3s %4s %8s %7s %8s %8s %7s %9s %7s %s\n",
+	       "PID", "UID", 'S', "CPU", "PRI", "NI", "RES", "STACK", "HEAP", "DEV", "SWAP", "FAULTS", "MAJFLT", "NAME");
+
+	for (int i = 0; i < n; i++) {
+
+		ec_pinfo_t *p = &procs[i];
+		char state = (p->state >= 0 && p->state < (int)sizeof(states)-1)? states[p->state]: '?';
+
+		/* real-time priorities show up instead of the nice value */
+		char nice[8];
+		if (p->policy == ECSCHED_RT) snprintf(nice, sizeof(nice), "rt%d", p->prio);
+		else snprintf(nice, sizeof(nice), "%d", p->prio);
+
+		printf("%5d %5d %c %3d %3d %4s %7juK %6juK %7juK %7juK %6juK %9llu %7llu %s\n",
+		       p->pid, p->uid, state, p->cpu, p->level, nice,
+		       p->mem_resident >> 10, p->mem_stack >> 10, p->mem_heap >> 10,
+		       p->mem_device >> 10, p->mem_swapped >> 10,
+		       (unsigned long long)p->nfaults, (unsigned long long)p->nmajfaults,
+		       p->name[0]? p->name: "?");
+	}
+}
+
+int main(int argc, const char **argv) {
+
+	int opt;
+	int fhelp = 0, fmem = 0;
+	int delay = 0;
+	while ((opt = getopt(argc, argv, "hmt:")) != -1) {
+		switch (opt) {
+			case 'm':
+				fmem++;
+				break;
+			case 't':
+				delay = atoi(optarg);
+				if (delay <= 0) {
+
+					fprintf(stderr, "Invalid delay '%s'\n", optarg);
+					return 1;
+				}
+				break;
+			case 'h':
+				fhelp++;
+			default:
+				fprintf(stderr, "Usage: %s [-h] [-m] [-t seconds]\n", argv[0]);
+				return fhelp? 0: 1;
+		}
+	}
+
+	/* refresh until interrupted */
+	do {
+
+		int n = collect();
+		if (fmem) sort(n);
+
+		if (delay) printf("\e[2J\e[3J\e[H");
+		print(n);
+		fflush(stdout);
+
+		if (delay) {
+
+			ec_timeval_t tv = {
+				.sec = (uint64_t)delay,
+				.nsec = 0,
+			};
+			if (ec_sleepns(&tv) < 0) break;
+		}
+	} while (delay);
+
+	return 0;
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright 2025-2026, Elliot Kohlmyer
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <ec.h>
+
+#define DEFAULT_CALLS 100000
+
+/* get nanoseconds from time value */
+static uint64_t tvtons(ec_timeval_t *tv) {
+
+	return tv->sec * 1000000000 + tv->nsec;
+}
+
+/* time calls to the null system call */
+static uint64_t bench(uint32_t (*call)(uint32_t, uint32_t, uint32_t, uint32_t), int n) {
+
+	ec_timeval_t start, end;
+	ec_timens(&start);
+	for (int i = 0; i < n; i++)
+		call(ECN_NULL, 0, 0, 0);
+	ec_timens(&end);
+
+	return tvtons(&end) - tvtons(&start);
+}
+
+int main(int argc, const char **argv) {
+
+	int opt;
+	int n = DEFAULT_CALLS;
+	while ((opt = getopt(argc, argv, "hn:")) != -1) {
+		switch (opt) {
+			case 'n':
+				n = atoi(optarg);
+				break;
+			case 'h':
+			default:
+				fprintf(stderr, "Usage: %s [-h] [-n calls]\n", argv[0]);
+				return opt == 'h'? 0: 1;
+		}
+	}
+	if (n < 1) n = 1;
+
+	uint64_t ns = bench(ec_syscall3_int, n);
+	printf("int 0x80: %llu ns per call\n", (unsigned long long)(ns / (uint64_t)n));
+
+	if (!ec_has_sysenter()) {
+
+		printf("sysenter: not supported\n");
+		return 0;
+	}
+	ns = bench(ec_syscall3, n);
+	printf("sysenter: %llu ns per call\n", (unsigned long long)(ns / (uint64_t)n));
+	return 0;
+}
@@ -35,6 +35,23 @@ int main(int argc, const char **argv) {
 	       info.version[0], info.version[1], info.version[2],
 	       (info.mem_total - info.mem_free) >> 10, info.mem_total >> 10);
 
+	if (info.nswitches)
+		printf("Task switches: %llu (%llu cycles avg.)\n", (unsigned long long)info.nswitches, (unsigned long long)(info.switch_cycles / info.nswitches));
+
+	if (info.swap_total)
+		printf("Swap usage: %juK/%juK\n", (info.swap_total - info.swap_free) >> 10, info.swap_total >> 10);
+
+	if (info.zram_stored) {
+
+		/* zero filled pages take no room at all */
+		unsigned long long ratio = info.zram_compr? (unsigned long long)info.zram_stored * 100 / info.zram_compr: 0;
+		printf("Compressed pool: %juK in %juK (%juK compressed, ratio %llu.%02llu)\n",
+		       info.zram_stored >> 10, info.zram_used >> 10, info.zram_compr >> 10,
+		       ratio / 100, ratio % 100);
+	}
+	if (info.zram_faults)
+		printf("Compressed pool faults: %llu (%llu cycles avg.)\n", (unsigned long long)info.zram_faults, (unsigned long long)(info.zram_fault_cycles / info.zram_faults));
+
 	if (fcolor) {
 
 		fputc('\n', stdout);
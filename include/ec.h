@@ -47,8 +47,15 @@ typedef int ec_mode_t;
 #define ECN_KINFO 22
 #define ECN_GETUSER 23
 #define ECN_SETUSER 24
+#define ECN_FORK 25
+#define ECN_MMAP 26
+#define ECN_MUNMAP 27
+#define ECN_MPROTECT 28
+#define ECN_PINFO 29
+#define ECN_SETPRIO 30
+#define ECN_NICE 31
 
-#define ECN_COUNT 25
+#define ECN_COUNT 32
 
 #define EC_PATHSZ 256
 
@@ -66,6 +73,20 @@ extern uint32_t ec_syscall3(uint32_t i, uint32_t a, uint32_t b, uint32_t c);
  */
 extern uint64_t ec_syscall3r2(uint32_t i, uint32_t a, uint32_t b, uint32_t c);
 
+/*
+ * Both of the above use sysenter where the cpu has it:
+ *   eax = i, ebx = a, ecx = b, edx = c, ebp = user stack, esi = return address
+ *   ret = (esi << 32) | eax (ecx and edx are lost)
+ * Otherwise they go through int 0x80, which this always does.
+ */
+extern uint32_t ec_syscall3_int(uint32_t i, uint32_t a, uint32_t b, uint32_t c);
+
+/*
+ * Check if system calls go through sysenter.
+ *   ret = Nonzero if they do
+ */
+extern int ec_has_sysenter(void);
+
 #define __ec_seterrno(rtype, call) rtype res = (rtype)call;\
 	if (res < 0) { errno = -(int)res; return -1; }\
 	return res
@@ -206,6 +227,25 @@ extern int ec_gettimeofday(ec_timeval_t *tv);
  */
 extern int ec_timens(ec_timeval_t *tv);
 
+/*
+ * Time page, mapped read-only into every task at EC_TIME_ADDR.
+ * ec_timens and ec_gettimeofday read it instead of making a system call.
+ * The kernel makes seq odd while it changes the page, readers retry until
+ * they see the same even seq before and after reading. With tsc set the
+ * time since boot is ns + (((rdtsc - tsc_base) * mult) >> shift), else ns.
+ */
+typedef struct ec_timepage {
+	uint32_t seq; /* odd while being updated */
+	uint32_t tsc; /* nonzero if the time stamp counter is used */
+	uint64_t ns; /* nanoseconds since boot (when the counter read tsc_base) */
+	uint64_t tsc_base; /* time stamp counter at ns */
+	uint32_t mult; /* nanoseconds per cycle << shift */
+	uint32_t shift;
+	uint64_t wall; /* nanoseconds since the epoch at boot */
+} ec_timepage_t;
+
+#define EC_TIME_ADDR ((const volatile ec_timepage_t *)0x6000)
+
 /*
  * Check if a file is a teletype.
  *   ebx/fd = File descriptor
@@ -285,6 +325,7 @@ typedef struct ec_dirent {
 	int flags; /* file flags */
 	uint32_t mask; /* file mode mask */
 	void *_data; /* internal data */
+	uint32_t _gen; /* directory cache generation of internal data */
 } ec_dirent_t;
 
 extern int ec_readdir(const char *path, ec_dirent_t *dent);
@@ -309,6 +350,15 @@ typedef struct ec_kinfo {
 	uint8_t version[3]; /* operating system version */
 	uintptr_t mem_free; /* amount of free system memory */
 	uintptr_t mem_total; /* amount of total system memory */
+	uint64_t nswitches; /* number of task switches */
+	uint64_t switch_cycles; /* cpu cycles spent switching tasks */
+	uintptr_t swap_total; /* amount of swap space */
+	uintptr_t swap_free; /* amount of free swap space */
+	uintptr_t zram_stored; /* amount of memory held by the compressed pool (before compression) */
+	uintptr_t zram_compr; /* compressed size of it */
+	uintptr_t zram_used; /* amount of memory used by the compressed pool */
+	uint64_t zram_faults; /* pages read back from the compressed pool */
+	uint64_t zram_fault_cycles; /* cpu cycles spent reading them */
 } ec_kinfo_t;
 
 extern void ec_kinfo(ec_kinfo_t *info);
@@ -337,6 +387,134 @@ extern int ec_getuser(ec_uinfo_t *info);
  */
 extern int ec_setuser(const char *name, const char *pswd);
 
+/*
+ * Clone the current process.
+ *   eax (return) = Process id of the child in the parent, zero in the child, negative on error
+ *
+ * The child gets a copy-on-write copy of the address space and shares the open files of the parent.
+ */
+extern int ec_fork(void);
+
+/*
+ * Map a file or anonymous memory.
+ *   ebx/args = Mapping arguments
+ *   eax (return) = Address of mapping if successful, negative on error
+ *
+ * Pages are filled in on first access. Anonymous mappings (ECM_MAP_ANON, fd is ignored) are
+ * zero filled. Shared file mappings are read-only and share the cached file pages between
+ * processes; private mappings are copied on the first write. Writes to the file are not
+ * reflected in existing mappings. Shared anonymous memory stays shared with forked children.
+ * Without ECM_MAP_FIXED, addr is ignored and a free area is picked.
+ */
+#define ECM_PROT_NONE 0x0
+#define ECM_PROT_READ 0x1
+#define ECM_PROT_WRITE 0x2
+#define ECM_PROT_EXEC 0x4
+
+#define ECM_MAP_SHARED 0x1
+#define ECM_MAP_PRIVATE 0x2
+#define ECM_MAP_FIXED 0x10
+#define ECM_MAP_ANON 0x20
+
+#define ECM_FAILED ((void *)-1)
+
+typedef struct ec_mmap_args {
+	void *addr; /* requested address (page aligned) */
+	size_t len; /* length of mapping */
+	int prot; /* protection flags */
+	int flags; /* mapping flags */
+	int fd; /* file descriptor */
+	ec_off_t offset; /* offset in file (page aligned) */
+} ec_mmap_args_t;
+
+extern void *ec_mmap(void *addr, size_t len, int prot, int flags, int fd, ec_off_t offset);
+
+/*
+ * Remove memory mappings.
+ *   ebx/addr = Start address (page aligned)
+ *   ecx/len = Length of range
+ *   eax (return) = Zero if successful, negative on error
+ *
+ * Mappings partially inside of the range are cut down to the part outside of it.
+ */
+extern int ec_munmap(void *addr, size_t len);
+
+/*
+ * Change protection of mapped memory.
+ *   ebx/addr = Start address (page aligned)
+ *   ecx/len = Length of range
+ *   edx/prot = Protection flags
+ *   eax (return) = Zero if successful, negative on error
+ *
+ * The whole range has to be mapped with ec_mmap. ECM_PROT_EXEC is implied by ECM_PROT_READ.
+ */
+extern int ec_mprotect(void *addr, size_t len, int prot);
+
+/*
+ * Get information about a process.
+ *   ebx/pid = Lowest process id to look at
+ *   ecx/info = Process information to fill out
+ *   eax (return) = Process id of the first process from pid on if successful, negative on error
+ *
+ * Memory sizes are in bytes. Resident memory counts frames shared with other processes
+ * in each of them; the zero page and device memory are left out.
+ */
+#define EC_PINFO_NAMESZ 32
+
+#define ECP_READY 0
+#define ECP_RUNNING 1
+#define ECP_PAUSED 2
+#define ECP_SLEEPING 3
+#define ECP_TERMINATED 4
+#define ECP_SIGNALED 5
+#define ECP_PWAIT 6
+
+typedef struct ec_pinfo {
+	char name[EC_PINFO_NAMESZ]; /* name of executable */
+	int pid; /* process id */
+	int uid; /* user id */
+	int state; /* process state (ECP_*) */
+	int policy; /* scheduling class (ECSCHED_*) */
+	int prio; /* nice value, or real-time priority */
+	int level; /* current run queue (lower runs first) */
+	int cpu; /* cpu running or last running the process */
+	uintptr_t mem_resident; /* memory in frames mapped */
+	uintptr_t mem_stack; /* resident stack memory */
+	uintptr_t mem_heap; /* memory between end of program and break point */
+	uintptr_t mem_device; /* device memory mapped (framebuffers and such) */
+	uintptr_t mem_swapped; /* memory in swap */
+	uint64_t nfaults; /* page faults taken */
+	uint64_t nmajfaults; /* page faults that read from swap */
+} ec_pinfo_t;
+
+extern int ec_pinfo(int pid, ec_pinfo_t *info);
+
+/*
+ * Set scheduling class and priority of a process.
+ *   ebx/pid = Process id
+ *   ecx/policy = Scheduling class (ECSCHED_*)
+ *   edx/prio = Nice value (ECSCHED_NICE_MIN to ECSCHED_NICE_MAX) or real-time priority (1 to ECSCHED_RT_MAX, higher runs first)
+ *   eax (return) = Zero if successful, negative on error
+ *
+ * Only root can raise a priority, switch to ECSCHED_RT or change processes of other users.
+ * Children inherit the scheduling class and priority.
+ */
+#define ECSCHED_NORMAL 0 /* time shared, priority follows the nice value and cpu usage */
+#define ECSCHED_RT 1 /* real-time, runs before all normal processes */
+
+#define ECSCHED_NICE_MIN -20
+#define ECSCHED_NICE_MAX 19
+#define ECSCHED_RT_MAX 4
+
+extern int ec_setprio(int pid, int policy, int prio);
+
+/*
+ * Change nice value of the current process.
+ *   ebx/inc = Amount to add (the result is clamped to ECSCHED_NICE_MIN and ECSCHED_NICE_MAX)
+ *   eax (return) = Zero if successful, negative on error
+ */
+extern int ec_nice(int inc);
+
 /*
  * Change current process working directory.
  *   path = Directory path
@@ -82,6 +82,10 @@ typedef struct elf32_section_header {
 /* program header */
 #define ELF_PH_TYPE_LOAD 1
 
+#define ELF_PH_FLAG_X 0x1
+#define ELF_PH_FLAG_W 0x2
+#define ELF_PH_FLAG_R 0x4
+
 typedef struct elf32_program_header {
 	elf32_word_t type; /* type of program header */
 	elf32_off_t offset; /* file offset of data */
@@ -100,6 +100,7 @@ typedef struct boot_cmdline {
 	bool quiet; /* do not display log messages under info or warning */
 	char init_profile[BOOT_CMDLINE_PARAM_MAX_CHARS]; /* profile for init to load */
 	char ramfs_mount[BOOT_CMDLINE_PARAM_MAX_CHARS]; /* mountpoint for ramfs */
+	uint32_t zram_size; /* capacity of compressed swap pool in MiB (0 if disabled) */
 } boot_cmdline_t;
 
 extern boot_protocol_t boot_protocol;
@@ -0,0 +1,23 @@
+/*
+ * Copyright 2025-2026, Elliot Kohlmyer
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef ECLAIR_CLOCK_H
+#define ECLAIR_CLOCK_H
+
+#include <kernel/types.h>
+#include <kernel/mm/paging.h>
+
+#define CLOCK_CALIBRATE_HZ 20 /* length of the pit interval measured (50 ms) */
+
+/* functions */
+extern void clock_init(void); /* measure time stamp counter rate and read the wall clock */
+extern bool clock_has_tsc(void); /* check if the clock runs from the time stamp counter */
+extern uint64_t clock_ns(void); /* get monotonic nanoseconds since boot */
+extern uint64_t clock_wall_ns(void); /* get nanoseconds since the epoch */
+extern void clock_advance(uint64_t ns); /* advance clock by a timer tick (ignored with a time stamp counter) */
+extern page_frame_id_t clock_get_page_frame(void); /* get frame of the time page, zero before clock_init */
+extern uint64_t clock_cycles_to_ns(uint64_t cycles); /* convert a difference of cpu_rdtsc timestamps to nanoseconds */
+
+#endif /* ECLAIR_CLOCK_H */
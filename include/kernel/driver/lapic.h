@@ -0,0 +1,66 @@
+/*
+ * Copyright 2025-2026, Elliot Kohlmyer
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef ECLAIR_DRIVER_LAPIC_H
+#define ECLAIR_DRIVER_LAPIC_H
+
+#include <kernel/types.h>
+
+#define LAPIC_MSR_BASE 0x1b
+#define LAPIC_MSR_BASE_ENABLE 0x800
+#define LAPIC_DEFAULT_BASE 0xfee00000
+
+/* registers (byte offsets) */
+#define LAPIC_REG_ID 0x20
+#define LAPIC_REG_VERSION 0x30
+#define LAPIC_REG_TPR 0x80
+#define LAPIC_REG_EOI 0xb0
+#define LAPIC_REG_SVR 0xf0
+#define LAPIC_REG_ESR 0x280
+#define LAPIC_REG_ICR_LO 0x300
+#define LAPIC_REG_ICR_HI 0x310
+#define LAPIC_REG_LVT_TIMER 0x320
+#define LAPIC_REG_LVT_LINT0 0x350
+#define LAPIC_REG_LVT_LINT1 0x360
+#define LAPIC_REG_LVT_ERROR 0x370
+#define LAPIC_REG_TIMER_INIT 0x380
+#define LAPIC_REG_TIMER_CUR 0x390
+#define LAPIC_REG_TIMER_DIV 0x3e0
+
+#define LAPIC_SVR_ENABLE 0x100
+
+/* timer */
+#define LAPIC_TIMER_DIV16 0x3
+#define LAPIC_TIMER_MAX 0xffffffff
+#define LAPIC_TIMER_CALIBRATE_HZ 100 /* length of the pit interval measured (10 ms) */
+
+/* interrupt command and local vector table bits */
+#define LAPIC_ICR_FIXED 0x0
+#define LAPIC_ICR_NMI 0x400
+#define LAPIC_ICR_INIT 0x500
+#define LAPIC_ICR_STARTUP 0x600
+#define LAPIC_ICR_PENDING 0x1000
+#define LAPIC_ICR_ASSERT 0x4000
+#define LAPIC_ICR_LEVEL 0x8000
+#define LAPIC_ICR_OTHERS 0xc0000 /* all cpus except the sender */
+#define LAPIC_LVT_EXTINT 0x700
+#define LAPIC_LVT_MASKED 0x10000
+
+/* functions */
+extern void lapic_init_memory(void); /* reserve page for the registers before heap */
+extern bool lapic_init(uint32_t base); /* map local apic registers and enable the apic of the boot processor */
+extern void lapic_init_ap(void); /* enable the apic of an application processor */
+extern bool lapic_present(void); /* check if the local apic is in use */
+extern uint32_t lapic_id(void); /* get apic id of running cpu */
+extern void lapic_eoi(void); /* signal end of interrupt */
+extern void lapic_send_ipi(uint32_t apicid, uint32_t vector); /* send interrupt to one cpu */
+extern void lapic_send_others(uint32_t vector); /* send interrupt to all other cpus */
+extern void lapic_send_init(uint32_t apicid); /* reset cpu into wait-for-startup state */
+extern void lapic_send_startup(uint32_t apicid, uint32_t addr); /* start cpu in real mode at page aligned address */
+extern bool lapic_timer_init(void); /* measure timer rate against the pit (interrupts disabled by caller) */
+extern void lapic_timer_set(uint64_t ns); /* fire timer interrupt once after nanoseconds (clamped to the longest interval) */
+extern void lapic_timer_stop(void); /* stop timer of running cpu */
+
+#endif /* ECLAIR_DRIVER_LAPIC_H */
@@ -17,6 +17,12 @@
 #define PIT_PORT_CHANNEL1 0x41
 #define PIT_PORT_CHANNEL2 0x42
 #define PIT_PORT_MODE 0x43
+#define PIT_PORT_GATE 0x61 /* channel 2 gate and speaker control */
+
+/* gate port bits */
+#define PIT_GATE_CH2 0x1
+#define PIT_GATE_SPEAKER 0x2
+#define PIT_GATE_OUT2 0x20
 
 /* modes */
 #define PIT_CHANNEL0 0
@@ -49,6 +55,8 @@ typedef void (*pit_callback_t)(idt_regs_t *); /* timer interrupt callback */
 extern void pit_init(void); /* initialize pit */
 extern void pit_delay(uint32_t div); /* delay */
 extern void pit_delay_ms(uint32_t ms); /* delay milliseconds */
+extern void pit_wait(uint16_t count); /* busy-wait for count on channel 2, works with interrupts disabled */
+extern void pit_stop(void); /* stop channel 0 interrupts */
 extern void pit_set_mode(uint8_t mode); /* set operating mode */
 extern void pit_set_channel(uint8_t ch, uint8_t val); /* set value of channel */
 extern void pit_set_callback(pit_callback_t cb); /* set timer callback */
@@ -25,6 +25,8 @@
 #define RTC_CMOS_REG_STATUS_A 0x0a
 #define RTC_CMOS_REG_STATUS_B 0x0b
 
+#define RTC_STATUS_A_UIP 0x80 /* update in progress */
+
 typedef struct rtc_cmos_regs {
 	uint8_t seconds,
 		minutes,
@@ -47,6 +49,7 @@ extern void rtc_init(void); /* initialize rtc */
 extern void rtc_set_callback(rtc_callback_t _cb); /* set callback */
 extern void rtc_get_registers(rtc_cmos_regs_t *regs); /* get register values */
 extern uint64_t rtc_get_time(rtc_cmos_regs_t *regs); /* get time from register values */
+extern uint64_t rtc_read(void); /* read seconds since the epoch, waiting for a consistent reading */
 
 /* enable next interrupt to occur */
 static inline void rtc_enable_next_interrupt(void) {
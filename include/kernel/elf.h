@@ -7,8 +7,20 @@
 #define ECLAIR_ELF_H
 
 #include <kernel/types.h>
+#include <kernel/mm/paging.h>
+#include <kernel/vfs/fs.h>
+
+/* cached read-only segment of an executable */
+typedef struct elf_text {
+	uint32_t offset; /* file offset of data */
+	page_id_t start; /* first page */
+	uint32_t count; /* number of pages */
+	struct elf_text *next; /* next segment */
+	page_frame_id_t frames[]; /* frames holding the segment (zero if never loaded) */
+} elf_text_t;
 
 /* functions */
 extern int elf_load_task(const char *path, const char **argv, const char **envp, bool freeargs); /* load an executable */
+extern void elf_drop_text(fs_node_t *node); /* drop cached segments of an executable */
 
 #endif /* ECLAIR_ELF_H */
@@ -32,6 +32,7 @@ typedef struct mbr {
 /* mbr file system identifiers */
 #define MBR_FS_LINUX 0x83
 #define MBR_FS_ECFS 0xec
+#define MBR_SWAP 0x82 /* linux swap partition */
 
 /* mbr fs driver info */
 typedef struct mbr_driver {
@@ -45,5 +46,6 @@ extern void mbr_print(mbr_t *mbr); /* print info from mbr */
 extern fs_node_t *mbr_fs_mount(fs_node_t *node, device_t *dev, mbr_ent_t *ent); /* try to mount mbr partition */
 extern fs_node_t *mbr_fs_probe(device_t *dev, mbr_t *mbr); /* probe mbr for file systems */
 extern void mbr_fs_mount_root(void); /* search for root filesystem */
+extern void mbr_swap_probe(void); /* search storage devices for a swap partition */
 
 #endif /* ECLAIR_FS_MBR_H */
@@ -48,9 +48,15 @@ typedef void (*idt_isr_t)(idt_regs_t *regs); /* custom handler */
 #define IDT_ISR_PGFAULT 14
 
 #define IDT_INT_SYSCALL 0x80
+#define IDT_INT_TIMER 0xf0 /* local apic timer */
+#define IDT_INT_RESCHED 0xf1 /* run queue of the cpu changed */
+#define IDT_INT_FLUSH 0xf2 /* kernel pages were unmapped */
+#define IDT_INT_SPURIOUS 0xff /* local apic spurious interrupt */
 
 /* functions */
 extern void idt_init(void); /* initialize */
+extern void idt_load(void); /* load idt on running cpu */
+extern void idt_load_sysenter(void); /* set up sysenter on running cpu if it has it */
 extern void idt_enable(void); /* enable interrupts */
 extern void idt_set_gate(uint32_t n, void *p, uint8_t tp); /* set handler */
 extern void idt_isr_handler(idt_regs_t *regs); /* main isr handler */
@@ -58,6 +64,7 @@ extern void idt_irq_handler(idt_regs_t *regs); /* main irq handler */
 extern void idt_int_handler(idt_regs_t *regs); /* main int handler */
 extern void idt_set_isr_callback(uint32_t n, idt_isr_t isr); /* set isr callback */
 extern void idt_set_irq_callback(uint32_t n, idt_isr_t isr); /* set irq callback */
+extern void idt_set_int_callback(uint32_t n, idt_isr_t isr); /* set software or inter-processor interrupt callback */
 extern void idt_send_eoi(void); /* send eoi command to first pic */
 extern void idt_disable_irq_eoi(uint32_t n); /* disable automatic eoi command for irqs */
 
@@ -122,5 +129,11 @@ extern void irq14();
 extern void irq15();
 
 extern void sysint();
+extern void sysenter();
+
+extern void apictimer();
+extern void ipiresched();
+extern void ipiflush();
+extern void ipispurious();
 
 #endif /* ECLAIR_IDT_H */
@@ -0,0 +1,42 @@
+/*
+ * Copyright 2025-2026, Elliot Kohlmyer
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef ECLAIR_IO_CPU_H
+#define ECLAIR_IO_CPU_H
+
+#include <kernel/types.h>
+
+/* cpuid leaf 1 edx features */
+#define CPU_FEATURE_PSE 0x8
+#define CPU_FEATURE_TSC 0x10
+#define CPU_FEATURE_MSR 0x20
+#define CPU_FEATURE_APIC 0x200
+#define CPU_FEATURE_SEP 0x800
+#define CPU_FEATURE_PGE 0x2000
+
+/* model specific registers */
+#define CPU_MSR_SYSENTER_CS 0x174
+#define CPU_MSR_SYSENTER_ESP 0x175
+#define CPU_MSR_SYSENTER_EIP 0x176
+
+/* control register 4 */
+#define CPU_CR4_PSE 0x10
+#define CPU_CR4_PGE 0x80
+
+/* eflags */
+#define CPU_EFLAGS_IF 0x200
+
+extern void cpu_cpuid(uint32_t leaf, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx);
+extern bool cpu_has_feature(uint32_t feature);
+extern bool cpu_has_sysenter(void); /* check if sysenter works (early cpus report it without having it) */
+extern uint64_t cpu_rdtsc(void);
+extern uint64_t cpu_rdmsr(uint32_t msr);
+extern void cpu_wrmsr(uint32_t msr, uint64_t value);
+extern uint32_t cpu_get_cr4(void);
+extern void cpu_set_cr4(uint32_t cr4);
+extern uint32_t cpu_irq_save(void); /* disable interrupts, returning the previous eflags */
+extern void cpu_irq_restore(uint32_t eflags); /* enable interrupts again if they were enabled */
+
+#endif /* ECLAIR_IO_CPU_H */
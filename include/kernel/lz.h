@@ -0,0 +1,24 @@
+/*
+ * Copyright 2025-2026, Elliot Kohlmyer
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef ECLAIR_LZ_H
+#define ECLAIR_LZ_H
+
+#include <kernel/types.h>
+
+/*
+ * Byte oriented LZ77 in the style of LZ4. Each sequence is a token byte
+ * (literal count in the high nibble, match length minus LZ_MINMATCH in the
+ * low nibble, 15 meaning more length bytes follow), the literals, and a
+ * 16-bit little endian match offset. The last sequence has no match.
+ */
+#define LZ_MINMATCH 4 /* shortest match encoded */
+#define LZ_MAXLEN 0xffff /* longest input (offsets are 16-bit) */
+
+/* functions */
+extern size_t lz_compress(const void *src, size_t len, void *dst, size_t cap); /* compress buffer, returns size or 0 if it doesn't fit */
+extern size_t lz_decompress(const void *src, size_t len, void *dst, size_t cap); /* decompress buffer, returns size or 0 if it is corrupt */
+
+#endif /* ECLAIR_LZ_H */
@@ -0,0 +1,24 @@
+/*
+ * Copyright 2025-2026, Elliot Kohlmyer
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef ECLAIR_MM_FILEMAP_H
+#define ECLAIR_MM_FILEMAP_H
+
+#include <kernel/types.h>
+#include <kernel/mm/paging.h>
+#include <kernel/vfs/fs.h>
+
+/* cached pages of a mapped file */
+typedef struct filemap {
+	uint32_t npages; /* number of page slots */
+	uint32_t nloaded; /* number of loaded pages */
+	page_frame_id_t frames[]; /* frame holding each file page (0 if not loaded) */
+} filemap_t;
+
+/* functions */
+extern page_frame_id_t filemap_get(fs_node_t *node, uint32_t index); /* get frame of file page, reading it in if needed */
+extern void filemap_drop(fs_node_t *node); /* release cached pages of file */
+
+#endif /* ECLAIR_MM_FILEMAP_H */
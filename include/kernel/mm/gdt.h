@@ -7,6 +7,9 @@
 #define ECLAIR_MM_GDT_H
 
 #include <kernel/types.h>
+#include <kernel/smp.h>
+
+#define GDT_ENTRY_STACKSZ 1024 /* stack right below the tss that sysenter starts on */
 
 /* main descriptor */
 typedef struct gdt_descriptor {
@@ -36,6 +39,7 @@ enum {
 	GDT_SEGMENT_US_CODE,
 	GDT_SEGMENT_US_DATA,
 	GDT_SEGMENT_TSS,
+	GDT_SEGMENT_CPU,
 
 	GDT_SEGMENT_COUNT,
 };
@@ -88,10 +92,8 @@ typedef struct gdt_tss {
 	uint16_t iomap_base;
 } __attribute__((packed)) gdt_tss_t;
 
-extern gdt_tss_t gdt_tss;
-
 /* functions */
-extern void gdt_init(void);
-extern void gdt_flush_tss(void);
+extern void gdt_init(cpu_t *cpu); /* initialize and load gdt of cpu */
+extern void gdt_flush_tss(void); /* load task register */
 
 #endif /* ECLAIR_MM_GDT_H */
@@ -9,24 +9,66 @@
 #include <kernel/types.h>
 #include <kernel/mm/paging.h>
 
+/* size classes (bin i holds free blocks of 2^(i+HEAP_MINSHIFT) bytes and up) */
+#define HEAP_MINSHIFT 4
+#define HEAP_NBINS 12
+
+#define HEAP_LARGE 0x2000 /* allocations of this size and up map whole pages */
+
+/* virtual address ranges (page ids) */
+#define HEAP_LARGE_START 0xE0000
+#define HEAP_LARGE_END 0xFF000
+
+#define HEAP_PAGE_LAST PAGE_FLAG_AVL0 /* last page of a large allocation */
+
+#define HEAP_REPORT_SIZE 0x8000 /* size of report read from /dev/kheap */
+
+/* allocation tracing (build with kernel-heaptrace) */
+#define HEAP_TRACE_SLOTS 4096 /* tracked allocations (power of two) */
+#define HEAP_TRACE_CALLERS 64 /* callers summed up in report */
+
+typedef size_t heap_tag_t; /* boundary tag (size and used bit) */
+
+/* free block */
 typedef struct heap_block {
-	size_t size; /* size of block */
-	bool avail; /* available */
-	page_id_t page; /* page that the beginning of the block lies on */
-	struct heap_block *prev; /* previous */
-	struct heap_block *next; /* next */
+	heap_tag_t tag; /* header tag */
+	struct heap_block *prev; /* previous free block in bin */
+	struct heap_block *next; /* next free block in bin */
 } heap_block_t;
 
+/* heap statistics */
+typedef struct heap_bin_stats {
+	uint32_t nfree; /* number of free blocks */
+	uint32_t nused; /* number of used blocks */
+	size_t free; /* bytes in free blocks */
+	size_t used; /* bytes in used blocks */
+} heap_bin_stats_t;
+
+typedef struct heap_stats {
+	heap_bin_stats_t bins[HEAP_NBINS]; /* per size class */
+	size_t arena; /* bytes mapped for small allocations */
+	uint32_t nlarge; /* number of large allocations */
+	uint32_t nlargepages; /* number of pages mapped for large allocations */
+} heap_stats_t;
+
+/* live allocation */
+typedef struct heap_trace {
+	void *ptr; /* returned pointer (NULL for an empty slot) */
+	void *caller; /* return address into allocating function */
+	size_t size; /* requested size */
+	uint64_t time; /* allocation time (ns) */
+} heap_trace_t;
+
 /* functions */
 extern void heap_init(void); /* initialize heap */
-extern heap_block_t *heap_find(heap_block_t *b, size_t sz); /* find a block */
-extern heap_block_t *heap_find_aligned(heap_block_t *b, size_t sz, size_t a); /* find an aligned block */
-extern void heap_split(heap_block_t *b, size_t sz); /* split block into two */
-extern heap_block_t *heap_merge(heap_block_t *b); /* merge chunk with front and back */
-extern void heap_print(void); /* debug */
+extern void heap_get_stats(heap_stats_t *stats); /* get heap statistics */
+extern void heap_print(void); /* print per-bin statistics */
+extern size_t heap_report(char *buf, size_t size); /* format fragmentation report and live allocations, returns length */
+extern void heap_init_devfs(void); /* initialize vfs nodes */
 
 extern void *kmalloc(size_t sz); /* allocate sz bytes */
 extern void *kmalloca(size_t sz, size_t a); /* allocate sz bytes aligned to a bytes */
+extern void *kmalloc_contig(size_t sz, page_frame_id_t *frame); /* allocate page aligned, physically contiguous memory */
 extern void kfree(void *p); /* free pointer */
 
 #endif /* ECLAIR_HEAP_H */
@@ -7,6 +7,7 @@
 #define ECLAIR_MM_PAGING_H
 
 #include <kernel/types.h>
+#include <kernel/smp.h>
 
 typedef uint32_t page_dir_entry_t; /* page directory entry */
 typedef uint32_t page_tab_entry_t; /* page table entry */
@@ -28,18 +29,60 @@ typedef uint32_t page_id_t; /* page id */
 #define PAGE_FLAG_D 0x40
 #define PAGE_FLAG_PS 0x80
 #define PAGE_FLAG_G 0x100
+#define PAGE_FLAG_AVL0 0x200 /* available for kernel use */
+#define PAGE_FLAG_AVL1 0x400
+#define PAGE_FLAG_AVL2 0x800
+
+#define PAGE_FLAG_COW PAGE_FLAG_AVL1 /* read-only until copied on write */
+#define PAGE_FLAG_SWAP PAGE_FLAG_AVL2 /* not present, contents are in a swap slot */
+
+/* swapped out entries keep the slot where the frame would be */
+#define PAGE_SWAP_ENT(slot) (PAGE_ENT(slot) | PAGE_FLAG_SWAP)
+#define PAGE_SWAP_SLOT(ent) ((ent) >> 12)
+#define PAGE_IS_SWAPPED(ent) (((ent) & (PAGE_FLAG_P | PAGE_FLAG_SWAP)) == PAGE_FLAG_SWAP)
+
+/* page fault error code */
+#define PAGE_FAULT_P 0x1 /* page was present */
+#define PAGE_FAULT_W 0x2 /* access was a write */
+#define PAGE_FAULT_U 0x4 /* access came from user mode */
+
+/* buddy allocator orders (order 10 = 4M) */
+#define PAGE_FRAME_MAX_ORDER 10
+#define PAGE_FRAME_NORDERS (PAGE_FRAME_MAX_ORDER+1)
+
+/* pre-zeroed frame pool */
+#define PAGE_ZERO_WATERMARK 64 /* default number of zeroed frames kept ready */
+#define PAGE_ZERO_MAX 1024 /* pool capacity */
+
+#define PAGE_FRAME_RESERVE 32 /* free frames left when swapping starts */
 
 extern page_id_t page_breakp;
-extern page_dir_entry_t *page_dir_wrap;
+#define page_dir_wrap ((page_dir_entry_t *)smp_dir()) /* page directory of the running address space (per cpu) */
 extern page_tab_entry_t *page_table;
 extern uint32_t page_frame_max_count;
 
 /* functions */
 extern void page_frame_init(void); /* initialize frame allocator */
+extern void page_frame_add_region(page_frame_id_t start, page_frame_id_t end); /* add usable memory region */
+extern void page_frame_init_buddy(void); /* set up buddy allocator from usable memory regions */
 extern page_frame_id_t page_frame_alloc(void); /* allocate a frame */
+extern page_frame_id_t page_frame_alloc_zeroed(void); /* allocate a zeroed frame */
+extern bool page_frame_refill_zeroed(void); /* zero free frames until the pool reaches the watermark, returns true if it is full */
+extern void page_frame_set_zero_watermark(uint32_t count); /* set number of zeroed frames kept ready */
+extern uint32_t page_frame_get_zeroed_count(void); /* get number of zeroed frames ready */
+extern page_frame_id_t page_frame_alloc_contig(uint32_t order); /* allocate 2^order physically contiguous frames */
+extern void page_frame_free_contig(page_frame_id_t id, uint32_t order); /* free 2^order physically contiguous frames */
 extern void page_frame_use(page_frame_id_t id); /* set frame to used */
 extern void page_frame_free(page_frame_id_t id); /* set frame to free */
+extern bool page_frame_can_share(void); /* check if frames can be shared */
+extern bool page_frame_ref(page_frame_id_t id); /* add reference to used frame */
+extern void page_frame_unref(page_frame_id_t id); /* drop reference to frame, freeing it with the last one */
+extern uint32_t page_frame_get_refcnt(page_frame_id_t id); /* get number of references to frame */
+extern void page_frame_set_swap(page_frame_id_t id, uint32_t slot); /* remember swap slot holding a copy of frame (0 drops it) */
+extern uint32_t page_frame_get_swap(page_frame_id_t id); /* get swap slot holding a copy of frame */
 extern uint32_t page_frame_get_used_count(void); /* get number of used frames */
+extern uint32_t page_frame_get_free_count(uint32_t order); /* get number of free blocks of an order */
+extern uint32_t page_frame_get_free_total(void); /* get total number of free frames */
 
 extern void page_init(void); /* initialize page mapper */
 extern void page_init_top(void); /* map all page tables in kernel area */
@@ -48,9 +91,22 @@ extern void page_map_table(page_id_t p, page_frame_id_t f); /* map a page table
 extern void page_map_table_flags(page_id_t p, page_frame_id_t f, uint32_t flags); /* map a page table with flags */
 extern void page_map(page_id_t p, page_frame_id_t f); /* map a page to a frame */
 extern void page_map_flags(page_id_t p, page_frame_id_t f, uint32_t flags); /* map a page with flags */
+extern void page_map_readonly(page_id_t p, page_frame_id_t f, uint32_t flags); /* map a page read-only with flags */
+extern bool page_has_large(void); /* check if 4M pages are supported */
+extern bool page_map_large(page_id_t p, page_frame_id_t f, uint32_t flags); /* map 4M aligned region with a single directory entry */
+extern void page_map_range(page_id_t p, page_frame_id_t f, uint32_t count, uint32_t flags); /* map contiguous frames, using 4M pages where alignment allows */
+extern page_id_t page_map_contig(page_frame_id_t f, uint32_t count); /* map contiguous frames at the kernel break point */
+extern void *page_map_temp(page_frame_id_t f); /* map frame to temporary window */
+extern void page_unmap_temp(void); /* unmap temporary window */
+extern page_frame_id_t page_get_temp(void); /* get frame in temporary window */
+extern void page_begin(void); /* start mapping transaction (invalidations are deferred until commit) */
+extern void page_commit(void); /* end mapping transaction and flush deferred invalidations */
 extern void page_invalidate(page_id_t p); /* invalidate an entry in the tlb */
+extern void page_flush(void); /* flush all non-global tlb entries */
+extern void page_flush_global(void); /* flush all tlb entries including global ones */
 extern bool page_is_mapped(page_id_t p); /* check if page is mapped */
 extern page_frame_id_t page_get_frame(page_id_t p); /* get frame from page */
+extern uint32_t page_get_swap(page_id_t p); /* get swap slot of swapped out page */
 extern page_frame_id_t page_get_table_frame(page_id_t p); /* get frame from page table */
 extern void page_unmap(page_id_t p); /* unmap page */
 extern void *page_get_directory(void); /* get kernel page directory */
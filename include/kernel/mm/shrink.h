@@ -0,0 +1,30 @@
+/*
+ * Copyright 2025-2026, Elliot Kohlmyer
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef ECLAIR_MM_SHRINK_H
+#define ECLAIR_MM_SHRINK_H
+
+#include <kernel/types.h>
+
+#define SHRINK_WATERMARK 64 /* free frames left when caches start to shrink */
+#define SHRINK_BATCH 32 /* objects released per shrink */
+#define SHRINK_BACKOFF 64 /* early shrinks skipped after one that found nothing */
+
+typedef uint32_t (*shrink_scan_t)(uint32_t); /* release up to count objects, returns number released */
+
+/* cache that can give memory back */
+typedef struct shrinker {
+	const char *name; /* cache name */
+	shrink_scan_t scan; /* release objects */
+	struct shrinker *next; /* next cache (least recently scanned first) */
+} shrinker_t;
+
+/* functions */
+extern void shrink_register(shrinker_t *shrinker); /* add cache to registry */
+extern uint32_t shrink_run(uint32_t count, bool force); /* release up to count objects from caches, returns number released */
+extern void shrink_lock(void); /* keep shrinkers out of allocator internals */
+extern void shrink_unlock(void); /* allow shrinkers again */
+
+#endif /* ECLAIR_MM_SHRINK_H */
@@ -0,0 +1,47 @@
+/*
+ * Copyright 2025-2026, Elliot Kohlmyer
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef ECLAIR_MM_SLAB_H
+#define ECLAIR_MM_SLAB_H
+
+#include <kernel/types.h>
+
+typedef void (*kmem_ctor_t)(void *); /* object constructor */
+
+/* slab header (placed at the start of the slab) */
+typedef struct kmem_slab {
+	struct kmem_cache *cache; /* owning cache */
+	struct kmem_slab *prev; /* previous slab in list */
+	struct kmem_slab *next; /* next slab in list */
+	void *free; /* first free object */
+	uint32_t inuse; /* number of objects in use */
+} kmem_slab_t;
+
+/* object cache */
+typedef struct kmem_cache {
+	const char *name; /* cache name */
+	size_t size; /* object size */
+	size_t objsz; /* object size including free link */
+	size_t linkoff; /* offset of free link in object */
+	size_t slabsz; /* size of each slab */
+	uint32_t nobjs; /* number of objects per slab */
+	kmem_ctor_t ctor; /* object constructor */
+	kmem_slab_t *full; /* slabs with no free objects */
+	kmem_slab_t *partial; /* slabs with free and used objects */
+	kmem_slab_t *empty; /* slabs with no used objects */
+	uint32_t nslabs; /* number of slabs */
+	uint32_t nempty; /* number of empty slabs */
+	uint32_t nactive; /* number of objects in use */
+	struct kmem_cache *next; /* next cache */
+} kmem_cache_t;
+
+/* functions */
+extern kmem_cache_t *kmem_cache_create(const char *name, size_t size, kmem_ctor_t ctor); /* create object cache */
+extern void *kmem_cache_alloc(kmem_cache_t *cache); /* allocate object */
+extern void kmem_cache_free(kmem_cache_t *cache, void *p); /* free object */
+extern void kmem_cache_shrink(kmem_cache_t *cache); /* release empty slabs */
+extern void kmem_print(void); /* debug */
+
+#endif /* ECLAIR_MM_SLAB_H */
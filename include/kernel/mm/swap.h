@@ -0,0 +1,35 @@
+/*
+ * Copyright 2025-2026, Elliot Kohlmyer
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef ECLAIR_MM_SWAP_H
+#define ECLAIR_MM_SWAP_H
+
+#include <kernel/types.h>
+#include <kernel/mm/paging.h>
+#include <kernel/driver/device.h>
+
+#define SWAP_SECTSZ 512 /* bytes per sector */
+#define SWAP_SECTS (PAGE_SIZE / SWAP_SECTSZ) /* sectors per slot */
+#define SWAP_MAXSLOTS 0x100000 /* slots addressable by a page table entry */
+#define SWAP_MAXREF 0xffff /* references held on one slot */
+#define SWAP_MAXAREAS 2 /* compressed pool and one disk area */
+#define SWAP_CLUSTER 32 /* pages swapped out per reclaim */
+#define SWAP_BACKOFF 64 /* early reclaims skipped after one that found nothing */
+
+/* functions */
+extern void swap_init(void); /* set up compressed pool if requested */
+extern bool swap_add(device_t *dev, uint32_t lba, uint32_t nsects); /* use disk area for swap */
+extern bool swap_add_zram(uint32_t count); /* use compressed pool of count pages for swap (preferred over disk) */
+extern bool swap_is_active(void); /* check if swap space is available */
+extern uint32_t swap_store(page_frame_id_t f); /* write frame to a new slot (0 if full) */
+extern bool swap_dup(uint32_t slot); /* add reference to slot */
+extern void swap_put(uint32_t slot); /* drop reference to slot, freeing it with the last one */
+extern uint32_t swap_count(uint32_t slot); /* get number of references to slot */
+extern uint32_t swap_get_total(void); /* get number of slots */
+extern uint32_t swap_get_used(void); /* get number of used slots */
+extern void swap_read(uint32_t slot, page_frame_id_t f); /* read slot into frame */
+extern uint32_t swap_reclaim(bool force); /* swap out pages to free frames, returns number of frames freed */
+
+#endif /* ECLAIR_MM_SWAP_H */
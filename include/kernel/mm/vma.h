@@ -0,0 +1,48 @@
+/*
+ * Copyright 2025-2026, Elliot Kohlmyer
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef ECLAIR_MM_VMA_H
+#define ECLAIR_MM_VMA_H
+
+#include <kernel/types.h>
+#include <kernel/mm/paging.h>
+#include <kernel/vfs/fs.h>
+
+/* area types */
+#define VMA_DEVICE 0 /* physical device memory */
+#define VMA_FILE 1 /* file contents */
+#define VMA_ANON 2 /* zero filled memory */
+
+/* virtual memory area (node of an avl tree sorted by start page) */
+typedef struct vma {
+	page_id_t start; /* start page */
+	page_id_t end; /* end page (exclusive) */
+	uint32_t type; /* area type */
+	uint32_t prot; /* protection flags (ECM_PROT_*) */
+	uint32_t flags; /* mapping flags (ECM_MAP_*) */
+	fs_node_t *file; /* backing file */
+	uint32_t offset; /* file page of start page */
+	struct vma *left; /* areas below */
+	struct vma *right; /* areas above */
+	int height; /* height of subtree */
+} vma_t;
+
+/* functions */
+extern void vma_init(void); /* initialize area cache */
+extern vma_t *vma_new(page_id_t start, page_id_t end, uint32_t type); /* allocate area */
+extern void vma_free(vma_t *vma); /* free area */
+
+extern vma_t *vma_find(vma_t *root, page_id_t p); /* find area containing page */
+extern vma_t *vma_find_overlap(vma_t *root, page_id_t start, page_id_t end); /* find lowest area overlapping range */
+extern vma_t *vma_first(vma_t *root); /* get first area */
+extern vma_t *vma_next(vma_t *root, vma_t *vma); /* get area after another */
+extern page_id_t vma_find_free(vma_t *root, page_id_t lo, page_id_t hi, uint32_t count); /* find lowest free range in bounds */
+extern void vma_insert(vma_t **root, vma_t *vma); /* insert area (must not overlap) */
+extern void vma_remove(vma_t **root, vma_t *vma); /* remove area */
+extern vma_t *vma_split(vma_t **root, vma_t *vma, page_id_t p); /* split area at page, returns upper half */
+extern vma_t *vma_clone(vma_t *root); /* copy tree */
+extern void vma_destroy(vma_t *root); /* free tree */
+
+#endif /* ECLAIR_MM_VMA_H */
@@ -0,0 +1,33 @@
+/*
+ * Copyright 2025-2026, Elliot Kohlmyer
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef ECLAIR_MM_ZRAM_H
+#define ECLAIR_MM_ZRAM_H
+
+#include <kernel/types.h>
+#include <kernel/mm/paging.h>
+
+#define ZRAM_CLASSSZ 128 /* size class granularity */
+#define ZRAM_NCLASSES (PAGE_SIZE / 2 / ZRAM_CLASSSZ + 1) /* classes holding two or more objects per frame, then whole pages */
+
+/* compressed pool statistics */
+typedef struct zram_stats {
+	uint32_t nstored; /* pages stored */
+	uint32_t nzero; /* zero filled pages (stored without data) */
+	uint32_t compr; /* total compressed size */
+	uint32_t nframes; /* frames used by the pool */
+	uint64_t nfaults; /* pages loaded */
+	uint64_t fault_cycles; /* cpu cycles spent loading pages */
+} zram_stats_t;
+
+/* functions */
+extern bool zram_init(uint32_t count); /* set up pool for count pages */
+extern void zram_destroy(void); /* release pool that holds no pages */
+extern bool zram_store(uint32_t index, page_frame_id_t f); /* compress frame into pool (uses the temporary window) */
+extern void zram_load(uint32_t index, page_frame_id_t f); /* decompress page into frame (uses the temporary window) */
+extern void zram_free(uint32_t index); /* release stored page */
+extern void zram_get_stats(zram_stats_t *stats); /* get pool statistics */
+
+#endif /* ECLAIR_MM_ZRAM_H */
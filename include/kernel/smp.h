@@ -0,0 +1,163 @@
+/*
+ * Copyright 2025-2026, Elliot Kohlmyer
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef ECLAIR_SMP_H
+#define ECLAIR_SMP_H
+
+#include <kernel/types.h>
+
+#define SMP_MAXCPUS 8
+#define SMP_STACKSZ 32768 /* boot stack of application processors (kept by their idle task) */
+#define SMP_TRAMPOLINE 0x7000 /* real mode start address of application processors (below the frame allocator) */
+#define SMP_INIT_DELAY 10000000 /* nanoseconds between init and startup ipis */
+#define SMP_STARTUP_DELAY 1000000 /* nanoseconds between the two startup ipis */
+#define SMP_START_TIMEOUT 100000000 /* nanoseconds to wait for a started cpu to check in */
+
+/* mp floating pointer and configuration table */
+#define SMP_MP_SIG 0x5f504d5f /* "_MP_" */
+#define SMP_MP_TABLE_SIG 0x504d4350 /* "PCMP" */
+#define SMP_MP_ENTRY_CPU 0
+#define SMP_MP_CPU_ENABLED 0x1
+#define SMP_MP_TABLE_MAX 4096 /* bytes of configuration table looked at */
+
+/* mp floating pointer */
+typedef struct smp_mp {
+	uint32_t sig; /* SMP_MP_SIG */
+	uint32_t table; /* physical address of configuration table */
+	uint8_t len; /* length in 16 byte units */
+	uint8_t rev; /* specification revision */
+	uint8_t checksum; /* all bytes add up to zero */
+	uint8_t features[5]; /* default configuration if features[0] is nonzero */
+} __attribute__((packed)) smp_mp_t;
+
+/* mp configuration table header */
+typedef struct smp_mp_table {
+	uint32_t sig; /* SMP_MP_TABLE_SIG */
+	uint16_t len; /* length of base table */
+	uint8_t rev; /* specification revision */
+	uint8_t checksum; /* all bytes of base table add up to zero */
+	char oem[8]; /* oem id */
+	char product[12]; /* product id */
+	uint32_t oemtable; /* oem table pointer */
+	uint16_t oemsize; /* oem table size */
+	uint16_t count; /* number of entries */
+	uint32_t lapic; /* physical address of local apic */
+	uint16_t extlen; /* extended table length */
+	uint8_t extchecksum; /* extended table checksum */
+	uint8_t rsvd;
+} __attribute__((packed)) smp_mp_table_t;
+
+/* mp processor entry (other entries are 8 bytes) */
+typedef struct smp_mp_cpu {
+	uint8_t type; /* SMP_MP_ENTRY_CPU */
+	uint8_t apicid; /* local apic id */
+	uint8_t apicver; /* local apic version */
+	uint8_t flags; /* SMP_MP_CPU_* */
+	uint32_t signature; /* cpu signature */
+	uint32_t features; /* cpuid leaf 1 edx */
+	uint32_t rsvd[2];
+} __attribute__((packed)) smp_mp_cpu_t;
+
+/* values handed to the trampoline (layout used by smpa.asm) */
+typedef struct smp_params {
+	uint32_t cr3; /* kernel page directory */
+	uint32_t cr4; /* paging features of the boot processor */
+	uint32_t esp; /* boot stack top */
+	uint32_t id; /* cpu index */
+	uint32_t entry; /* c entry point */
+} smp_params_t;
+
+/* busy-waiting lock */
+typedef struct spinlock {
+	volatile uint32_t locked; /* nonzero while held */
+} spinlock_t;
+
+#define SPINLOCK_INIT {0}
+
+struct task;
+struct gdt_tss;
+
+/* per-cpu data, reached through the gs segment (the first fields are used by taska.asm) */
+typedef struct cpu {
+	struct cpu *self; /* this structure */
+	struct task *task; /* active task */
+	uint32_t *dir; /* page directory of active task */
+	struct gdt_tss *tss; /* task state segment */
+	uint32_t nlockpost; /* number of task switch locks */
+	uint32_t postponed; /* postponed task switches */
+	uint32_t nlockcli; /* number of interrupt locks */
+	bool locked; /* holds the kernel lock */
+	bool preempt; /* preemption waiting for interrupts to be unlocked */
+	volatile bool online; /* scheduling tasks */
+	uint32_t id; /* index */
+	uint32_t apicid; /* local apic id */
+	struct task *idle; /* task run when there is nothing else (application processors) */
+	uint64_t since; /* time the active task was last charged for its time slice */
+	uint32_t flushgen; /* last kernel tlb flush seen */
+} cpu_t;
+
+extern uint32_t smp_ncpus; /* number of cpus online */
+
+extern uint8_t smp_trampoline[]; /* application processor start code; do not call directly */
+extern uint8_t smp_trampoline_params[]; /* smp_params_t inside the start code */
+extern uint8_t smp_trampoline_end[];
+
+/* functions */
+extern void smp_init_bsp(void); /* set up per-cpu data of the boot processor */
+extern void smp_init(void); /* find and start application processors */
+extern cpu_t *smp_get_cpu(uint32_t id); /* get cpu from index */
+extern bool smp_lock(void); /* take kernel lock (interrupts disabled by caller), returns true if the cpu already held it */
+extern void smp_unlock(void); /* release kernel lock if held (interrupts disabled by caller) */
+extern void smp_halt(void); /* wait for an interrupt without holding the kernel lock (interrupts enabled by caller) */
+extern void smp_relax(void); /* let other cpus into the kernel while waiting for them (interrupts enabled by caller) */
+extern void smp_flush_others(void); /* drop kernel tlb entries of other cpus (kernel lock held) */
+extern void smp_flush_handler(void); /* handle flush interrupt; do not call directly */
+extern void smp_send_resched(uint32_t id); /* get other cpu to look at its run queue */
+
+/* get data of running cpu (only stable while interrupts are disabled) */
+static inline cpu_t *smp_cpu(void) {
+
+	cpu_t *cpu;
+	asm volatile("mov %%gs:0, %0": "=r"(cpu));
+	return cpu;
+}
+
+/* get active task (one load, so a task moving between cpus still sees itself) */
+static inline struct task *smp_task(void) {
+
+	struct task *task;
+	asm volatile("mov %%gs:4, %0": "=r"(task));
+	return task;
+}
+
+/* get page directory of active task */
+static inline uint32_t *smp_dir(void) {
+
+	uint32_t *dir;
+	asm volatile("mov %%gs:8, %0": "=r"(dir));
+	return dir;
+}
+
+/* take spinlock */
+static inline void spin_lock(spinlock_t *lock) {
+
+	while (__atomic_exchange_n(&lock->locked, 1, __ATOMIC_ACQUIRE)) {
+		while (lock->locked) asm volatile("pause");
+	}
+}
+
+/* try to take spinlock, returns true if it was free */
+static inline bool spin_trylock(spinlock_t *lock) {
+
+	return !__atomic_exchange_n(&lock->locked, 1, __ATOMIC_ACQUIRE);
+}
+
+/* release spinlock */
+static inline void spin_unlock(spinlock_t *lock) {
+
+	__atomic_store_n(&lock->locked, 0, __ATOMIC_RELEASE);
+}
+
+#endif /* ECLAIR_SMP_H */
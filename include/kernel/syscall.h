@@ -36,5 +36,12 @@ extern void sys_ioctl(idt_regs_t *regs); /* send command to io device */
 extern void sys_kinfo(idt_regs_t *regs); /* get system info */
 extern void sys_getuser(idt_regs_t *regs); /* get user info */
 extern void sys_setuser(idt_regs_t *regs); /* set user */
+extern void sys_fork(idt_regs_t *regs); /* clone current process */
+extern void sys_mmap(idt_regs_t *regs); /* map file or anonymous memory */
+extern void sys_munmap(idt_regs_t *regs); /* remove memory mappings */
+extern void sys_mprotect(idt_regs_t *regs); /* change protection of mapped memory */
+extern void sys_pinfo(idt_regs_t *regs); /* get process info */
+extern void sys_setprio(idt_regs_t *regs); /* set scheduling class and priority */
+extern void sys_nice(idt_regs_t *regs); /* change nice value */
 
 #endif /* ECLAIR_SYSCALL_H */
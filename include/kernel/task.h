@@ -7,7 +7,11 @@
 #define ECLAIR_TASK_H
 
 #include <kernel/types.h>
+#include <kernel/idt.h>
+#include <kernel/smp.h>
 #include <kernel/mm/paging.h>
+#include <kernel/mm/vma.h>
+#include <kernel/timer.h>
 #include <kernel/vfs/fs.h>
 
 #define TASK_READY 0
@@ -20,6 +24,16 @@
 
 #define TASK_NSTATES 7
 
+/* scheduling classes */
+#define TASK_SCHED_NORMAL 0
+#define TASK_SCHED_RT 1
+
+#define TASK_NICE_MIN -20
+#define TASK_NICE_MAX 19
+#define TASK_NRTPRIO 4 /* real-time priorities (1 to TASK_NRTPRIO, higher runs first) */
+#define TASK_NLEVELS 8 /* feedback levels for normal tasks */
+#define TASK_NQUEUES (TASK_NRTPRIO + TASK_NLEVELS)
+
 #define TASK_STACK_START 8
 #define TASK_STACK_END 40
 #define TASK_STACK_SIZE 0x20000
@@ -31,6 +45,8 @@
 #define TASK_PROG_START 0x800
 #define TASK_PROG_ADDR ((void *)0x800000)
 
+#define TASK_TIME_START 6 /* ec_timepage_t (EC_TIME_ADDR) */
+
 #define TASK_SIGH_START 7
 #define TASK_SIGH_END 8
 #define TASK_SIGH_ADDR ((void *)0x7000)
@@ -44,6 +60,9 @@
 #define TASK_MINBRKP 0x800000
 #define TASK_MAXBRKP 0xB0000000
 
+#define TASK_MMAP_START 0xB0000
+#define TASK_MMAP_END 0xC0000
+
 /* signals */
 #define TASK_SIGNONE 0
 
@@ -64,9 +83,20 @@ typedef void (*task_sig_t)();
 #define TASK_SEEK_END 2
 #define TASK_NWHENCE 3
 
+/* memory accounting (in pages) */
+typedef struct task_mem {
+	uint32_t nresident; /* frames mapped (zero page and device memory excluded) */
+	uint32_t nstack; /* resident stack pages */
+	uint32_t ndevice; /* device memory pages mapped */
+	uint32_t nswapped; /* pages in swap */
+	uint32_t brkbase; /* break point after loading the executable */
+	uint64_t nfaults; /* page faults taken */
+	uint64_t nmajfaults; /* page faults that read from swap */
+} task_mem_t;
+
 /* task control block */
 #define TASK_MAXFILES 32
-#define TASK_MAXMAPPINGS 32
+#define TASK_NAMESZ 32
 
 typedef struct task {
 	void *esp0; /* kernel stack top */
@@ -76,8 +106,14 @@ typedef struct task {
 	struct task *prev; /* previous task */
 	struct task *next; /* next task */
 	uint32_t state; /* task state */
-	uint64_t waketime; /* wake up time for sleeping task */
-	uint32_t nticks; /* number of ticks left */
+	waitq_t *waitq; /* list the task is blocked on */
+	timer_t timer; /* ends timed sleeps and waits */
+	uint64_t slice; /* nanoseconds left of time slice */
+	uint32_t policy; /* scheduling class */
+	int prio; /* nice value, or real-time priority */
+	uint32_t level; /* run queue (lower runs first) */
+	uint32_t ndecay; /* levels dropped for using up time slices */
+	uint32_t cpu; /* cpu whose run queue the task is on, or last ran on */
 	uint32_t id; /* task id */
 	bool ownstack; /* owns kernel stack */
 	fs_node_t *res; /* held resource */
@@ -100,27 +136,30 @@ typedef struct task {
 	const char **envp; /* initial envp */
 	bool freeargs; /* free argv and envp when done */
 	int pwait; /* waiting on process id */
+	waitq_t waiters; /* tasks waiting for this task to exit */
 	int wstatus; /* wait status */
-	struct {
-		bool used; /* free or used */
-		page_id_t start; /* start page */
-		page_id_t end; /* end page */
-	} mappings[TASK_MAXMAPPINGS]; /* special mapped region table */
+	vma_t *vmas; /* tree of mapped areas */
 	int uid; /* user id */
+	idt_regs_t *forkregs; /* registers to resume forked task with */
+	char name[TASK_NAMESZ]; /* name of executable */
+	task_mem_t mem; /* memory accounting */
 } task_t;
 
 extern task_t *ktask; /* base kernel task */
-extern task_t *task_active; /* active task */
-
-extern uint32_t task_nlockpost; /* number of task switch locks */
-extern uint32_t task_postponed; /* postponed task switches */
+#define task_active (smp_task()) /* active task (per cpu) */
 
 extern uint32_t task_handle_signal_size; /* size of signal handler routine */
 
+extern uint64_t task_nswitches; /* number of task switches */
+extern uint64_t task_switch_cycles; /* time stamp counter cycles spent in task switches */
+extern uint32_t task_switch_tsc; /* nonzero if task_switch can read the time stamp counter */
+
 /* functions */
 extern void task_init_memory(void); /* allocate necessary memory before heap */
 extern void task_init(void); /* initialize multitasking */
+extern void task_init_tickless(void); /* switch from the pit tick to one-shot local apic timers */
 extern task_t *task_new(void *esp, void *seteip); /* create task */
+extern task_t *task_new_idle(void *esp); /* turn running application processor into its idle task (esp is the top of its boot stack) */
 extern void task_switch(task_t *task); /* switch to next task */
 extern void task_schedule(void); /* schedule next task */
 extern void task_lockcli(void); /* lock interrupts */
@@ -130,6 +169,8 @@ extern void task_lockpost(void); /* lock task switches */
 extern void task_unlockpost(void); /* unlock task switches */
 extern void task_block(uint32_t reason); /* block current task */
 extern void task_unblock(task_t *task); /* unblock task */
+extern void task_wake_all(waitq_t *wq); /* unblock all tasks on wait queue */
+extern int task_setprio(task_t *task, uint32_t policy, int prio); /* set scheduling class and priority */
 
 extern void task_nano_sleep_until(uint64_t waketime); /* sleep in nanoseconds until */
 extern void task_nano_sleep(uint64_t ns); /* sleep in nanoseconds */
@@ -140,17 +181,29 @@ extern void task_terminate(void); /* terminate current task */
 extern void task_cleanup(void); /* clean up terminated tasks */
 extern void task_acquire(fs_node_t *node); /* acquire resource */
 extern void task_release(void); /* release held resource */
+extern bool task_res_waiting(fs_node_t *node); /* check if a task is waiting for resource */
+
+extern void task_set_name(task_t *task, const char *path); /* name task after executable */
+extern void task_account(task_t *task, page_id_t p, int n); /* count frames mapped into (n > 0) or out of task */
 
 extern uint64_t task_get_global_time(void); /* get time for all tasks */
+extern void task_timer_kick(uint64_t when); /* get the boot processor timer to fire no later than when (interrupts locked) */
 extern void task_entry(void); /* task entry point */
 
 extern void task_raise(uint32_t sig); /* raise signal on current task */
 extern void task_signal(task_t *task, uint32_t sig); /* raise signal on other task */
 extern void task_handle_signal(void); /* routine to handle signal; do not call directly */
+extern void task_resume_user(idt_regs_t *regs); /* return to user mode with saved registers; do not call directly */
 extern task_t *task_get(int id); /* get task from id */
+extern task_t *task_get_next(int id); /* get task with the lowest id from id on */
 extern void *task_sbrk(intptr_t inc); /* increment or decrement breakpoint */
 extern int task_pwait(int pid, uint64_t timeout); /* wait for process status change */
+extern int task_fork(idt_regs_t *regs); /* clone current task copy-on-write */
 extern int task_mmap(page_id_t area, page_frame_id_t start, page_frame_id_t count); /* make special memory mapping for task */
+extern intptr_t task_mmap_area(void *addr, size_t len, int prot, int flags, int fd, koff_t offset); /* map file or anonymous memory */
+extern int task_munmap(void *addr, size_t len); /* remove memory mappings in range */
+extern int task_mprotect(void *addr, size_t len, int prot); /* change protection of mapped range */
+extern uint32_t task_swap_out(uint32_t count); /* swap out up to count pages of user tasks, returns number of frames freed */
 extern int task_setuser(const char *name, const char *pswd); /* set user for task */
 
 extern int task_fs_open(const char *path, uint32_t flags, uint32_t mask); /* open file */
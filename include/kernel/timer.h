@@ -0,0 +1,34 @@
+/*
+ * Copyright 2025-2026, Elliot Kohlmyer
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef ECLAIR_TIMER_H
+#define ECLAIR_TIMER_H
+
+#include <kernel/types.h>
+
+#define TIMER_EXTRA 32 /* pending timers with room in the heap besides those of tasks */
+#define TIMER_NONE 0xffffffff /* heap index of inactive timer */
+
+struct timer;
+typedef void (*timer_func_t)(struct timer *); /* called from the timer interrupt once expired */
+
+/* one-shot kernel timer */
+typedef struct timer {
+	uint64_t expires; /* deadline (task_get_global_time) */
+	timer_func_t func; /* expiry callback */
+	void *data; /* callback data */
+	uint32_t index; /* position in heap */
+} timer_t;
+
+/* functions */
+extern void timer_init(uint32_t max); /* initialize timers with room for max pending ones */
+extern void timer_setup(timer_t *timer, timer_func_t func, void *data); /* set up inactive timer */
+extern int timer_add(timer_t *timer, uint64_t expires); /* (re)arm timer, returns zero if successful */
+extern bool timer_cancel(timer_t *timer); /* disarm timer, returns if it was pending */
+extern bool timer_pending(timer_t *timer); /* check if timer is armed */
+extern uint64_t timer_next(void); /* get earliest deadline (UINT64_MAX if none) */
+extern void timer_run(uint64_t now); /* run expired timers */
+
+#endif /* ECLAIR_TIMER_H */
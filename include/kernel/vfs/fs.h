@@ -7,6 +7,7 @@
 #define ECLAIR_VFS_FS_H
 
 #include <kernel/types.h>
+#include <kernel/waitq.h>
 #include <ec.h>
 
 struct fs_node;
@@ -64,8 +65,10 @@ typedef struct fs_node {
 	uint32_t impl; /* file system implementation info */
 	uint32_t oflags; /* open flags */
 	int refcnt; /* reference count for open files */
+	int pins; /* lookups still using the node, kept from being evicted */
 	void *odata; /* user data pointer for open files */
 	bool held; /* task is holding resource */
+	waitq_t waiters; /* tasks waiting to acquire resource */
 	struct fs_node *parent; /* parent node */
 	struct fs_node *ptr; /* alias pointer for mountpoints and symlinks */
 	fs_dirent_t *first; /* first directory entry */
@@ -81,19 +84,33 @@ typedef struct fs_node {
 	fs_stat_t stat; /* get file info */
 	fs_isatty_t isatty; /* check if file is a teletype */
 	fs_ioctl_t ioctl; /* send command to io device */
+	struct elf_text *text; /* cached read-only segments of executable */
+	struct filemap *map; /* cached pages of mapped file */
+	size_t objsz; /* allocated size of node */
+	uint64_t atime; /* time of last directory lookup */
+	struct fs_node *older; /* less recently used cached directory */
+	struct fs_node *newer; /* more recently used cached directory */
 } fs_node_t;
 
+#define FS_CACHE_AGE 2000000000ull /* nanoseconds a directory stays cached after a lookup at least */
+
 extern fs_node_t *fs_root; /* root node */
+extern uint32_t fs_generation; /* bumped whenever cached directory entries are dropped */
 
 /* functions */
 extern void fs_init(void); /* initialize vfs */
 
 extern fs_dirent_t *fs_dirent_new(const char *name); /* create new directory entry */
+extern void fs_dirent_free(fs_dirent_t *dent); /* free directory entry */
 
 extern fs_node_t *fs_node_new(fs_node_t *parent, uint32_t flags); /* create new node */
 extern fs_node_t *fs_node_new_ext(fs_node_t *parent, uint32_t flags, size_t sz); /* create new node with size */
+extern void fs_node_free(fs_node_t *node); /* free unreferenced node and its cached pages */
 
 extern void fs_node_add_dirent(fs_node_t *node, fs_dirent_t *dent); /* add dirent */
+extern void fs_node_touch(fs_node_t *node); /* mark directory as recently used */
+extern void fs_node_pin(fs_node_t *node); /* keep node from being evicted until it is unpinned */
+extern void fs_node_unpin(fs_node_t *node); /* let node be evicted again */
 extern void fs_node_print(fs_node_t *node); /* print node tree */
 
 extern kssize_t fs_read(fs_node_t *node, uint32_t offset, size_t nbytes, uint8_t *buf); /* read from file */
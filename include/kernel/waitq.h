@@ -0,0 +1,17 @@
+/*
+ * Copyright 2025-2026, Elliot Kohlmyer
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#ifndef ECLAIR_WAITQ_H
+#define ECLAIR_WAITQ_H
+
+struct task;
+
+/* list of tasks (blocked tasks wait on one until they are woken) */
+typedef struct task_list {
+	struct task *first; /* first item in list */
+	struct task *last; /* last item in list */
+} waitq_t;
+
+#endif /* ECLAIR_WAITQ_H */
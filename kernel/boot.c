@@ -88,6 +88,32 @@ static void parse_cmdline(void) {
 					strncpy(cmdline.ramfs_mount, param, MIN(plen, BOOT_CMDLINE_PARAM_MAX_CHARS));
 				}
 			}
+
+			/* number of zeroed frames kept ready */
+			else if (!strncmp("zero-pool", arg, MIN(len, 9))) {
+
+				if (arg[9] == '=') {
+
+					uint32_t count = 0;
+					for (size_t i = 10; i < len && arg[i] >= '0' && arg[i] <= '9'; i++)
+						count = count * 10 + (uint32_t)(arg[i] - '0');
+
+					page_frame_set_zero_watermark(count);
+				}
+			}
+
+			/* compressed swap pool */
+			else if (!strncmp("zram", arg, MIN(len, 4))) {
+
+				if (arg[4] == '=') {
+
+					uint32_t size = 0;
+					for (size_t i = 5; i < len && arg[i] >= '0' && arg[i] <= '9'; i++)
+						size = size * 10 + (uint32_t)(arg[i] - '0');
+
+					cmdline.zram_size = size;
+				}
+			}
 		}
 	}
 }
@@ -136,7 +162,8 @@ extern void boot_init(void) {
 						memmap_reserved_frames++;
 					}
 				}
-				page_frame_max_count += (endf - startf);
+				else if (entry->type == BOOT_MEMMAP_ENTRY_USABLE)
+					page_frame_add_region(ALIGN(entry->start, 0x1000) >> 12, entry->end >> 12);
 				entry++;
 			}
 		}
@@ -176,12 +203,10 @@ extern void boot_init(void) {
 			page_frame_id_t start = initrd->addr >> 12;
 			page_frame_id_t end = start + (initrd->size >> 12) + 1;
 
-			page_id_t page = page_breakp;
-			for (page_frame_id_t i = start; i < end; i++) {
-
+			for (page_frame_id_t i = start; i < end; i++)
 				page_frame_use(i);
-				page_map(page_breakp++, i);
-			}
+
+			page_id_t page = page_map_contig(start, end - start);
 			saved.initrd_addr = (void *)((page << 12) + (initrd->addr - (start << 12)));
 		}
 	}
@@ -194,6 +219,7 @@ extern void boot_log(void) {
 	kprintf(LOG_INFO, "[boot] Command line: '%s'", saved.cmdline);
 	kprintf(LOG_INFO, "[boot] Reserved frames: 0x%x", memmap_reserved_frames);
 	kprintf(LOG_INFO, "[boot] Total frames: 0x%x", page_frame_max_count);
+	kprintf(LOG_INFO, "[boot] Free frames: 0x%x", page_frame_get_free_total());
 }
 
 /* get page mapped info */
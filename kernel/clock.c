@@ -0,0 +1,145 @@
+/*
+ * Copyright 2025-2026, Elliot Kohlmyer
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <kernel/types.h>
+#include <kernel/clock.h>
+#include <kernel/panic.h>
+#include <kernel/task.h>
+#include <kernel/io/cpu.h>
+#include <kernel/mm/heap.h>
+#include <kernel/mm/paging.h>
+#include <kernel/driver/pit.h>
+#include <kernel/driver/rtc.h>
+#include <string.h>
+#include <ec.h>
+
+/*
+ * Time is read from the time stamp counter, its rate measured against the
+ * pit at boot. Cycles turn into nanoseconds with a 32 bit fixed point
+ * multiplier, so reading the clock takes no division. The wall clock is
+ * read from the rtc once and then follows the counter. Until the counter
+ * is calibrated, or without one, the pit tick advances a software clock.
+ *
+ * The same values sit in a page that every task maps read-only, so user
+ * space reads the time without a system call (see ec_timepage_t).
+ */
+static uint64_t tsc_base = 0; /* counter when it took over from the tick count */
+static uint64_t tsc_hz = 0; /* counter rate, zero without a time stamp counter */
+static uint32_t tsc_mult = 0; /* nanoseconds per cycle << tsc_shift */
+static uint32_t tsc_shift = 0;
+
+static uint64_t tick_ns = 0; /* software clock, frozen once the counter takes over */
+static uint64_t wall_base = 0; /* nanoseconds since the epoch at boot */
+
+static ec_timepage_t *timepage = NULL; /* copy for user space */
+
+/* begin changing time page (interrupts locked) */
+static inline void clock_page_begin(void) {
+
+	timepage->seq++;
+	asm volatile("": : : "memory");
+}
+
+/* end changing time page */
+static inline void clock_page_end(void) {
+
+	asm volatile("": : : "memory");
+	timepage->seq++;
+}
+
+/* convert a difference of cpu_rdtsc timestamps to nanoseconds */
+extern uint64_t clock_cycles_to_ns(uint64_t cycles) {
+
+	/* 64 by 32 bit multiplication in two halves */
+	uint64_t hi = (cycles >> 32) * tsc_mult;
+	uint64_t lo = (cycles & 0xffffffff) * tsc_mult;
+	return (hi << (32 - tsc_shift)) + (lo >> tsc_shift);
+}
+
+/* measure time stamp counter rate and read the wall clock */
+extern void clock_init(void) {
+
+	if (cpu_has_feature(CPU_FEATURE_TSC)) {
+
+		uint32_t div = PIT_FREQ(CLOCK_CALIBRATE_HZ);
+
+		task_lockcli();
+		uint64_t start = cpu_rdtsc();
+		pit_wait((uint16_t)div);
+		uint64_t end = cpu_rdtsc();
+
+		uint64_t hz = (end - start) * PIT_FREQ(1) / div;
+		if (hz) {
+
+			/* largest shift that keeps the multiplier in 32 bits */
+			for (tsc_shift = 32; tsc_shift && (1000000000ull << tsc_shift) / hz > 0xffffffff; tsc_shift--);
+			tsc_mult = (uint32_t)((1000000000ull << tsc_shift) / hz);
+
+			/* carry on from the tick count so the clock never goes back */
+			tsc_base = end;
+			tsc_hz = hz;
+		}
+		task_unlockcli();
+
+		if (tsc_hz) kprintf(LOG_INFO, "[clock] Time stamp counter at %d kHz", (int)(tsc_hz / 1000));
+	}
+
+	/* the rtc only counts seconds, so the wall clock is off by up to one */
+	wall_base = rtc_read() * 1000000000 - clock_ns();
+
+	/* a whole page, nothing else of the kernel may be visible through it */
+	void *page = kmalloca(PAGE_SIZE, PAGE_SIZE);
+	memset(page, 0, PAGE_SIZE);
+
+	task_lockcli();
+	timepage = (ec_timepage_t *)page;
+	clock_page_begin();
+	timepage->tsc = tsc_hz != 0;
+	timepage->ns = tick_ns;
+	timepage->tsc_base = tsc_base;
+	timepage->mult = tsc_mult;
+	timepage->shift = tsc_shift;
+	timepage->wall = wall_base;
+	clock_page_end();
+	task_unlockcli();
+}
+
+/* get frame of the time page, zero before clock_init */
+extern page_frame_id_t clock_get_page_frame(void) {
+
+	if (!timepage) return 0;
+	return page_get_frame((uint32_t)timepage >> 12);
+}
+
+/* check if the clock runs from the time stamp counter */
+extern bool clock_has_tsc(void) {
+
+	return tsc_hz != 0;
+}
+
+/* get monotonic nanoseconds since boot */
+extern uint64_t clock_ns(void) {
+
+	if (!tsc_hz) return tick_ns;
+	return tick_ns + clock_cycles_to_ns(cpu_rdtsc() - tsc_base);
+}
+
+/* get nanoseconds since the epoch */
+extern uint64_t clock_wall_ns(void) {
+
+	return wall_base + clock_ns();
+}
+
+/* advance clock by a timer tick (ignored with a time stamp counter) */
+extern void clock_advance(uint64_t ns) {
+
+	if (tsc_hz) return;
+	tick_ns += ns;
+
+	if (!timepage) return;
+	clock_page_begin();
+	timepage->ns = tick_ns;
+	clock_page_end();
+}
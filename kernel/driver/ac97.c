@@ -94,10 +94,18 @@ static device_t *ac97_init(pci_device_t *pdev, uint32_t func, pci_match_info_t *
 	port_outw(device->nam+AC97_NAM_PCM_VOLUME, 0);
 
 	/* create buffer descriptor list */
-	void *mem = kmalloca(0x1000 * 33, 0x1000);
+	page_frame_id_t frame = 0;
+	void *mem = kmalloc_contig(0x1000 * 33, &frame);
+	if (!mem) {
+
+		idt_set_irq_callback(device->irq, NULL);
+		kfree(device);
+		device = NULL;
+		return NULL;
+	}
 	memset(mem, 0, 0x1000 * 33);
 
-	void *physmem = (void *)(page_get_frame((uint32_t)mem >> 12) << 12);
+	void *physmem = (void *)(frame << 12);
 	device->physmem = physmem;
 
 	device->bdl = (ac97_bdl_entry_t *)mem;
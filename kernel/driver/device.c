@@ -10,6 +10,7 @@
 #include <kernel/string.h>
 #include <kernel/panic.h>
 #include <kernel/mm/heap.h>
+#include <kernel/smp.h>
 #include <kernel/driver/pit.h>
 #include <kernel/driver/rtc.h>
 #include <kernel/driver/ps2.h>
@@ -247,7 +248,7 @@ extern int device_keyboard_getkey_block(device_t *dev) {
 	device_keyboard_t *kbdev = (device_keyboard_t *)dev;
 
 	while (kbdev->kstart == kbdev->kend)
-		asm volatile("hlt");
+		smp_halt();
 
 	int key = kbdev->keys[kbdev->kstart];
 	kbdev->kstart = (kbdev->kstart + 1) % DEVICE_KEYBOARD_MAX_KEYS;
@@ -90,13 +90,11 @@ extern void fb_map(boot_saved_info_t *info, fb_format_t format) {
 	page_frame_id_t fr = (uint32_t)info->fb_addr / 4096;
 	uint32_t poff = (uint32_t)info->fb_addr % 4096;
 
-	page_id_t page = page_breakp;
 	uint32_t frcnt = ALIGN(poff + (info->fb_height * info->fb_pitch), 4096) / 4096;
-	for (uint32_t i = fr; i < fr+frcnt; i++) {
-
+	for (uint32_t i = fr; i < fr+frcnt; i++)
 		page_frame_use(i);
-		page_map(page_breakp++, i);
-	}
+
+	page_id_t page = page_map_contig(fr, frcnt);
 
 	/* set address */
 	fb_addr = PAGE_ADDR(page) + poff;
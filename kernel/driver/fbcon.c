@@ -7,6 +7,7 @@
 #include <kernel/string.h>
 #include <kernel/tty.h>
 #include <kernel/task.h>
+#include <kernel/timer.h>
 #include <kernel/vfs/fs.h>
 #include <kernel/driver/device.h>
 #include <kernel/driver/fb.h>
@@ -83,6 +84,7 @@ static bool cursor_update = true; /* update cursor */
 #define CURSOR_UPDATE 500000000
 static uint64_t timens = 0; /* current time */
 static uint64_t timestart = 0; /* start time */
+static timer_t blink; /* wakes the kernel idle loop for the next cursor flip */
 
 /* default colors */
 #define DEFAULT_COLOR_INDEX 0x7
@@ -448,6 +450,11 @@ extern void fbcon_flip_cursor(void) {
 	else fbcon_draw_cursor(idx);
 }
 
+/* cursor timer (only there to end the idle halt) */
+static void fbcon_blink(timer_t *timer) {
+
+}
+
 /* update console */
 extern void fbcon_update(void) {
 
@@ -459,4 +466,8 @@ extern void fbcon_update(void) {
 		timestart = timens;
 		fbcon_flip_cursor();
 	}
+
+	/* the timer tick is gone while idle */
+	if (!blink.func) timer_setup(&blink, fbcon_blink, NULL);
+	if (!timer_pending(&blink)) timer_add(&blink, timestart + CURSOR_UPDATE);
 }
@@ -0,0 +1,173 @@
+/*
+ * Copyright 2025-2026, Elliot Kohlmyer
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <kernel/types.h>
+#include <kernel/idt.h>
+#include <kernel/io/cpu.h>
+#include <kernel/mm/paging.h>
+#include <kernel/driver/pit.h>
+#include <kernel/driver/lapic.h>
+
+static page_id_t page = 0; /* register page, reserved before the heap */
+static volatile uint32_t *regs = NULL; /* mapped register page */
+static uint64_t timer_rate = 0; /* timer counts per second (same on all cpus) */
+static uint64_t timer_max = 0; /* longest timer interval in nanoseconds */
+
+/* read register */
+static inline uint32_t lapic_read(uint32_t reg) {
+
+	return regs[reg / 4];
+}
+
+/* write register */
+static inline void lapic_write(uint32_t reg, uint32_t val) {
+
+	regs[reg / 4] = val;
+}
+
+/* send interrupt command and wait until it is accepted */
+static void lapic_command(uint32_t apicid, uint32_t cmd) {
+
+	lapic_write(LAPIC_REG_ICR_HI, apicid << 24);
+	lapic_write(LAPIC_REG_ICR_LO, cmd);
+	while (lapic_read(LAPIC_REG_ICR_LO) & LAPIC_ICR_PENDING)
+		asm volatile("pause");
+}
+
+/* software enable the apic of running cpu */
+static void lapic_enable(void) {
+
+	lapic_write(LAPIC_REG_TPR, 0);
+	lapic_write(LAPIC_REG_SVR, LAPIC_SVR_ENABLE | IDT_INT_SPURIOUS);
+
+	/* clear errors of the startup sequence */
+	lapic_write(LAPIC_REG_ESR, 0);
+	lapic_write(LAPIC_REG_ESR, 0);
+}
+
+/* reserve page for the registers before heap */
+extern void lapic_init_memory(void) {
+
+	page = page_breakp++;
+}
+
+/* map local apic registers and enable the apic of the boot processor */
+extern bool lapic_init(uint32_t base) {
+
+	if (!cpu_has_feature(CPU_FEATURE_APIC) || !page) return false;
+
+	/* the msr knows where the registers really are */
+	if (cpu_has_feature(CPU_FEATURE_MSR)) {
+
+		uint64_t msr = cpu_rdmsr(LAPIC_MSR_BASE);
+		base = (uint32_t)msr & ~0xfff;
+		cpu_wrmsr(LAPIC_MSR_BASE, msr | LAPIC_MSR_BASE_ENABLE);
+	}
+	if (!base) base = LAPIC_DEFAULT_BASE;
+
+	page_map_flags(page, base >> 12, PAGE_FLAG_PCD | PAGE_FLAG_PWT);
+	regs = (volatile uint32_t *)PAGE_ADDR(page);
+
+	/* legacy pic interrupts keep arriving through lint0 */
+	lapic_write(LAPIC_REG_LVT_LINT0, LAPIC_LVT_EXTINT);
+	lapic_write(LAPIC_REG_LVT_LINT1, LAPIC_ICR_NMI);
+	lapic_enable();
+	return true;
+}
+
+/* enable the apic of an application processor */
+extern void lapic_init_ap(void) {
+
+	/* only the boot processor takes pic interrupts */
+	lapic_write(LAPIC_REG_LVT_LINT0, LAPIC_LVT_MASKED);
+	lapic_write(LAPIC_REG_LVT_LINT1, LAPIC_ICR_NMI);
+	lapic_write(LAPIC_REG_LVT_ERROR, LAPIC_LVT_MASKED);
+
+	/* stopped until the scheduler arms it, the rate is measured on the boot processor */
+	lapic_write(LAPIC_REG_TIMER_DIV, LAPIC_TIMER_DIV16);
+	lapic_write(LAPIC_REG_TIMER_INIT, 0);
+	lapic_write(LAPIC_REG_LVT_TIMER, IDT_INT_TIMER);
+	lapic_enable();
+}
+
+/* check if the local apic is in use */
+extern bool lapic_present(void) {
+
+	return regs != NULL;
+}
+
+/* get apic id of running cpu */
+extern uint32_t lapic_id(void) {
+
+	return lapic_read(LAPIC_REG_ID) >> 24;
+}
+
+/* signal end of interrupt */
+extern void lapic_eoi(void) {
+
+	lapic_write(LAPIC_REG_EOI, 0);
+}
+
+/* send interrupt to one cpu */
+extern void lapic_send_ipi(uint32_t apicid, uint32_t vector) {
+
+	lapic_command(apicid, LAPIC_ICR_FIXED | LAPIC_ICR_ASSERT | vector);
+}
+
+/* send interrupt to all other cpus */
+extern void lapic_send_others(uint32_t vector) {
+
+	lapic_command(0, LAPIC_ICR_FIXED | LAPIC_ICR_ASSERT | LAPIC_ICR_OTHERS | vector);
+}
+
+/* reset cpu into wait-for-startup state */
+extern void lapic_send_init(uint32_t apicid) {
+
+	lapic_command(apicid, LAPIC_ICR_INIT | LAPIC_ICR_ASSERT | LAPIC_ICR_LEVEL);
+	lapic_command(apicid, LAPIC_ICR_INIT | LAPIC_ICR_LEVEL);
+}
+
+/* start cpu in real mode at page aligned address */
+extern void lapic_send_startup(uint32_t apicid, uint32_t addr) {
+
+	lapic_command(apicid, LAPIC_ICR_STARTUP | (addr >> 12));
+}
+
+/* measure timer rate against the pit (interrupts disabled by caller) */
+extern bool lapic_timer_init(void) {
+
+	if (!regs) return false;
+
+	uint32_t div = PIT_FREQ(LAPIC_TIMER_CALIBRATE_HZ);
+	lapic_write(LAPIC_REG_TIMER_DIV, LAPIC_TIMER_DIV16);
+	lapic_write(LAPIC_REG_LVT_TIMER, LAPIC_LVT_MASKED);
+	lapic_write(LAPIC_REG_TIMER_INIT, LAPIC_TIMER_MAX);
+	pit_wait((uint16_t)div);
+
+	uint32_t counted = LAPIC_TIMER_MAX - lapic_read(LAPIC_REG_TIMER_CUR);
+	lapic_write(LAPIC_REG_TIMER_INIT, 0);
+	if (!counted) return false;
+
+	timer_rate = (uint64_t)counted * PIT_FREQ(1) / div;
+	timer_max = (uint64_t)LAPIC_TIMER_MAX * 1000000000 / timer_rate;
+
+	/* one-shot mode */
+	lapic_write(LAPIC_REG_LVT_TIMER, IDT_INT_TIMER);
+	return true;
+}
+
+/* fire timer interrupt once after nanoseconds (clamped to the longest interval) */
+extern void lapic_timer_set(uint64_t ns) {
+
+	/* round up so the interrupt never comes before the deadline */
+	uint64_t count = (MIN(ns, timer_max) * timer_rate + 999999999) / 1000000000;
+	lapic_write(LAPIC_REG_TIMER_INIT, count? (uint32_t)MIN(count, LAPIC_TIMER_MAX): 1);
+}
+
+/* stop timer of running cpu */
+extern void lapic_timer_stop(void) {
+
+	lapic_write(LAPIC_REG_TIMER_INIT, 0);
+}
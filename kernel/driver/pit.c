@@ -6,6 +6,7 @@
 #include <kernel/types.h>
 #include <kernel/tty.h>
 #include <kernel/idt.h>
+#include <kernel/smp.h>
 #include <kernel/io/port.h>
 #include <kernel/driver/pit.h>
 
@@ -35,7 +36,7 @@ extern void pit_delay(uint32_t div) {
 	pit_set_mode(PIT_COMMAND(PIT_CHANNEL0, PIT_ACCESS_HILO, PIT_MODE_INT));
 	pit_set_channel(PIT_CHANNEL0, (uint8_t)(div & 0xff));
 	pit_set_channel(PIT_CHANNEL0, (uint8_t)((div >> 8) & 0xff));
-	while (!called) asm volatile("hlt");
+	while (!called) smp_halt();
 }
 
 /* delay milliseconds */
@@ -49,6 +50,28 @@ extern void pit_delay_ms(uint32_t ms) {
 	pit_delay(1193 * ms);
 }
 
+/* busy-wait for count on channel 2, works with interrupts disabled */
+extern void pit_wait(uint16_t count) {
+
+	/* gate channel 2 on with the speaker off */
+	uint8_t gate = port_inb(PIT_PORT_GATE);
+	port_outb(PIT_PORT_GATE, (gate & ~PIT_GATE_SPEAKER) | PIT_GATE_CH2);
+
+	pit_set_mode(PIT_COMMAND(PIT_CHANNEL2, PIT_ACCESS_HILO, PIT_MODE_INT));
+	pit_set_channel(PIT_CHANNEL2, (uint8_t)(count & 0xff));
+	pit_set_channel(PIT_CHANNEL2, (uint8_t)((count >> 8) & 0xff));
+
+	while (!(port_inb(PIT_PORT_GATE) & PIT_GATE_OUT2));
+	port_outb(PIT_PORT_GATE, gate);
+}
+
+/* stop channel 0 interrupts */
+extern void pit_stop(void) {
+
+	/* a new mode without a count leaves the counter waiting */
+	pit_set_mode(PIT_COMMAND(PIT_CHANNEL0, PIT_ACCESS_HILO, PIT_MODE_INT));
+}
+
 /* set operating mode */
 extern void pit_set_mode(uint8_t mode) {
 
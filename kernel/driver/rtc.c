@@ -186,3 +186,19 @@ extern uint64_t rtc_get_time(rtc_cmos_regs_t *regs) {
 	t += tm_sec;
 	return t;
 }
+
+/* read seconds since the epoch, waiting for a consistent reading */
+extern uint64_t rtc_read(void) {
+
+	rtc_cmos_regs_t regs;
+	uint64_t prev, t = 0;
+
+	/* registers are not valid while an update is in progress */
+	do {
+		prev = t;
+		while (rtc_read_cmos_reg(RTC_CMOS_REG_STATUS_A) & RTC_STATUS_A_UIP);
+		rtc_get_registers(&regs);
+		t = rtc_get_time(&regs);
+	} while (t != prev);
+	return t;
+}
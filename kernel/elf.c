@@ -8,12 +8,93 @@
 #include <kernel/string.h>
 #include <kernel/task.h>
 #include <kernel/mm/paging.h>
+#include <kernel/mm/heap.h>
 #include <kernel/vfs/fs.h>
 #include <ec/elf.h>
 #include <kernel/elf.h>
 
 static fs_node_t *dummy = NULL; /* dummy node to synchronize task loading */
-static int res = 0; /* result */
+static volatile int res = 0; /* result (set by the loading task, possibly on another cpu) */
+
+/* check if segment can be shared (read-only and no other segment in its pages) */
+static bool text_sharable(fs_node_t *node, elf32_header_t *ehdr, elf32_half_t idx, elf32_program_header_t *phdr) {
+
+	if (phdr->flags & ELF_PH_FLAG_W) return false;
+	if (phdr->paddr & 0xfff) return false;
+
+	uint32_t end = ALIGN(phdr->paddr + phdr->memsz, 4096);
+	for (elf32_half_t i = 0; i < ehdr->phnum; i++) {
+
+		elf32_program_header_t other;
+		uint32_t offset = (uint32_t)ehdr->phoff + (uint32_t)i * (uint32_t)ehdr->phentsize;
+
+		if (i == idx) continue;
+		if (fs_read(node, offset, sizeof(other), (uint8_t *)&other) != sizeof(other)) return false;
+		if (other.type != ELF_PH_TYPE_LOAD) continue;
+
+		if (other.paddr < end && other.paddr + other.memsz > phdr->paddr)
+			return false;
+	}
+	return true;
+}
+
+/* map cached segment */
+static bool text_map(fs_node_t *node, elf32_program_header_t *phdr) {
+
+	page_id_t start = phdr->paddr >> 12;
+	uint32_t count = ALIGN(phdr->memsz, 4096) >> 12;
+
+	elf_text_t *text = node->text;
+	for (; text; text = text->next) {
+		if (text->start == start && text->count == count && text->offset == phdr->offset)
+			break;
+	}
+	if (!text) return false;
+
+	task_lockcli();
+	for (uint32_t i = 0; i < count; i++) {
+
+		if (text->frames[i] && page_frame_ref(text->frames[i])) {
+
+			page_map_readonly(start + i, text->frames[i], PAGE_FLAG_US);
+			task_account(task_active, start + i, 1);
+		}
+	}
+	task_unlockcli();
+	return true;
+}
+
+/* keep frames of loaded segment for other tasks */
+static void text_cache(fs_node_t *node, elf32_program_header_t *phdr) {
+
+	page_id_t start = phdr->paddr >> 12;
+	uint32_t count = ALIGN(phdr->memsz, 4096) >> 12;
+
+	task_lockcli();
+	elf_text_t *text = (elf_text_t *)kmalloc(sizeof(elf_text_t) + count * sizeof(page_frame_id_t));
+	if (!text) {
+
+		task_unlockcli();
+		return;
+	}
+
+	text->offset = phdr->offset;
+	text->start = start;
+	text->count = count;
+
+	/* untouched pages stay demand zero */
+	for (uint32_t i = 0; i < count; i++) {
+
+		page_frame_id_t fr = page_is_mapped(start + i)? page_get_frame(start + i): 0;
+		if (fr && page_frame_ref(fr)) page_map_readonly(start + i, fr, PAGE_FLAG_US);
+		else fr = 0;
+		text->frames[i] = fr;
+	}
+
+	text->next = node->text;
+	node->text = text;
+	task_unlockcli();
+}
 
 /* entry point */
 static void load_entry() {
@@ -28,16 +109,21 @@ static void load_entry() {
 		task_terminate();
 	}
 
+	/* the shrinker must not free the node before it is open */
+	fs_node_pin(node);
+
 	/* open file */
 	if (node->refcnt && !(node->oflags & FS_READ)) {
 
 		kprintf(LOG_WARNING, "[elf] Failed to open file '%s' as readable", task_active->load.path);
 		res = -1; /* should (probably) be -EBUSY */
+		fs_node_unpin(node);
 		task_unlockcli();
 		task_terminate();
 	}
 	if (node->refcnt) fs_open(node, node->oflags);
 	else fs_open(node, FS_READ);
+	fs_node_unpin(node);
 
 	/* validate header */
 	elf32_header_t ehdr;
@@ -76,19 +162,14 @@ static void load_entry() {
 
 		if (phdr.type != ELF_PH_TYPE_LOAD) continue;
 
-		/* allocate memory for program data */
+		/* reserve memory for program data (mapped on demand) */
 		elf32_addr_t end = phdr.paddr + phdr.memsz;
-		if (end > task_active->brkp) {
-
-			uint32_t startp = task_active->brkp >> 12;
-			uint32_t endp = ALIGN(end, 4096) >> 12;
-
-			for (uint32_t i = startp; i < endp; i++) {
-				if (!page_is_mapped(i))
-					page_map_flags(i, page_frame_alloc(), PAGE_FLAG_US);
-			}
+		if (end > task_active->brkp)
 			task_active->brkp = end;
-		}
+
+		/* share read-only segments loaded by other tasks */
+		bool shared = text_sharable(node, &ehdr, i, &phdr);
+		if (shared && text_map(node, &phdr)) continue;
 
 		/* load program data */
 		if (fs_read(node, phdr.offset, (size_t)phdr.filesz, (uint8_t *)phdr.paddr) != (kssize_t)phdr.filesz) {
@@ -99,12 +180,21 @@ static void load_entry() {
 			task_terminate();
 		}
 
-		void *bss_addr = (void *)phdr.paddr + phdr.filesz;
-		size_t bss_size = (size_t)(phdr.memsz - phdr.filesz);
-		memset(bss_addr, 0, bss_size);
+		/* untouched pages are already zero */
+		uint32_t bss = phdr.paddr + phdr.filesz;
+		while (bss < end) {
+
+			uint32_t next = MIN(ALIGN(bss + 1, 4096), end);
+			if (page_is_mapped(bss >> 12))
+				memset((void *)bss, 0, next - bss);
+			bss = next;
+		}
+
+		if (shared) text_cache(node, &phdr);
 	}
 
 	task_active->entp = ehdr.entry;
+	task_active->mem.brkbase = task_active->brkp;
 
 	fs_close(node);
 
@@ -112,6 +202,23 @@ static void load_entry() {
 	task_entry();
 }
 
+/* drop cached segments of an executable */
+extern void elf_drop_text(fs_node_t *node) {
+
+	task_lockcli();
+	while (node->text) {
+
+		elf_text_t *text = node->text;
+		node->text = text->next;
+
+		for (uint32_t i = 0; i < text->count; i++) {
+			if (text->frames[i]) page_frame_unref(text->frames[i]);
+		}
+		kfree(text);
+	}
+	task_unlockcli();
+}
+
 /* load an executable */
 extern int elf_load_task(const char *path, const char **argv, const char **envp, bool freeargs) {
 
@@ -131,13 +238,16 @@ extern int elf_load_task(const char *path, const char **argv, const char **envp,
 	int pid = task->id;
 	
 	task->load.path = path;
+	task_set_name(task, path);
 	task->argv = argv;
 	task->envp = envp;
 	task->freeargs = freeargs;
 	task->uid = task_active->uid;
 	
 	task_unlockcli();
-	while (!res);
+
+	/* the new task may start on another cpu */
+	while (!res) smp_relax();
 	int pres = res;
 	res = 0;
 
@@ -7,6 +7,7 @@
 #include <kernel/string.h>
 #include <kernel/panic.h>
 #include <kernel/mm/heap.h>
+#include <kernel/mm/slab.h>
 #include <kernel/driver/device.h>
 #include <kernel/fs/ecfs.h>
 
@@ -51,6 +52,8 @@ struct ecfs_node {
 	uint32_t ext[TRACKEXT]; /* extension blocks */
 };
 
+static kmem_cache_t *file_cache = NULL; /* open file info cache */
+
 static inline fs_node_t *node_new(fs_node_t *parent, uint32_t flags) {
 
 	return fs_node_new_ext(parent, flags, sizeof(struct ecfs_node));
@@ -185,10 +188,13 @@ static kssize_t ecfs_write(fs_node_t *node, uint32_t offset, size_t nbytes, uint
 /* open file */
 static void ecfs_open(fs_node_t *node, uint32_t flags) {
 
+	/* file info is shared between opens */
+	if (node->refcnt) return;
+
 	struct ecfs_fs_info *info = (struct ecfs_fs_info *)node->data;
 	info->held = true;
 
-	node->odata = kmalloc(sizeof(struct ecfs_file_info));
+	node->odata = kmem_cache_alloc(file_cache);
 	struct ecfs_file_info *file = (struct ecfs_file_info *)node->odata;
 
 	file->bblk = 0;
@@ -205,6 +211,8 @@ static void ecfs_open(fs_node_t *node, uint32_t flags) {
 
 /* close file */
 static void ecfs_close(fs_node_t *node) {
+
+	if (node->refcnt > 1) return;
 	
 	struct ecfs_fs_info *info = (struct ecfs_fs_info *)node->data;
 	info->held = true;
@@ -213,7 +221,7 @@ static void ecfs_close(fs_node_t *node) {
 	kfree(file->bdata);
 	kfree(file->adata);
 
-	kfree(file);
+	kmem_cache_free(file_cache, file);
 	node->odata = NULL;
 	info->held = false;
 }
@@ -292,6 +300,8 @@ extern fs_node_t *ecfs_mbr_mount(fs_node_t *mountp, device_t *dev, mbr_ent_t *pa
 
 	if (mountp->ptr) return NULL;
 
+	if (!file_cache) file_cache = kmem_cache_create("ecfs_file_info", sizeof(struct ecfs_file_info), NULL);
+
 	struct ecfs_fs_info *info = kmalloc(sizeof(struct ecfs_fs_info));
 
 	/* read head block */
@@ -7,6 +7,8 @@
 #include <kernel/string.h>
 #include <kernel/panic.h>
 #include <kernel/mm/heap.h>
+#include <kernel/mm/slab.h>
+#include <kernel/mm/shrink.h>
 #include <kernel/vfs/fs.h>
 #include <kernel/driver/device.h>
 #include <kernel/fs/mbr.h>
@@ -39,6 +41,7 @@ struct ext2_fs_info {
 	uint32_t curblock; /* current read block */
 	void *block; /* block data */
 	bool held; /* file system busy */
+	struct ext2_fs_info *next; /* next mounted file system */
 };
 
 /* open file info */
@@ -50,6 +53,15 @@ struct ext2_file_info {
 	ext2_inode_t inode; /* inode data */
 };
 
+static kmem_cache_t *file_cache = NULL; /* open file info cache */
+static struct ext2_fs_info *mounted = NULL; /* mounted file systems */
+
+static uint32_t ext2_shrink(uint32_t count);
+static shrinker_t shrinker = {
+	.name = "ext2_block",
+	.scan = ext2_shrink,
+};
+
 /* translate ext2 inode type */
 static uint32_t ext2_translate_type(uint32_t type) {
 
@@ -62,6 +74,23 @@ static uint32_t ext2_translate_type(uint32_t type) {
 	return out;
 }
 
+/* release block buffers of idle file systems */
+static uint32_t ext2_shrink(uint32_t count) {
+
+	uint32_t freed = 0;
+	for (struct ext2_fs_info *info = mounted; info && freed < count; info = info->next) {
+
+		if (!info->block || info->held || info->dev->held) continue;
+
+		/* read in again on the next inode access */
+		kfree(info->block);
+		info->block = NULL;
+		info->curblock = 0;
+		freed++;
+	}
+	return freed;
+}
+
 /* verify ext2 filesystem */
 static bool ext2_verify_sb(ext2_superblock_t *sb) {
 
@@ -401,10 +430,13 @@ static kssize_t ext2_write(fs_node_t *node, uint32_t offset, size_t nbytes, uint
 /* open file */
 static void ext2_open(fs_node_t *node, uint32_t flags) {
 
+	/* file info is shared between opens */
+	if (node->refcnt) return;
+
 	struct ext2_fs_info *info = (struct ext2_fs_info *)node->data;
 	info->held = true;
 
-	node->odata = kmalloc(sizeof(struct ext2_file_info));
+	node->odata = kmem_cache_alloc(file_cache);
 	struct ext2_file_info *file = (struct ext2_file_info *)node->odata;
 
 	file->bblk = 0;
@@ -419,6 +451,8 @@ static void ext2_open(fs_node_t *node, uint32_t flags) {
 /* close file */
 static void ext2_close(fs_node_t *node) {
 
+	if (node->refcnt > 1) return;
+
 	struct ext2_fs_info *info = (struct ext2_fs_info *)node->data;
 	info->held = true;
 
@@ -426,6 +460,9 @@ static void ext2_close(fs_node_t *node) {
 	if (file->bdata) kfree(file->bdata);
 	if (file->bpdata) kfree(file->bpdata);
 
+	kmem_cache_free(file_cache, file);
+	node->odata = NULL;
+
 	info->held = false;
 }
 
@@ -498,6 +535,12 @@ extern fs_node_t *ext2_mbr_mount(fs_node_t *mountp, device_t *dev, mbr_ent_t *pa
 
 	if (mountp->ptr) return NULL;
 
+	if (!file_cache) {
+
+		file_cache = kmem_cache_create("ext2_file_info", sizeof(struct ext2_file_info), NULL);
+		shrink_register(&shrinker);
+	}
+
 	struct ext2_fs_info *info = kmalloc(sizeof(struct ext2_fs_info));
 
 	/* read superblock */
@@ -519,6 +562,10 @@ extern fs_node_t *ext2_mbr_mount(fs_node_t *mountp, device_t *dev, mbr_ent_t *pa
 	/* load block group descriptor table */
 	ext2_load_bgdt(info);
 
+	info->held = false;
+	info->next = mounted;
+	mounted = info;
+
 	/* create root node */
 	fs_node_t *node = fs_node_new(NULL, FS_DIRECTORY);
 	node->data = info;
@@ -8,6 +8,7 @@
 #include <kernel/panic.h>
 #include <kernel/boot.h>
 #include <kernel/mm/heap.h>
+#include <kernel/mm/swap.h>
 #include <kernel/driver/device.h>
 #include <kernel/fs/tarfs.h>
 #include <kernel/fs/mbr.h>
@@ -119,3 +120,20 @@ extern void mbr_fs_mount_root(void) {
 
 	if (!node) kpanic(PANIC_CODE_NONE, "Failed to mount root file system\n", NULL);
 }
+
+/* search storage devices for a swap partition */
+extern void mbr_swap_probe(void) {
+
+	for (device_t *dev = devclass_storage.first; dev; dev = dev->clsnext) {
+
+		mbr_t *mbr = mbr_get_table(dev);
+		if (!mbr) continue;
+
+		for (int i = 0; i < 4; i++) {
+
+			mbr_ent_t *ent = &mbr->ents[i];
+			if (ent->type == MBR_SWAP && ent->nsects && swap_add(dev, ent->start_lba, ent->nsects))
+				return;
+		}
+	}
+}
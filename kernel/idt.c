@@ -5,10 +5,12 @@
  */
 #include <kernel/types.h>
 #include <kernel/io/port.h>
+#include <kernel/io/cpu.h>
 #include <kernel/mm/gdt.h>
 #include <kernel/tty.h>
 #include <kernel/panic.h>
 #include <kernel/syscall.h>
+#include <kernel/smp.h>
 #include <kernel/idt.h>
 
 static idt_descriptor_t idt_desc;
@@ -21,6 +23,14 @@ static inline void _wait(void) {
 	port_outb(0x80, 0);
 }
 
+/* release kernel lock when returning to code that ran without it (user mode or an idle loop) */
+static inline void idt_leave(bool held) {
+
+	if (held) return;
+	asm volatile("cli");
+	smp_unlock();
+}
+
 /* initialize */
 extern void idt_init(void) {
 
@@ -109,12 +119,37 @@ extern void idt_init(void) {
 	idt_set_gate(IDT_INT_SYSCALL, sysint, IDT_GATE_TYPE_INT);
 	isrs[IDT_INT_SYSCALL] = sys_handle;
 
+	/* inter-processor interrupts */
+	idt_set_gate(IDT_INT_TIMER, apictimer, IDT_GATE_TYPE_INT);
+	idt_set_gate(IDT_INT_RESCHED, ipiresched, IDT_GATE_TYPE_INT);
+	idt_set_gate(IDT_INT_FLUSH, ipiflush, IDT_GATE_TYPE_INT);
+	idt_set_gate(IDT_INT_SPURIOUS, ipispurious, IDT_GATE_TYPE_INT);
+
 	/* load idt */
 	idt_desc.size = sizeof(idt) - 1;
 	idt_desc.addr = (uint32_t)&idt;
+	idt_load();
+	idt_load_sysenter();
+}
+
+/* load idt on running cpu */
+extern void idt_load(void) {
+
 	__asm__("lidt (%0)": : "r"(&idt_desc));
 }
 
+/* set up sysenter on running cpu if it has it */
+extern void idt_load_sysenter(void) {
+
+	if (!cpu_has_sysenter()) return;
+
+	/* the entry stack ends where the tss starts */
+	cpu_t *cpu = smp_cpu();
+	cpu_wrmsr(CPU_MSR_SYSENTER_CS, 0x8); /* supervisor code, the other selectors follow it */
+	cpu_wrmsr(CPU_MSR_SYSENTER_ESP, (uint32_t)cpu->tss);
+	cpu_wrmsr(CPU_MSR_SYSENTER_EIP, (uint32_t)sysenter);
+}
+
 /* enable interrupts */
 extern void idt_enable(void) {
 
@@ -134,31 +169,41 @@ extern void idt_set_gate(uint32_t n, void *p, uint8_t tp) {
 /* main isr handler */
 extern void idt_isr_handler(idt_regs_t *regs) {
 
+	bool held = smp_lock();
+
 	if (isrs[regs->n_int] != NULL) isrs[regs->n_int](regs);
 	else {
 
 		kprintf(LOG_FATAL, "[idt] Exception: %d (code: 0x%x)", regs->n_int, regs->err_code);
 		kpanic(regs->n_int == 14? PANIC_CODE_FAULT: 0, "CPU exception", regs);
 	}
+
+	idt_leave(held);
 }
 
 /* main irq handler */
 extern void idt_irq_handler(idt_regs_t *regs) {
 
+	bool held = smp_lock();
+
 	if (isrs[regs->n_int] != NULL) isrs[regs->n_int](regs);
 
 	/* end of interrupt command */
-	if (regs->n_int >= 40 && regs->n_int < 48 && noeoi[regs->n_int-40])
-		return;
+	if (!(regs->n_int >= 40 && regs->n_int < 48 && noeoi[regs->n_int-40])) {
 
-	port_outb(IDT_PIC0_CMD, IDT_PIC_CMD_EOI);
-	if (regs->n_int >= 40) port_outb(IDT_PIC1_CMD, IDT_PIC_CMD_EOI);
+		port_outb(IDT_PIC0_CMD, IDT_PIC_CMD_EOI);
+		if (regs->n_int >= 40) port_outb(IDT_PIC1_CMD, IDT_PIC_CMD_EOI);
+	}
+
+	idt_leave(held);
 }
 
 /* main int handler */
 extern void idt_int_handler(idt_regs_t *regs) {
 
+	bool held = smp_lock();
 	if (isrs[regs->n_int] != NULL) isrs[regs->n_int](regs);
+	idt_leave(held);
 }
 
 /* set isr callback */
@@ -175,6 +220,13 @@ extern void idt_set_irq_callback(uint32_t n, idt_isr_t isr) {
 	isrs[32 + n] = isr;
 }
 
+/* set software or inter-processor interrupt callback */
+extern void idt_set_int_callback(uint32_t n, idt_isr_t isr) {
+
+	if (n < 48 || n > 255) return;
+	isrs[n] = isr;
+}
+
 /* send eoi command to first pic */
 extern void idt_send_eoi(void) {
 
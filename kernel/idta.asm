@@ -4,6 +4,8 @@
 ; SPDX-License-Identifier: BSD-3-Clause
 ;
 %define SYSINT 0x80
+%define APIC_TIMER 0xf0
+%define IPI_RESCHED 0xf1
 	; be prepared ;
 	global isr0
 	global isr1
@@ -56,11 +58,18 @@
 	global irq15
 	
 	global sysint
+	global sysenter
+	
+	global apictimer
+	global ipiresched
+	global ipiflush
+	global ipispurious
 	
 	; handlers ;
 	extern idt_isr_handler
 	extern idt_irq_handler
 	extern idt_int_handler
+	extern smp_flush_handler
 
 isr0:
 	push byte 0
@@ -308,6 +317,90 @@ sysint:
 	push SYSINT
 	jmp int_common_stub
 
+; fast system calls, with eax, ebx, ecx and edx as for SYSINT, ;
+; the user stack in ebp and the return address in esi ;
+sysenter:
+	mov esp, [esp+4] ; esp0 of the tss above the entry stack ;
+
+	; same frame as SYSINT ;
+	push dword 0x23 ; user data ;
+	push ebp
+	pushfd
+	or dword[esp], 0x200 ; interrupts are enabled in user mode ;
+	push dword 0x1b ; user code ;
+	push esi
+	push byte 0
+	push SYSINT
+
+	pusha ; gp regs ;
+	mov ax, ds
+	push eax ; data segment selector ;
+
+	; kernel data segment ;
+	mov ax, 0x10 ; sp_data ;
+	mov ds, ax
+	mov es, ax
+	mov fs, ax
+	mov ax, 0x30 ; cpu data ;
+	mov gs, ax
+
+	push esp ; idt_regs_t ;
+	call idt_int_handler
+	pop eax
+
+	; restore regs (sysexit keeps gs) ;
+	pop eax
+	mov ds, ax
+	mov es, ax
+	mov fs, ax
+	mov gs, ax
+	popa
+	add esp, 8 ; n_int and err_code ;
+
+	; sysexit takes eip from edx and esp from ecx, so the second return value goes to esi ;
+	mov esi, ecx
+	mov edx, [esp]
+	mov ecx, [esp+12]
+	push dword[esp+8]
+	and dword[esp], ~0x200
+	popfd
+	sti ; takes effect after sysexit ;
+	sysexit
+
+; local apic timer and inter-processor interrupts ;
+apictimer:
+	push byte 0
+	push APIC_TIMER
+	jmp int_common_stub
+
+ipiresched:
+	push byte 0
+	push IPI_RESCHED
+	jmp int_common_stub
+
+ipiflush:
+	; runs without the kernel lock, the cpu sending it holds that ;
+	pusha
+	mov ax, ds
+	push eax
+	
+	mov ax, 0x10 ; sp_data ;
+	mov ds, ax
+	mov es, ax
+	mov ax, 0x30 ; cpu data ;
+	mov gs, ax
+	call smp_flush_handler
+	
+	pop eax
+	mov ds, ax
+	mov es, ax
+	popa
+	iret
+
+ipispurious:
+	; no eoi for spurious interrupts ;
+	iret
+
 ; the moment you've been waiting for ;
 isr_common_stub:
 	pusha ; gp regs ;
@@ -319,6 +412,7 @@ isr_common_stub:
 	mov ds, ax
 	mov es, ax
 	mov fs, ax
+	mov ax, 0x30 ; cpu data (left loaded, returning to user mode drops it) ;
 	mov gs, ax
 	
 	push esp ; idt_regs_t ;
@@ -330,7 +424,6 @@ isr_common_stub:
 	mov ds, ax
 	mov es, ax
 	mov fs, ax
-	mov gs, ax
 	popa
 	
 	add esp, 8 ; n_int and err_code ;
@@ -347,6 +440,7 @@ irq_common_stub:
 	mov ds, ax
 	mov es, ax
 	mov fs, ax
+	mov ax, 0x30 ; cpu data (left loaded, returning to user mode drops it) ;
 	mov gs, ax
 	
 	push esp ; idt_regs_t ;
@@ -358,7 +452,6 @@ irq_common_stub:
 	mov ds, ax
 	mov es, ax
 	mov fs, ax
-	mov gs, ax
 	popa
 	
 	add esp, 8 ; n_int and err_code ;
@@ -375,6 +468,7 @@ int_common_stub:
 	mov ds, ax
 	mov es, ax
 	mov fs, ax
+	mov ax, 0x30 ; cpu data (left loaded, returning to user mode drops it) ;
 	mov gs, ax
 	
 	push esp ; idt_regs_t ;
@@ -386,7 +480,6 @@ int_common_stub:
 	mov ds, ax
 	mov es, ax
 	mov fs, ax
-	mov gs, ax
 	popa
 	
 	add esp, 8 ; n_int and err_code ;
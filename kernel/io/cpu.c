@@ -0,0 +1,85 @@
+/*
+ * Copyright 2025-2026, Elliot Kohlmyer
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <kernel/types.h>
+#include <kernel/io/cpu.h>
+
+/* get cpu identification */
+extern void cpu_cpuid(uint32_t leaf, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx) {
+
+	asm volatile("cpuid": "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx): "a"(leaf), "c"(0));
+}
+
+/* check for leaf 1 edx feature */
+extern bool cpu_has_feature(uint32_t feature) {
+
+	uint32_t eax, ebx, ecx, edx;
+	cpu_cpuid(1, &eax, &ebx, &ecx, &edx);
+	return (edx & feature) == feature;
+}
+
+/* check if sysenter works (early cpus report it without having it) */
+extern bool cpu_has_sysenter(void) {
+
+	uint32_t eax, ebx, ecx, edx;
+	cpu_cpuid(1, &eax, &ebx, &ecx, &edx);
+	if (!(edx & CPU_FEATURE_SEP)) return false;
+
+	/* pentium pro before model 3, stepping 3 */
+	uint32_t family = (eax >> 8) & 0xf, model = (eax >> 4) & 0xf, stepping = eax & 0xf;
+	return !(family == 6 && model < 3 && stepping < 3);
+}
+
+/* read time stamp counter */
+extern uint64_t cpu_rdtsc(void) {
+
+	uint32_t lo, hi;
+	asm volatile("rdtsc": "=a"(lo), "=d"(hi));
+	return ((uint64_t)hi << 32) | lo;
+}
+
+/* read model specific register */
+extern uint64_t cpu_rdmsr(uint32_t msr) {
+
+	uint32_t lo, hi;
+	asm volatile("rdmsr": "=a"(lo), "=d"(hi): "c"(msr));
+	return ((uint64_t)hi << 32) | lo;
+}
+
+/* write model specific register */
+extern void cpu_wrmsr(uint32_t msr, uint64_t value) {
+
+	asm volatile("wrmsr": : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+/* get control register 4 */
+extern uint32_t cpu_get_cr4(void) {
+
+	uint32_t cr4;
+	asm volatile("mov %%cr4, %0": "=r"(cr4));
+	return cr4;
+}
+
+/* set control register 4 */
+extern void cpu_set_cr4(uint32_t cr4) {
+
+	asm volatile("mov %0, %%cr4": : "r"(cr4));
+}
+
+/* disable interrupts, returning the previous eflags */
+extern uint32_t cpu_irq_save(void) {
+
+	uint32_t eflags;
+	asm volatile("pushf\n"
+		"pop %0\n"
+		"cli": "=r"(eflags):: "memory");
+	return eflags;
+}
+
+/* enable interrupts again if they were enabled */
+extern void cpu_irq_restore(uint32_t eflags) {
+
+	if (eflags & CPU_EFLAGS_IF) asm volatile("sti": : : "memory");
+}
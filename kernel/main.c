@@ -4,15 +4,18 @@
  * SPDX-License-Identifier: BSD-3-Clause
  */
 #include <kernel/types.h>
+#include <kernel/clock.h>
 #include <kernel/idt.h>
 #include <kernel/tty.h>
 #include <kernel/boot.h>
 #include <kernel/init.h>
+#include <kernel/smp.h>
 #include <kernel/users.h>
-#include <kernel/mm/gdt.h>
 #include <kernel/mm/paging.h>
 #include <kernel/mm/heap.h>
+#include <kernel/mm/swap.h>
 #include <kernel/driver/device.h>
+#include <kernel/driver/lapic.h>
 #include <kernel/vfs/fs.h>
 #include <kernel/vfs/devfs.h>
 #include <kernel/vfs/ramfs.h>
@@ -23,29 +26,38 @@ uint8_t os_version[3] = {0, 0, 2};
 
 extern void kernel_main() {
 
-	gdt_init();
+	smp_init_bsp();
 	idt_init();
 	idt_enable();
 	page_init();
 	boot_init();
+	page_frame_init_buddy();
 	page_init_top();
 	task_init_memory();
+	lapic_init_memory();
 	heap_init();
 	fs_init();
 	tty_init();
+	clock_init();
 	device_init();
 	boot_log();
 	mbr_fs_mount_root();
+	swap_init();
+	mbr_swap_probe();
 	devfs_init();
 	ramfs_init();
 	user_init();
 	task_init();
+	smp_init();
+	task_init_tickless();
 	init_load();
 
 	while (true) {
 
 		task_cleanup();
 		device_update();
-		asm volatile("hlt");
+
+		/* zero frames ahead of time, only sleeping once the pool is full */
+		if (page_frame_refill_zeroed()) smp_halt();
 	}
 }
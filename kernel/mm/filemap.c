@@ -0,0 +1,78 @@
+/*
+ * Copyright 2025-2026, Elliot Kohlmyer
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <kernel/types.h>
+#include <kernel/string.h>
+#include <kernel/mm/paging.h>
+#include <kernel/mm/heap.h>
+#include <kernel/mm/filemap.h>
+
+/* make room for page index */
+static filemap_t *filemap_grow(fs_node_t *node, uint32_t npages) {
+
+	filemap_t *map = node->map;
+	if (map && map->npages >= npages) return map;
+
+	filemap_t *nmap = (filemap_t *)kmalloc(sizeof(filemap_t) + npages * sizeof(page_frame_id_t));
+	if (!nmap) return NULL;
+
+	nmap->npages = npages;
+	nmap->nloaded = 0;
+	memset(nmap->frames, 0, npages * sizeof(page_frame_id_t));
+
+	if (map) {
+
+		nmap->nloaded = map->nloaded;
+		memcpy(nmap->frames, map->frames, map->npages * sizeof(page_frame_id_t));
+		kfree(map);
+	}
+
+	node->map = nmap;
+	return nmap;
+}
+
+/* get frame of file page, reading it in if needed */
+extern page_frame_id_t filemap_get(fs_node_t *node, uint32_t index) {
+
+	uint32_t npages = ALIGN(node->len, PAGE_SIZE) / PAGE_SIZE;
+	if (index >= npages) return 0;
+
+	filemap_t *map = filemap_grow(node, npages);
+	if (!map) return 0;
+	if (map->frames[index]) return map->frames[index];
+
+	/* read page, the tail past the end of file stays zero */
+	page_frame_id_t fr = page_frame_alloc_zeroed();
+	if (!fr) return 0;
+
+	uint8_t *buf = (uint8_t *)page_map_temp(fr);
+	kssize_t res = fs_read(node, index * PAGE_SIZE, PAGE_SIZE, buf);
+	page_unmap_temp();
+
+	if (res < 0) {
+
+		page_frame_free(fr);
+		return 0;
+	}
+
+	map->frames[index] = fr;
+	map->nloaded++;
+	return fr;
+}
+
+/* release cached pages of file */
+extern void filemap_drop(fs_node_t *node) {
+
+	filemap_t *map = node->map;
+	if (!map) return;
+
+	/* frames still mapped by tasks live on until they are unmapped */
+	for (uint32_t i = 0; i < map->npages; i++) {
+		if (map->frames[i]) page_frame_unref(map->frames[i]);
+	}
+
+	node->map = NULL;
+	kfree(map);
+}
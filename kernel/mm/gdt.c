@@ -5,21 +5,32 @@
  */
 #include <kernel/types.h>
 #include <kernel/string.h>
+#include <kernel/smp.h>
 #include <kernel/mm/gdt.h>
 
-static gdt_segment_descriptor_t gdt[GDT_SEGMENT_COUNT];
-static gdt_descriptor_t gdt_desc;
+/* every cpu has its own table, differing in the tss and cpu data segment */
+static gdt_segment_descriptor_t gdts[SMP_MAXCPUS][GDT_SEGMENT_COUNT];
+static gdt_descriptor_t gdt_descs[SMP_MAXCPUS];
 
-gdt_tss_t gdt_tss;
+/* sysenter starts on the entry stack and loads esp0 from the tss right above it */
+static struct {
+	uint8_t stack[GDT_ENTRY_STACKSZ];
+	gdt_tss_t tss;
+} __attribute__((packed, aligned(16))) tsss[SMP_MAXCPUS];
 
 extern void kernel_stack_top(void);
 
-/* initialize gdt with two segments per privelige level */
-extern void gdt_init(void) {
+/* initialize gdt of cpu with two segments per privelige level */
+extern void gdt_init(cpu_t *cpu) {
 
-	memset(&gdt_tss, 0, sizeof(gdt_tss));
-	gdt_tss.esp0 = (uint32_t)kernel_stack_top;
-	gdt_tss.ss0 = 16;
+	gdt_segment_descriptor_t *gdt = gdts[cpu->id];
+	gdt_descriptor_t *gdt_desc = &gdt_descs[cpu->id];
+	gdt_tss_t *tss = &tsss[cpu->id].tss;
+
+	memset(tss, 0, sizeof(gdt_tss_t));
+	tss->esp0 = (uint32_t)kernel_stack_top;
+	tss->ss0 = 16;
+	cpu->tss = tss;
 
 	/* supervisor */
 	gdt[GDT_SEGMENT_SP_CODE].lim0 = 0xFFFF;
@@ -59,30 +70,44 @@ extern void gdt_init(void) {
 	gdt[GDT_SEGMENT_US_DATA].flags = GDT_SEGMENT_FLAG_DB |
 					 GDT_SEGMENT_FLAG_G;
 
-	uint32_t tss_base = (uint32_t)&gdt_tss;
+	uint32_t tss_base = (uint32_t)tss;
 
-	gdt[GDT_SEGMENT_TSS].lim0 = sizeof(gdt_tss) & 0xffff;
+	gdt[GDT_SEGMENT_TSS].lim0 = sizeof(gdt_tss_t) & 0xffff;
 	gdt[GDT_SEGMENT_TSS].acc = GDT_SEGMENT_ACCESS_A |
 				   GDT_SEGMENT_ACCESS_E |
 				   GDT_SEGMENT_ACCESS_P;
-	gdt[GDT_SEGMENT_TSS].lim1 = (sizeof(gdt_tss) >> 16) & 0xf;
+	gdt[GDT_SEGMENT_TSS].lim1 = (sizeof(gdt_tss_t) >> 16) & 0xf;
 	gdt[GDT_SEGMENT_TSS].flags = 0;
 	gdt[GDT_SEGMENT_TSS].base0 = tss_base & 0xffffff;
 	gdt[GDT_SEGMENT_TSS].base2 = (tss_base >> 24) & 0xff;
 
+	/* per-cpu data (kept in gs) */
+	uint32_t cpu_base = (uint32_t)cpu;
+
+	gdt[GDT_SEGMENT_CPU].lim0 = sizeof(cpu_t) & 0xffff;
+	gdt[GDT_SEGMENT_CPU].acc = GDT_SEGMENT_ACCESS_RW |
+				   GDT_SEGMENT_ACCESS_S |
+				   GDT_SEGMENT_ACCESS_P;
+	gdt[GDT_SEGMENT_CPU].lim1 = (sizeof(cpu_t) >> 16) & 0xf;
+	gdt[GDT_SEGMENT_CPU].flags = GDT_SEGMENT_FLAG_DB;
+	gdt[GDT_SEGMENT_CPU].base0 = cpu_base & 0xffffff;
+	gdt[GDT_SEGMENT_CPU].base2 = (cpu_base >> 24) & 0xff;
+
 	/* descriptor */
-	gdt_desc.size = sizeof(gdt) - 1;
-	gdt_desc.addr = (unsigned long)gdt;
+	gdt_desc->size = sizeof(gdts[0]) - 1;
+	gdt_desc->addr = (unsigned long)gdt;
 
 	/* load gdt */
-	asm volatile("lgdt (gdt_desc)\n"
-			 "mov $16,%ax\n"
-			 "mov %ax,%ds\n"
-			 "mov %ax,%es\n"
-			 "mov %ax,%fs\n"
-			 "mov %ax,%gs\n"
-			 "jmp $8,$random_label\n"
-			 "random_label:");
+	asm volatile("lgdt (%0)\n"
+			 "mov $16,%%ax\n"
+			 "mov %%ax,%%ds\n"
+			 "mov %%ax,%%es\n"
+			 "mov %%ax,%%fs\n"
+			 "mov %%ax,%%ss\n"
+			 "mov $48,%%ax\n"
+			 "mov %%ax,%%gs\n"
+			 "ljmp $8,$1f\n"
+			 "1:": : "r"(gdt_desc): "eax", "memory");
 	gdt_flush_tss();
 }
 
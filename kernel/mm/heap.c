@@ -5,240 +5,807 @@
  */
 #include <kernel/types.h>
 #include <kernel/tty.h>
+#include <kernel/string.h>
+#include <kernel/task.h>
 #include <kernel/mm/paging.h>
 #include <kernel/mm/heap.h>
+#include <kernel/mm/shrink.h>
+#include <kernel/driver/uart.h>
+#include <kernel/vfs/devfs.h>
+#include <errno.h>
 
-static heap_block_t *head = NULL;
-static heap_block_t *last = NULL;
+/*
+ * Small allocations come from a single arena of boundary-tagged blocks.
+ * Free blocks are kept in power-of-two size class bins, and the tags on
+ * both ends of a block let kfree merge with its neighbours directly.
+ * Large allocations get whole pages mapped in a separate address range.
+ */
 
-/* initialize heap */
-extern void heap_init(void) {
+#define TAG_USED 0x1
+#define TAG_SIZE(t) ((t) & ~(heap_tag_t)3)
 
-	page_frame_id_t fr = page_frame_alloc();
-	page_id_t pg = page_breakp;
-	page_map(page_breakp, fr);
+#define MINBLOCK (sizeof(heap_block_t) + sizeof(heap_tag_t))
+#define BINSCAN 4 /* number of blocks checked in the lowest bin */
+#define TRIMSIZE 0x10000 /* free space at the top of the arena before it is unmapped */
+
+#define FTR(b, sz) (*(heap_tag_t *)((void *)(b) + (sz) - sizeof(heap_tag_t)))
+#define PREVFTR(b) (*(heap_tag_t *)((void *)(b) - sizeof(heap_tag_t)))
+#define NEXTBLK(b) ((heap_block_t *)((void *)(b) + TAG_SIZE((b)->tag)))
+
+static heap_block_t *bins[HEAP_NBINS];
+static uint32_t binmap = 0; /* bins with free blocks */
+static heap_stats_t stats;
+
+static void *arena_start = NULL;
+static heap_block_t *arena_end = NULL; /* epilogue tag */
+static page_id_t arena_mapped = 0; /* first unmapped arena page */
+
+/* free address space for large allocations */
+typedef struct heap_extent {
+	page_id_t start; /* first page */
+	uint32_t count; /* number of pages */
+	struct heap_extent *next; /* next extent */
+} heap_extent_t;
+
+static heap_extent_t *extents = NULL;
+
+/* get bin for block size */
+static inline uint32_t bin_index(size_t sz) {
 
-	/* setup head block */
-	head = PAGE_ADDR(pg);
-	head->size = 0;
-	head->avail = false;
-	head->page = pg;
-	head->prev = NULL;
-	head->next = NULL;
+	uint32_t i = (31 - __builtin_clz(sz)) - HEAP_MINSHIFT;
+	return MIN(i, HEAP_NBINS-1);
 }
 
-/* find unused block */
-extern heap_block_t *heap_find(heap_block_t *b, size_t sz) {
+/* set header and footer tags */
+static inline void set_tags(heap_block_t *b, size_t sz, heap_tag_t flags) {
+
+	b->tag = sz | flags;
+	FTR(b, sz) = sz | flags;
+}
+
+/* add free block to bin */
+static void bin_insert(heap_block_t *b) {
+
+	size_t sz = TAG_SIZE(b->tag);
+	uint32_t i = bin_index(sz);
+
+	b->prev = NULL;
+	b->next = bins[i];
+	if (bins[i]) bins[i]->prev = b;
+	bins[i] = b;
+	binmap |= 1 << i;
+
+	stats.bins[i].nfree++;
+	stats.bins[i].free += sz;
+}
+
+/* remove free block from bin */
+static void bin_remove(heap_block_t *b) {
+
+	size_t sz = TAG_SIZE(b->tag);
+	uint32_t i = bin_index(sz);
+
+	if (b->prev) b->prev->next = b->next;
+	else bins[i] = b->next;
+	if (b->next) b->next->prev = b->prev;
+	if (!bins[i]) binmap &= ~(1 << i);
+
+	stats.bins[i].nfree--;
+	stats.bins[i].free -= sz;
+}
 
-	heap_block_t *p = b;
-	heap_block_t *l = NULL;
-	while (p) {
+/* find free block */
+static heap_block_t *bin_find(size_t sz) {
 
-		/* usable */
-		if ((p->size >= sz || !p->next) && p->avail)
-			return p;
+	uint32_t i = bin_index(sz);
 
-		l = p;
-		p = p->next;
+	/* blocks in the lowest bin may be too small */
+	heap_block_t *b = bins[i];
+	for (int n = 0; b && (n < BINSCAN || i == HEAP_NBINS-1); n++, b = b->next) {
+		if (TAG_SIZE(b->tag) >= sz)
+			return b;
 	}
-	
-	/* set next block */
-	l->next = (void *)(l + 1) + l->size;
-	l->next->size = 0;
-	l->next->avail = true;
-	l->next->page = (uint32_t)l->next >> 12;
-	l->next->prev = l;
-	l->next->next = NULL;
-	return l->next;
+
+	/* any block in a higher bin fits */
+	uint32_t mask = binmap & ~((2u << i) - 1);
+	if (i >= HEAP_NBINS-1 || !mask) return NULL;
+	return bins[__builtin_ctz(mask)];
 }
 
-/* find an aligned block */
-extern heap_block_t *heap_find_aligned(heap_block_t *b, size_t sz, size_t a) {
+/* grow arena for a new block */
+static heap_block_t *arena_extend(size_t sz) {
+
+	heap_block_t *b = arena_end;
+
+	/* merge with free block at the top */
+	if (!(PREVFTR(b) & TAG_USED)) {
+
+		b = (void *)b - TAG_SIZE(PREVFTR(b));
+		sz = MAX(sz, TAG_SIZE(b->tag));
+	}
+
+	void *end = (void *)b + sz;
+	if ((uint32_t)end + sizeof(heap_tag_t) > (uint32_t)PAGE_ADDR(HEAP_LARGE_START))
+		return NULL;
 
-	heap_block_t *p = b;
-	heap_block_t *l = NULL;
-	while (p) {
+	/* map pages (a shrink would free into the block being grown) */
+	page_id_t last = ALIGN((uint32_t)end + sizeof(heap_tag_t), PAGE_SIZE) >> 12;
+	shrink_lock();
+	for (; arena_mapped < last; arena_mapped++) {
 
-		/* usable */
-		if ((p->size >= sz || !p->next) && p->avail &&\
-		    !(((size_t)p + sizeof(heap_block_t)) & (a-1)))
-			return p;
+		page_frame_id_t fr = page_frame_alloc();
+		if (!fr) {
 
-		l = p;
-		p = p->next;
+			shrink_unlock();
+			return NULL;
+		}
+		page_map(arena_mapped, fr);
 	}
+	shrink_unlock();
+	if (b != arena_end) bin_remove(b);
 
-	size_t pl = (size_t)(l + 1);
-	pl = ALIGN(pl + l->size + sizeof(heap_block_t), a) - pl - sizeof(heap_block_t);
+	set_tags(b, sz, 0);
+	arena_end = end;
+	arena_end->tag = TAG_USED;
 
-	/* set next block */
-	l->next = (heap_block_t *)((void *)(l + 1) + pl);
-	l->next->size = 0;
-	l->next->avail = true;
-	l->next->page = (uint32_t)l->next >> 12;
-	l->next->prev = l;
-	l->next->next = NULL;
+	stats.arena = (size_t)(PAGE_ADDR(arena_mapped) - arena_start);
+	return b;
+}
+
+/* get a free block out of the bins or the top of the arena */
+static heap_block_t *block_get(size_t sz) {
 
-	heap_block_t *bp = l->next;
+	heap_block_t *b = bin_find(sz);
 
-	/* insert block */
-	size_t nsz = pl - l->size;
+	/* growing needs frames, dropping caches might leave a block behind instead */
+	if (!b && page_frame_get_free_total() < SHRINK_WATERMARK && shrink_run(SHRINK_BATCH, false))
+		b = bin_find(sz);
+
+	if (b) bin_remove(b);
+	else if (!(b = arena_extend(sz)) && shrink_run(SHRINK_BATCH, true)) {
+
+		b = bin_find(sz);
+		if (b) bin_remove(b);
+		else b = arena_extend(sz);
+	}
+	return b;
+}
 
-	if (l->avail) l->size = pl;
-	else if (nsz >= sizeof(heap_block_t)) {
+/* mark block as used, splitting off the remainder */
+static void *block_take(heap_block_t *b, size_t sz) {
 
-		heap_block_t *n = (heap_block_t *)((void *)(l + 1) + l->size);
-		n->size = nsz - sizeof(heap_block_t);
-		n->avail = true;
-		n->page = (uint32_t)n >> 12;
-		n->next = l->next;
-		n->prev = l;
-		l->next = n;
+	size_t bsz = TAG_SIZE(b->tag);
+	if (bsz - sz >= MINBLOCK) {
 
-		if (n->next) n->next->prev = n;
+		heap_block_t *rem = (void *)b + sz;
+		set_tags(rem, bsz - sz, 0);
+		bin_insert(rem);
+		bsz = sz;
 	}
+	set_tags(b, bsz, TAG_USED);
+
+	uint32_t i = bin_index(bsz);
+	stats.bins[i].nused++;
+	stats.bins[i].used += bsz;
+
+	return (void *)b + sizeof(heap_tag_t);
+}
+
+/* get block size for allocation size */
+static inline size_t block_size(size_t sz) {
 
-	return bp;
+	return MAX(ALIGN(sz, 4) + sizeof(heap_tag_t) * 2, MINBLOCK);
 }
 
-/* split block */
-extern void heap_split(heap_block_t *b, size_t sz) {
+/* allocate address space for large allocation */
+static page_id_t vspace_alloc(uint32_t count, uint32_t align) {
 
-	if (b->size < sz + sizeof(heap_block_t)) return;
+	heap_extent_t *prev = NULL;
+	for (heap_extent_t *e = extents; e; prev = e, e = e->next) {
 
-	/* set the next block */
-	heap_block_t *n = (heap_block_t *)((void *)(b + 1) + sz);
-	n->size = b->size - sz - sizeof(heap_block_t);
-	n->avail = true;
-	n->page = (uint32_t)n >> 12;
-	n->next = b->next;
-	n->prev = b;
+		page_id_t start = ALIGN(e->start, align);
+		page_id_t end = start + count;
+		page_id_t eend = e->start + e->count;
+		if (end > eend) continue;
 
-	b->size = sz;
-	b->next = n;
+		/* keep head and tail of extent */
+		if (start > e->start) {
 
-	if (n->next) n->next->prev = n;
+			if (end < eend) {
+
+				heap_extent_t *n = (heap_extent_t *)kmalloc(sizeof(heap_extent_t));
+				if (!n) return 0;
+
+				n->start = end;
+				n->count = eend - end;
+				n->next = e->next;
+				e->next = n;
+			}
+			e->count = start - e->start;
+		}
+		else if (end < eend) {
+
+			e->start = end;
+			e->count = eend - end;
+		}
+		else {
+
+			if (prev) prev->next = e->next;
+			else extents = e->next;
+			kfree(e);
+		}
+		return start;
+	}
+	return 0;
 }
 
-/* merge with previous block */
-static heap_block_t *heap_merge_back(heap_block_t *b) {
+/* free address space of large allocation */
+static void vspace_free(page_id_t start, uint32_t count) {
 
-	while (b->prev && b->prev->avail) {
+	heap_extent_t *prev = NULL;
+	heap_extent_t *next = extents;
+	while (next && next->start < start) {
 
-		b->prev->size += sizeof(heap_block_t) + b->size;
-		b->prev->next = b->next;
-		if (b->next) b->next->prev = b->prev;
-		b = b->prev;
+		prev = next;
+		next = next->next;
 	}
-	return b;
+
+	/* merge with neighbours */
+	if (prev && prev->start + prev->count == start) {
+
+		prev->count += count;
+		if (next && start + count == next->start) {
+
+			prev->count += next->count;
+			prev->next = next->next;
+			kfree(next);
+		}
+		return;
+	}
+	if (next && start + count == next->start) {
+
+		next->start = start;
+		next->count += count;
+		return;
+	}
+
+	heap_extent_t *e = (heap_extent_t *)kmalloc(sizeof(heap_extent_t));
+	if (!e) return; /* address space is lost */
+
+	e->start = start;
+	e->count = count;
+	e->next = next;
+	if (prev) prev->next = e;
+	else extents = e;
 }
 
-/* merge with next block */
-static void heap_merge_front(heap_block_t *b) {
+/* map whole pages for large allocation */
+static void *large_alloc(size_t sz, size_t a, page_frame_id_t frame) {
+
+	uint32_t count = MAX(ALIGN(sz, PAGE_SIZE) / PAGE_SIZE, 1);
+	uint32_t align = a > PAGE_SIZE? a / PAGE_SIZE: 1;
+
+	page_id_t start = vspace_alloc(count, align);
+	if (!start) return NULL;
 
-	while (b->next && b->next->avail && (b->next->size > 0 || !b->next->next)) {
+	for (uint32_t i = 0; i < count; i++) {
 
-		b->size += sizeof(heap_block_t) + b->next->size;
-		b->next = b->next->next;
-		if (b->next) b->next->prev = b;
+		page_frame_id_t fr = frame? frame + i: page_frame_alloc();
+		if (!fr) {
+
+			for (uint32_t j = 0; j < i; j++) {
+
+				page_frame_free(page_get_frame(start + j));
+				page_unmap(start + j);
+			}
+			vspace_free(start, count);
+			return NULL;
+		}
+		page_map_flags(start + i, fr, i == count-1? HEAP_PAGE_LAST: 0);
 	}
+
+	stats.nlarge++;
+	stats.nlargepages += count;
+	return PAGE_ADDR(start);
 }
 
-/* merge block */
-extern heap_block_t *heap_merge(heap_block_t *b) {
+/* unmap large allocation */
+static void large_free(void *p) {
 
-	b = heap_merge_back(b);
-	heap_merge_front(b);
-	return b;
+	page_id_t start = (uint32_t)p >> 12;
+	page_id_t pg = start;
+
+	page_begin();
+	while (true) {
+
+		page_tab_entry_t ent = page_table[pg];
+		page_frame_free(ent >> 12);
+		page_unmap(pg++);
+
+		if (ent & HEAP_PAGE_LAST) break;
+	}
+	page_commit();
+
+	stats.nlarge--;
+	stats.nlargepages -= pg - start;
+	vspace_free(start, pg - start);
 }
 
-/* debug */
+/* initialize heap */
+extern void heap_init(void) {
+
+	page_frame_id_t fr = page_frame_alloc();
+	page_id_t pg = page_breakp;
+	page_map(page_breakp, fr);
+
+	/* prologue block and epilogue tag */
+	arena_start = PAGE_ADDR(pg);
+	set_tags((heap_block_t *)arena_start, sizeof(heap_tag_t) * 2, TAG_USED);
+
+	arena_end = arena_start + sizeof(heap_tag_t) * 2;
+	arena_end->tag = TAG_USED;
+	arena_mapped = pg + 1;
+
+	stats.arena = PAGE_SIZE;
+
+	/* address space for large allocations */
+	extents = (heap_extent_t *)kmalloc(sizeof(heap_extent_t));
+	extents->start = HEAP_LARGE_START;
+	extents->count = HEAP_LARGE_END - HEAP_LARGE_START;
+	extents->next = NULL;
+}
+
+/* get heap statistics */
+extern void heap_get_stats(heap_stats_t *out) {
+
+	*out = stats;
+}
+
+/* print per-bin statistics */
 extern void heap_print(void) {
 
-	heap_block_t *b = head;
-	while (b != NULL) {
+	for (uint32_t i = 0; i < HEAP_NBINS; i++) {
 
-		tty_printf("addr: 0x%x, available: %d, size: %d\n", b, b->avail, b->size);
-		b = b->next;
+		heap_bin_stats_t *bin = &stats.bins[i];
+		tty_printf("bin %d (%d+ bytes): free: %d (%d bytes), used: %d (%d bytes)\n", i, 1 << (i + HEAP_MINSHIFT), bin->nfree, bin->free, bin->nused, bin->used);
 	}
+	tty_printf("arena: %d bytes, large: %d (%d pages)\n", stats.arena, stats.nlarge, stats.nlargepages);
 }
 
-/* allocate */
-extern void *kmalloc(size_t sz) {
+#ifdef HEAP_TRACE
 
-	sz = ALIGN(sz, 4);
+static heap_trace_t traces[HEAP_TRACE_SLOTS]; /* live allocations (open addressing by pointer) */
+static uint32_t ntraces = 0;
+static uint32_t nlost = 0; /* allocations that did not fit */
 
-	heap_block_t *b = heap_find(head, sz);
-	if (!b) return NULL;
+/* get home slot of pointer */
+static inline uint32_t trace_hash(void *p) {
 
-	/* map pages */
-	uint32_t boff = (uint32_t)b - b->page * 4096;
-	uint32_t pagel = (boff + sz + (sizeof(heap_block_t) * 2)) / 4096 + 1;
-	
-	for (uint32_t i = b->page; i < b->page + pagel; i++) {
-		if (!page_is_mapped(i))
-			page_map(i, page_frame_alloc());
+	return ((uint32_t)p * 0x9e3779b1u) >> (32 - __builtin_ctz(HEAP_TRACE_SLOTS));
+}
+
+/* record allocation */
+static void trace_add(void *p, size_t sz, void *caller) {
+
+	if (!p) return;
+
+	/* keep a few slots empty so that probes stay short */
+	if (ntraces >= HEAP_TRACE_SLOTS - HEAP_TRACE_SLOTS / 8) {
+
+		nlost++;
+		return;
+	}
+
+	uint32_t i = trace_hash(p);
+	while (traces[i].ptr) i = (i + 1) & (HEAP_TRACE_SLOTS - 1);
+
+	traces[i].ptr = p;
+	traces[i].caller = caller;
+	traces[i].size = sz;
+	traces[i].time = task_get_global_time();
+	ntraces++;
+}
+
+/* forget allocation */
+static void trace_remove(void *p) {
+
+	uint32_t i = trace_hash(p);
+	for (; traces[i].ptr != p; i = (i + 1) & (HEAP_TRACE_SLOTS - 1)) {
+		if (!traces[i].ptr) return;
 	}
 
-	/* set values */
-	b->avail = false;
+	/* move later entries of the probe sequence back into the hole */
+	uint32_t j = i;
+	while (true) {
+
+		traces[i].ptr = NULL;
+		do {
 
-	/* split block if possible */
-	heap_split(b, sz);
-	b->size = sz;
+			j = (j + 1) & (HEAP_TRACE_SLOTS - 1);
+			if (!traces[j].ptr) {
 
-	/* return data pointer */
-	last = b;
-	return (void *)(b + 1);
+				ntraces--;
+				return;
+			}
+		} while (((j - trace_hash(traces[j].ptr)) & (HEAP_TRACE_SLOTS - 1)) < ((j - i) & (HEAP_TRACE_SLOTS - 1)));
+
+		traces[i] = traces[j];
+		i = j;
+	}
 }
 
-/* allocate sz bytes aligned to a bytes */
-extern void *kmalloca(size_t sz, size_t a) {
+#define TRACE_ADD(p, sz) trace_add((p), (sz), __builtin_return_address(0))
+#define TRACE_REMOVE(p) trace_remove(p)
+
+#else
+
+#define TRACE_ADD(p, sz)
+#define TRACE_REMOVE(p)
+
+#endif
 
-	sz = ALIGN(sz, 4);
+/* allocate without tracing */
+static void *alloc(size_t sz) {
 
-	heap_block_t *b = heap_find_aligned(head, sz, a);
+	if (sz >= HEAP_LARGE) return large_alloc(sz, PAGE_SIZE, 0);
+
+	size_t bsz = block_size(sz);
+
+	heap_block_t *b = block_get(bsz);
 	if (!b) return NULL;
 
-	/* map pages */
-	uint32_t boff = (uint32_t)b - b->page * 4096;
-	uint32_t pagel = (boff + sz + (sizeof(heap_block_t) * 2)) / 4096 + 1;
-	
-	for (uint32_t i = b->page; i < b->page + pagel; i++) {
-		if (!page_is_mapped(i))
-			page_map(i, page_frame_alloc());
+	return block_take(b, bsz);
+}
+
+/* allocate aligned without tracing */
+static void *alloc_aligned(size_t sz, size_t a) {
+
+	if (a <= 4) return alloc(sz);
+	if (sz >= HEAP_LARGE || a >= PAGE_SIZE) return large_alloc(sz, a, 0);
+
+	size_t bsz = block_size(sz);
+
+	heap_block_t *b = block_get(bsz + a + MINBLOCK);
+	if (!b) return NULL;
+
+	/* split off unaligned front */
+	void *p = (void *)b + sizeof(heap_tag_t);
+	if ((uint32_t)p & (a-1)) {
+
+		heap_block_t *nb = (heap_block_t *)(ALIGN((uint32_t)p + MINBLOCK, a) - sizeof(heap_tag_t));
+		size_t front = (size_t)((void *)nb - (void *)b);
+		size_t size = TAG_SIZE(b->tag);
+
+		set_tags(b, front, 0);
+		bin_insert(b);
+
+		set_tags(nb, size - front, 0);
+		b = nb;
 	}
+	return block_take(b, bsz);
+}
 
-	/* set values */
-	b->avail = false;
+/* allocate */
+extern void *kmalloc(size_t sz) {
 
-	/* split block if possible */
-	heap_split(b, sz);
-	b->size = sz;
+	void *p = alloc(sz);
+	TRACE_ADD(p, sz);
+	return p;
+}
 
-	/* return data pointer */
-	last = b;
-	return (void *)(b + 1);
+/* allocate sz bytes aligned to a bytes */
+extern void *kmalloca(size_t sz, size_t a) {
+
+	void *p = alloc_aligned(sz, a);
+	TRACE_ADD(p, sz);
+	return p;
+}
+
+/* allocate page aligned, physically contiguous memory */
+extern void *kmalloc_contig(size_t sz, page_frame_id_t *frame) {
+
+	uint32_t npages = ALIGN(sz, PAGE_SIZE) / PAGE_SIZE;
+	uint32_t order = 0;
+	while ((1u << order) < npages) order++;
+
+	page_frame_id_t fr = page_frame_alloc_contig(order);
+	if (!fr) return NULL;
+
+	/* return unused tail frames */
+	for (page_frame_id_t i = fr + npages; i < fr + (1 << order); i++)
+		page_frame_free(i);
+
+	void *p = large_alloc(npages * PAGE_SIZE, PAGE_SIZE, fr);
+	if (!p) {
+
+		for (page_frame_id_t i = fr; i < fr + npages; i++)
+			page_frame_free(i);
+		return NULL;
+	}
+
+	if (frame) *frame = fr;
+	TRACE_ADD(p, sz);
+	return p;
 }
 
 /* free */
 extern void kfree(void *p) {
 
 	if (p == NULL) return;
-	heap_block_t *b = (heap_block_t *)p - 1;
+	TRACE_REMOVE(p);
+
+	page_id_t pg = (uint32_t)p >> 12;
+	if (pg >= HEAP_LARGE_START && pg < HEAP_LARGE_END) {
+
+		large_free(p);
+		return;
+	}
+
+	heap_block_t *b = (heap_block_t *)(p - sizeof(heap_tag_t));
+	size_t sz = TAG_SIZE(b->tag);
+
+	uint32_t i = bin_index(sz);
+	stats.bins[i].nused--;
+	stats.bins[i].used -= sz;
+
+	/* merge with next block */
+	heap_block_t *next = NEXTBLK(b);
+	if (!(next->tag & TAG_USED)) {
+
+		bin_remove(next);
+		sz += TAG_SIZE(next->tag);
+	}
 
-	/* set values */
-	b->avail = true;
+	/* merge with previous block */
+	if (!(PREVFTR(b) & TAG_USED)) {
 
-	/* merge blocks */
-	b = heap_merge(b);
+		heap_block_t *prev = (void *)b - TAG_SIZE(PREVFTR(b));
+		bin_remove(prev);
+		sz += TAG_SIZE(prev->tag);
+		b = prev;
+	}
+	set_tags(b, sz, 0);
+
+	/* unmap free space at the top of the arena */
+	if ((void *)b + sz == (void *)arena_end && sz >= TRIMSIZE) {
+
+		arena_end = b;
+		arena_end->tag = TAG_USED;
 
-	/* unmap pages */
-	page_id_t pg = b->page + 1;
-	while (((pg + 1) * 4096) < (uint32_t)b->next) {
+		page_id_t first = ALIGN((uint32_t)b + sizeof(heap_tag_t), PAGE_SIZE) >> 12;
 
-		page_frame_free(page_get_frame(pg));
-		page_unmap(pg);
-		pg++;
+		page_begin();
+		for (page_id_t j = first; j < arena_mapped; j++) {
+
+			page_frame_free(page_get_frame(j));
+			page_unmap(j);
+		}
+		page_commit();
+		arena_mapped = first;
+		stats.arena = (size_t)(PAGE_ADDR(arena_mapped) - arena_start);
+		return;
 	}
+	bin_insert(b);
+}
+
+/* report being written */
+typedef struct heap_report_buf {
+	char *buf; /* output */
+	size_t size; /* output size */
+	size_t len; /* bytes written (without terminator) */
+} heap_report_buf_t;
+
+/* append string to report */
+static void report_puts(heap_report_buf_t *r, const char *s) {
+
+	while (*s && r->len + 1 < r->size) r->buf[r->len++] = *s++;
+	r->buf[r->len] = '\0';
+}
+
+/* append number to report, padded to width */
+static void report_putn(heap_report_buf_t *r, uint32_t n, uint32_t base, uint32_t width) {
+
+	char tmp[12];
+	uint32_t i = sizeof(tmp) - 1;
+	tmp[i] = '\0';
+	do {
+
+		tmp[--i] = "0123456789abcdef"[n % base];
+		n /= base;
+	} while (n && i > 0);
+
+	while (sizeof(tmp) - 1 - i < width && i > 0) tmp[--i] = ' ';
+	report_puts(r, &tmp[i]);
+}
+
+/* get size of largest free block */
+static size_t largest_free(void) {
+
+	if (!binmap) return 0;
+
+	/* blocks in a bin are unsorted, so check every block of the highest one */
+	size_t max = 0;
+	for (heap_block_t *b = bins[31 - __builtin_clz(binmap)]; b; b = b->next)
+		max = MAX(max, TAG_SIZE(b->tag));
+	return max;
+}
+
+#ifdef HEAP_TRACE
+
+/* allocations of one caller */
+typedef struct heap_trace_caller {
+	void *caller; /* return address */
+	uint32_t count; /* live allocations */
+	size_t size; /* live bytes */
+} heap_trace_caller_t;
+
+static heap_trace_caller_t callers[HEAP_TRACE_CALLERS];
+
+/* append live allocations to report */
+static void report_traces(heap_report_buf_t *r) {
+
+	/* sum up allocations per caller, unknown callers past the table end are dropped */
+	uint32_t ncallers = 0;
+	for (uint32_t i = 0; i < HEAP_TRACE_SLOTS; i++) {
+
+		heap_trace_t *t = &traces[i];
+		if (!t->ptr) continue;
+
+		uint32_t j = 0;
+		while (j < ncallers && callers[j].caller != t->caller) j++;
+		if (j == ncallers) {
+
+			if (ncallers == HEAP_TRACE_CALLERS) continue;
+			callers[ncallers].caller = t->caller;
+			callers[ncallers].count = 0;
+			callers[ncallers].size = 0;
+			ncallers++;
+		}
+		callers[j].count++;
+		callers[j].size += t->size;
+	}
+
+	/* largest first */
+	for (uint32_t i = 1; i < ncallers; i++) {
+
+		heap_trace_caller_t c = callers[i];
+		uint32_t j = i;
+		for (; j > 0 && callers[j-1].size < c.size; j--) callers[j] = callers[j-1];
+		callers[j] = c;
+	}
+
+	report_puts(r, "\nlive allocations: ");
+	report_putn(r, ntraces, 10, 0);
+	report_puts(r, " (");
+	report_putn(r, nlost, 10, 0);
+	report_puts(r, " untracked)\n\n  caller      count      bytes\n");
+	for (uint32_t i = 0; i < ncallers; i++) {
+
+		report_puts(r, "  0x");
+		report_putn(r, (uint32_t)callers[i].caller, 16, 8);
+		report_putn(r, callers[i].count, 10, 7);
+		report_putn(r, callers[i].size, 10, 11);
+		report_puts(r, "\n");
+	}
+
+	/* individual allocations until the buffer is full */
+	uint64_t now = task_get_global_time();
+	report_puts(r, "\n  pointer       size  caller      age (ms)\n");
+	for (uint32_t i = 0; i < HEAP_TRACE_SLOTS && r->len + 1 < r->size; i++) {
+
+		heap_trace_t *t = &traces[i];
+		if (!t->ptr) continue;
+
+		report_puts(r, "  0x");
+		report_putn(r, (uint32_t)t->ptr, 16, 8);
+		report_putn(r, t->size, 10, 9);
+		report_puts(r, "  0x");
+		report_putn(r, (uint32_t)t->caller, 16, 8);
+		report_putn(r, (uint32_t)((now - t->time) / 1000000), 10, 12);
+		report_puts(r, "\n");
+	}
+}
+
+#endif
+
+/* format heap report, returns length */
+extern size_t heap_report(char *buf, size_t size) {
+
+	if (!size) return 0;
+
+	heap_report_buf_t r = {
+		.buf = buf,
+		.size = size,
+		.len = 0,
+	};
+	buf[0] = '\0';
+
+	/* free block histogram */
+	size_t used = 0, free = 0;
+	report_puts(&r, "bin      size     nfree       free     nused       used\n");
+	for (uint32_t i = 0; i < HEAP_NBINS; i++) {
+
+		heap_bin_stats_t *bin = &stats.bins[i];
+		used += bin->used;
+		free += bin->free;
+
+		report_putn(&r, i, 10, 3);
+		report_putn(&r, 1 << (i + HEAP_MINSHIFT), 10, 9);
+		report_puts(&r, i == HEAP_NBINS-1? "+": " ");
+		report_putn(&r, bin->nfree, 10, 9);
+		report_putn(&r, bin->free, 10, 11);
+		report_putn(&r, bin->nused, 10, 10);
+		report_putn(&r, bin->used, 10, 11);
+		report_puts(&r, "\n");
+	}
+
+	/* mapped memory against what is handed out */
+	size_t large = stats.nlargepages * PAGE_SIZE;
+	report_puts(&r, "\narena: ");
+	report_putn(&r, stats.arena, 10, 0);
+	report_puts(&r, " bytes mapped, ");
+	report_putn(&r, used, 10, 0);
+	report_puts(&r, " used, ");
+	report_putn(&r, free, 10, 0);
+	report_puts(&r, " free\nlarge: ");
+	report_putn(&r, stats.nlarge, 10, 0);
+	report_puts(&r, " allocations, ");
+	report_putn(&r, large, 10, 0);
+	report_puts(&r, " bytes mapped\nlargest free block: ");
+	report_putn(&r, largest_free(), 10, 0);
+	report_puts(&r, " bytes\nutilization: ");
+	report_putn(&r, (uint32_t)((uint64_t)(used + large) * 100 / (stats.arena + large)), 10, 0);
+	report_puts(&r, "% of ");
+	report_putn(&r, (stats.arena + large) / PAGE_SIZE, 10, 0);
+	report_puts(&r, " pages\n");
+
+#ifdef HEAP_TRACE
+	report_traces(&r);
+#endif
+
+	return r.len;
+}
+
+static char *report = NULL; /* last report read from devfs */
+static size_t reportlen = 0;
+
+/* read report */
+static kssize_t read_fs(fs_node_t *node, uint32_t offset, size_t nbytes, uint8_t *buf) {
+
+	if (!report) report = (char *)kmalloc(HEAP_REPORT_SIZE);
+	if (!report) return -ENOMEM;
+
+	/* take a new snapshot whenever reading starts over */
+	if (!offset) reportlen = heap_report(report, HEAP_REPORT_SIZE);
+	if (offset >= reportlen) return 0;
+
+	nbytes = MIN(nbytes, reportlen - offset);
+	memcpy(buf, report + offset, nbytes);
+	return (kssize_t)nbytes;
+}
+
+/* dump report to serial ports */
+static kssize_t write_fs(fs_node_t *node, uint32_t offset, size_t nbytes, uint8_t *buf) {
+
+	if (!report) report = (char *)kmalloc(HEAP_REPORT_SIZE);
+	if (!report) return -ENOMEM;
+
+	reportlen = heap_report(report, HEAP_REPORT_SIZE);
+
+	uart_com_t init = uart_is_init();
+	for (uart_com_t i = 0; i < UART_COM_COUNT; i++) {
+		if (init & (1 << i)) uart_write(i, report, reportlen);
+	}
+	return (kssize_t)nbytes;
+}
+
+/* initialize vfs nodes */
+extern void heap_init_devfs(void) {
+
+	fs_node_t *node = fs_node_new(NULL, FS_CHARDEVICE);
+	node->mask = 0600;
+	node->read = read_fs;
+	node->write = write_fs;
+
+	devfs_add_unique("kheap", node);
 }
@@ -6,7 +6,11 @@
 #include <kernel/types.h>
 #include <kernel/string.h>
 #include <kernel/tty.h>
+#include <kernel/smp.h>
+#include <kernel/io/cpu.h>
 #include <kernel/mm/paging.h>
+#include <kernel/mm/swap.h>
+#include <kernel/mm/shrink.h>
 
 /* the 0x8000-0x80000 address range (page numbers) */
 #define LOWMEM_START 8
@@ -15,24 +19,167 @@
 /* 4G / 4K (page size) / 8 (bits in a byte) */
 #define BITMAP_SIZE 131072
 
+/* buddy allocator */
+#define FRAME_NONE 0xffffffff
+#define FRAME_FLAG_MANAGED 0x1 /* frame lies in a usable memory region */
+#define FRAME_FLAG_FREE 0x2 /* frame is the head of a free block */
+#define FRAME_FLAG_SWAP 0x4 /* a swap slot holds a copy of the used frame (kept in next) */
+
+#define MAXREGIONS 32
+
+#define KERNEL_START 0xC0000 /* first kernel page */
+
+#define BATCH_MAX 32 /* pages invalidated one at a time before the whole tlb is flushed instead */
+
+#define ZERO_REFILL 16 /* frames zeroed per refill call */
+
 extern void _kernel_end(void);
 
 static uint8_t bitmap[BITMAP_SIZE];
-static uint32_t nused; /* number of used frames */
+static uint32_t nused; /* number of used frames (frames in the zeroed pool count as free) */
+
+typedef struct frame_info {
+	page_frame_id_t prev; /* previous free block */
+	page_frame_id_t next; /* next free block */
+	uint8_t order; /* order of free block */
+	uint8_t flags; /* frame flags */
+	uint16_t refcnt; /* number of extra references to a used frame */
+} frame_info_t;
+
+static frame_info_t *frames = NULL; /* per-frame info */
+static page_frame_id_t nframes = 0; /* number of frames covered by the buddy allocator */
+static page_frame_id_t freelists[PAGE_FRAME_NORDERS]; /* free block lists */
+static uint32_t nfree[PAGE_FRAME_NORDERS]; /* number of free blocks of each order */
+static bool buddy_ready = false;
+
+/* pre-zeroed frames */
+static page_frame_id_t zero_pool[PAGE_ZERO_MAX];
+static uint32_t zero_count = 0;
+static uint32_t zero_watermark = PAGE_ZERO_WATERMARK;
+
+static struct {
+	page_frame_id_t start; /* first frame */
+	page_frame_id_t end; /* frame after last */
+} regions[MAXREGIONS]; /* usable memory regions */
+static uint32_t nregions = 0;
 
 /* page mapper */
 static page_dir_entry_t *page_dir = NULL;
 static page_id_t page_start = 0;
 static page_id_t page_table_id = 0;
+static page_id_t page_temp = 0; /* window for temporary mappings */
+static uint32_t page_global = 0; /* global flag for kernel pages (if supported) */
+static bool page_pse = false; /* 4M pages are enabled */
+
+/* deferred tlb invalidation */
+static uint32_t batch_depth = 0; /* nested transactions */
+static page_id_t batch_pages[BATCH_MAX]; /* pages to invalidate */
+static uint32_t batch_count = 0;
+static bool batch_full = false; /* too many pages; flush everything */
+static bool batch_global = false; /* a kernel page is pending */
 
 page_id_t page_breakp = 0;
-page_dir_entry_t *page_dir_wrap = NULL;
 page_tab_entry_t *page_table = NULL;
 uint32_t page_frame_max_count = 0;
 
 /* get an address to a page table from the page directory */
 #define PAGE_TAB(p) ((page_tab_entry_t *)(page_dir_wrap[(p)] & 0xfffff000))
 
+#define PAGE_IS_LARGE(p) (page_dir_wrap[(p)/1024] & PAGE_FLAG_PS)
+
+#define FRAME_IS_USED(id) (bitmap[(id) / 8] & (1 << ((id) % 8)))
+
+/* add block to free list */
+static void freelist_add(page_frame_id_t id, uint32_t order) {
+
+	frames[id].order = (uint8_t)order;
+	frames[id].flags |= FRAME_FLAG_FREE;
+	frames[id].prev = FRAME_NONE;
+	frames[id].next = freelists[order];
+
+	if (freelists[order] != FRAME_NONE)
+		frames[freelists[order]].prev = id;
+	freelists[order] = id;
+	nfree[order]++;
+}
+
+/* remove block from free list */
+static void freelist_remove(page_frame_id_t id) {
+
+	uint32_t order = frames[id].order;
+
+	if (frames[id].prev != FRAME_NONE) frames[frames[id].prev].next = frames[id].next;
+	else freelists[order] = frames[id].next;
+	if (frames[id].next != FRAME_NONE) frames[frames[id].next].prev = frames[id].prev;
+
+	frames[id].flags &= ~FRAME_FLAG_FREE;
+	frames[id].prev = FRAME_NONE;
+	frames[id].next = FRAME_NONE;
+	nfree[order]--;
+}
+
+/* return block to free lists and merge with buddies */
+static void buddy_free(page_frame_id_t id, uint32_t order) {
+
+	while (order < PAGE_FRAME_MAX_ORDER) {
+
+		page_frame_id_t buddy = id ^ (1 << order);
+		if (buddy >= nframes || !(frames[buddy].flags & FRAME_FLAG_FREE) || frames[buddy].order != order)
+			break;
+
+		freelist_remove(buddy);
+		id &= ~(1 << order);
+		order++;
+	}
+	freelist_add(id, order);
+}
+
+/* take block from free lists, splitting larger blocks if necessary */
+static page_frame_id_t buddy_alloc(uint32_t order) {
+
+	uint32_t o = order;
+	while (o <= PAGE_FRAME_MAX_ORDER && freelists[o] == FRAME_NONE) o++;
+	if (o > PAGE_FRAME_MAX_ORDER) return FRAME_NONE;
+
+	page_frame_id_t id = freelists[o];
+	freelist_remove(id);
+
+	/* return upper halves */
+	while (o > order) {
+
+		o--;
+		freelist_add(id + (1 << o), o);
+	}
+	return id;
+}
+
+/* take single frame out of the free block containing it */
+static void buddy_take(page_frame_id_t id) {
+
+	for (uint32_t o = 0; o <= PAGE_FRAME_MAX_ORDER; o++) {
+
+		page_frame_id_t head = id & ~((1 << o) - 1);
+		if (!(frames[head].flags & FRAME_FLAG_FREE) || frames[head].order != o)
+			continue;
+
+		freelist_remove(head);
+
+		/* return the halves that don't contain the frame */
+		while (o > 0) {
+
+			o--;
+			page_frame_id_t half = 1 << o;
+			if (id >= head + half) {
+
+				freelist_add(head, o);
+				head += half;
+			}
+			else freelist_add(head + half, o);
+		}
+		return;
+	}
+}
+
 /* initialize frame allocator */
 extern void page_frame_init(void) {
 
@@ -49,9 +196,106 @@ extern void page_frame_init(void) {
 	}
 }
 
+/* add usable memory region */
+extern void page_frame_add_region(page_frame_id_t start, page_frame_id_t end) {
+
+	if (buddy_ready || nregions >= MAXREGIONS || start >= end) return;
+
+	regions[nregions].start = start;
+	regions[nregions].end = end;
+	nregions++;
+
+	page_frame_max_count += end - start;
+}
+
+/* set up buddy allocator from usable memory regions */
+extern void page_frame_init_buddy(void) {
+
+	/* no memory map; keep using the bitmap */
+	if (!nregions) return;
+
+	for (uint32_t i = 0; i < nregions; i++)
+		nframes = MAX(nframes, regions[i].end);
+
+	/* map frame info array */
+	uint32_t npages = ALIGN(nframes * sizeof(frame_info_t), PAGE_SIZE) / PAGE_SIZE;
+
+	page_id_t page = page_breakp;
+	for (uint32_t i = 0; i < npages; i++)
+		page_map(page_breakp++, page_frame_alloc());
+
+	frames = PAGE_ADDR(page);
+	for (page_frame_id_t i = 0; i < nframes; i++) {
+
+		frames[i].prev = FRAME_NONE;
+		frames[i].next = FRAME_NONE;
+		frames[i].order = 0;
+		frames[i].flags = 0;
+		frames[i].refcnt = 0;
+	}
+	for (uint32_t i = 0; i < PAGE_FRAME_NORDERS; i++) {
+
+		freelists[i] = FRAME_NONE;
+		nfree[i] = 0;
+	}
+
+	/* add free frames */
+	for (uint32_t i = 0; i < nregions; i++) {
+		for (page_frame_id_t f = regions[i].start; f < regions[i].end; f++) {
+
+			if (frames[f].flags & FRAME_FLAG_MANAGED) continue; /* overlapping regions */
+			frames[f].flags |= FRAME_FLAG_MANAGED;
+
+			if (!FRAME_IS_USED(f)) buddy_free(f, 0);
+		}
+	}
+	buddy_ready = true;
+}
+
+/* take frame from zeroed pool */
+static page_frame_id_t zero_pool_take(void) {
+
+	uint32_t flags = cpu_irq_save();
+	page_frame_id_t id = 0;
+	if (zero_count) {
+
+		id = zero_pool[--zero_count];
+		nused++;
+	}
+	cpu_irq_restore(flags);
+	return id;
+}
+
+/* allocate a frame from the buddy allocator */
+static page_frame_id_t frame_alloc_buddy(void) {
+
+	page_frame_id_t id = buddy_alloc(0);
+	if (id == FRAME_NONE) return 0;
+
+	bitmap[id / 8] |= (uint8_t)(1 << (id % 8));
+	nused++;
+	return id;
+}
+
 /* allocate a frame */
 extern page_frame_id_t page_frame_alloc(void) {
 
+	if (buddy_ready) {
+
+		/* caches are dropped before anything is swapped */
+		if (page_frame_get_free_total() < SHRINK_WATERMARK) shrink_run(SHRINK_BATCH, false);
+
+		/* swapping starts a little early, the compressed pool needs frames of its own */
+		if (page_frame_get_free_total() < PAGE_FRAME_RESERVE) swap_reclaim(false);
+
+		/* zeroed frames are free memory too */
+		page_frame_id_t id = frame_alloc_buddy();
+		if (!id) id = zero_pool_take();
+		if (!id && shrink_run(SHRINK_BATCH, true)) id = frame_alloc_buddy();
+		if (!id && swap_reclaim(true)) id = frame_alloc_buddy();
+		return id;
+	}
+
 	for (uint32_t i = 0; i < BITMAP_SIZE; i++) {
 
 		for (int j = 0; j < 8; j++) {
@@ -67,14 +311,101 @@ extern page_frame_id_t page_frame_alloc(void) {
 	return 0;
 }
 
+/* allocate a zeroed frame */
+extern page_frame_id_t page_frame_alloc_zeroed(void) {
+
+	page_frame_id_t id = zero_pool_take();
+	if (id) return id;
+
+	id = page_frame_alloc();
+	if (!id) return 0;
+
+	uint32_t flags = cpu_irq_save();
+	memset(page_map_temp(id), 0, PAGE_SIZE);
+	page_unmap_temp();
+	cpu_irq_restore(flags);
+	return id;
+}
+
+/* zero free frames until the pool reaches the watermark, returns true if it is full */
+extern bool page_frame_refill_zeroed(void) {
+
+	if (!buddy_ready) return true;
+
+	for (uint32_t i = 0; i < ZERO_REFILL; i++) {
+
+		if (zero_count >= zero_watermark) return true;
+
+		/* interrupt handlers use the allocator and the window as well */
+		uint32_t flags = cpu_irq_save();
+		page_frame_id_t id = frame_alloc_buddy();
+		if (!id) {
+
+			cpu_irq_restore(flags);
+			return true;
+		}
+
+		memset(page_map_temp(id), 0, PAGE_SIZE);
+		page_unmap_temp();
+
+		zero_pool[zero_count++] = id;
+		nused--;
+		cpu_irq_restore(flags);
+	}
+	return zero_count >= zero_watermark;
+}
+
+/* set number of zeroed frames kept ready */
+extern void page_frame_set_zero_watermark(uint32_t count) {
+
+	zero_watermark = MIN(count, PAGE_ZERO_MAX);
+
+	/* give back what is over */
+	uint32_t flags = cpu_irq_save();
+	while (zero_count > zero_watermark) page_frame_free(zero_pool_take());
+	cpu_irq_restore(flags);
+}
+
+/* get number of zeroed frames ready */
+extern uint32_t page_frame_get_zeroed_count(void) {
+
+	return zero_count;
+}
+
+/* allocate 2^order physically contiguous frames */
+extern page_frame_id_t page_frame_alloc_contig(uint32_t order) {
+
+	if (!buddy_ready || order > PAGE_FRAME_MAX_ORDER) return 0;
+
+	page_frame_id_t id = buddy_alloc(order);
+	if (id == FRAME_NONE) return 0;
+
+	for (page_frame_id_t i = id; i < id + (1 << order); i++)
+		bitmap[i / 8] |= (uint8_t)(1 << (i % 8));
+	nused += 1 << order;
+	return id;
+}
+
+/* free 2^order physically contiguous frames */
+extern void page_frame_free_contig(page_frame_id_t id, uint32_t order) {
+
+	for (page_frame_id_t i = id; i < id + (1 << order); i++)
+		page_frame_free(i);
+}
+
 /* set frame to used */
 extern void page_frame_use(page_frame_id_t id) {
 
 	uint32_t byte = id / 8;
 	uint8_t bit = (uint8_t)(1 << (id % 8));
 
-	if (!(bitmap[byte] & bit)) nused++;
+	if (bitmap[byte] & bit) return;
+
 	bitmap[byte] |= bit;
+	nused++;
+
+	if (buddy_ready && id < nframes && (frames[id].flags & FRAME_FLAG_MANAGED))
+		buddy_take(id);
 }
 
 /* set frame to free */
@@ -83,8 +414,83 @@ extern void page_frame_free(page_frame_id_t id) {
 	uint32_t byte = id / 8;
 	uint8_t bit = (uint8_t)(1 << (id % 8));
 
-	if (bitmap[byte] & bit) nused--;
+	if (!(bitmap[byte] & bit)) return;
+
 	bitmap[byte] &= ~(bit);
+	nused--;
+
+	if (buddy_ready && id < nframes && (frames[id].flags & FRAME_FLAG_MANAGED)) {
+
+		uint32_t slot = (frames[id].flags & FRAME_FLAG_SWAP)? frames[id].next: 0;
+		frames[id].flags &= ~FRAME_FLAG_SWAP;
+		frames[id].refcnt = 0;
+		buddy_free(id, 0);
+
+		/* the compressed pool might free a frame of its own */
+		if (slot) swap_put(slot);
+	}
+}
+
+/* check if frames can be shared */
+extern bool page_frame_can_share(void) {
+
+	return buddy_ready;
+}
+
+/* add reference to used frame */
+extern bool page_frame_ref(page_frame_id_t id) {
+
+	if (!buddy_ready || id >= nframes || !FRAME_IS_USED(id) || frames[id].refcnt == 0xffff)
+		return false;
+
+	frames[id].refcnt++;
+	return true;
+}
+
+/* drop reference to frame, freeing it with the last one */
+extern void page_frame_unref(page_frame_id_t id) {
+
+	if (buddy_ready && id < nframes && frames[id].refcnt) {
+
+		frames[id].refcnt--;
+		return;
+	}
+	page_frame_free(id);
+}
+
+/* get number of references to frame */
+extern uint32_t page_frame_get_refcnt(page_frame_id_t id) {
+
+	if (!FRAME_IS_USED(id)) return 0;
+	if (!buddy_ready || id >= nframes) return 1;
+	return frames[id].refcnt + 1;
+}
+
+/* remember swap slot holding a copy of frame (0 drops it) */
+extern void page_frame_set_swap(page_frame_id_t id, uint32_t slot) {
+
+	if (!buddy_ready || id >= nframes || !FRAME_IS_USED(id)) {
+
+		if (slot) swap_put(slot);
+		return;
+	}
+
+	if (frames[id].flags & FRAME_FLAG_SWAP) swap_put(frames[id].next);
+	frames[id].flags &= ~FRAME_FLAG_SWAP;
+	frames[id].next = FRAME_NONE;
+
+	if (slot) {
+
+		frames[id].flags |= FRAME_FLAG_SWAP;
+		frames[id].next = slot;
+	}
+}
+
+/* get swap slot holding a copy of frame */
+extern uint32_t page_frame_get_swap(page_frame_id_t id) {
+
+	if (!buddy_ready || id >= nframes || !(frames[id].flags & FRAME_FLAG_SWAP)) return 0;
+	return frames[id].next;
 }
 
 /* get number of used frames */
@@ -93,6 +499,25 @@ extern uint32_t page_frame_get_used_count(void) {
 	return nused;
 }
 
+/* get number of free blocks of an order */
+extern uint32_t page_frame_get_free_count(uint32_t order) {
+
+	if (order > PAGE_FRAME_MAX_ORDER) return 0;
+	return nfree[order];
+}
+
+/* get total number of free frames */
+extern uint32_t page_frame_get_free_total(void) {
+
+	if (!buddy_ready)
+		return page_frame_max_count > nused? page_frame_max_count - nused: 0;
+
+	uint32_t total = zero_count;
+	for (uint32_t i = 0; i <= PAGE_FRAME_MAX_ORDER; i++)
+		total += nfree[i] << i;
+	return total;
+}
+
 /* initialize page mapper */
 extern void page_init(void) {
 
@@ -103,7 +528,7 @@ extern void page_init(void) {
 	__asm__("mov %%cr3, %0": "=r"(cr3));
 
 	page_dir = (page_dir_entry_t *)(cr3 + 0xC0000000);
-	page_dir_wrap = NULL;
+	smp_cpu()->dir = NULL;
 	page_start = (uint32_t)_kernel_end / 4096 + 1;
 
 	/* map the page dir entry to the page dir */
@@ -114,7 +539,14 @@ extern void page_init(void) {
 	page_start = page_table_id + 1024;
 
 	page_breakp = page_start;
-	page_dir_wrap = page_dir;
+	smp_cpu()->dir = page_dir;
+
+	/* 4M pages */
+	if (cpu_has_feature(CPU_FEATURE_PSE)) {
+
+		cpu_set_cr4(cpu_get_cr4() | CPU_CR4_PSE);
+		page_pse = true;
+	}
 }
 
 /* map all page tables in kernel area */
@@ -124,6 +556,28 @@ extern void page_init_top(void) {
 	page_id_t pt = ALIGN(page_breakp, 1024) / 1024;
 	for (page_id_t i = pt; i < 1024; i++)
 		page_map_table(i, page_frame_alloc());
+
+	page_temp = page_breakp++;
+
+	/* keep kernel translations across address space switches */
+	if (cpu_has_feature(CPU_FEATURE_PGE)) {
+
+		cpu_set_cr4(cpu_get_cr4() | CPU_CR4_PGE);
+		page_global = PAGE_FLAG_G;
+
+		/* the page table window differs between address spaces */
+		for (page_id_t p = KERNEL_START; p < page_breakp; p++) {
+
+			if (PAGE_IS_LARGE(p)) {
+
+				page_dir_wrap[p/1024] |= PAGE_FLAG_G;
+				p |= 1023;
+			}
+			else if ((p < page_table_id || p >= page_table_id + 1024) && page_is_mapped(p))
+				page_table[p] |= PAGE_FLAG_G;
+		}
+		page_flush();
+	}
 }
 
 /* find free page directory entry */
@@ -143,21 +597,66 @@ extern void page_map_table(page_id_t p, page_frame_id_t f) {
 	page_map_table_flags(p, f, 0);
 }
 
+/* invalidate tlb entry now */
+static inline void invlpg(page_id_t p) {
+
+	uint32_t addr = p << 12;
+	asm volatile("invlpg (%0)": : "r"(addr));
+}
+
+/* check if invalidation of page is still pending */
+static bool page_is_pending(page_id_t p) {
+
+	if (!batch_depth) return false;
+	if (batch_full) return true;
+
+	for (uint32_t i = 0; i < batch_count; i++) {
+		if (batch_pages[i] == p) return true;
+	}
+	return false;
+}
+
+/* invalidate range of pages */
+static void page_invalidate_range(page_id_t p, uint32_t count) {
+
+	if (count <= BATCH_MAX) {
+
+		for (uint32_t i = 0; i < count; i++)
+			page_invalidate(p + i);
+		return;
+	}
+
+	if (p + count > KERNEL_START) batch_global = true;
+	if (batch_depth) batch_full = true;
+	else {
+
+		if (batch_global) {
+
+			page_flush_global();
+			smp_flush_others();
+		}
+		else page_flush();
+		batch_global = false;
+	}
+}
+
 /* map page table with flags */
 extern void page_map_table_flags(page_id_t p, page_frame_id_t f, uint32_t flags) {
 
-	if (page_dir_wrap) page_dir_wrap[p] = PAGE_ENT(f) | PAGE_FLAG_P | PAGE_FLAG_RW | flags;
-	else page_dir[p] = PAGE_ENT(f) | PAGE_FLAG_P | PAGE_FLAG_RW | flags;
+	page_dir_entry_t *dir = page_dir_wrap? page_dir_wrap: page_dir;
+	bool replaced = dir[p] & PAGE_FLAG_P;
+
+	dir[p] = PAGE_ENT(f) | PAGE_FLAG_P | PAGE_FLAG_RW | flags;
 	
 	/* invalidate entry in tlb to allow for editing of the table */
-	page_invalidate(page_table_id + p);
+	invlpg(page_table_id + p);
 
-	for (page_id_t i = 0; i < 1024; i++) {
-		if (page_table) {
-			
-			page_table[p*1024+i] = 0;
-			page_invalidate(p*1024+i);
-		}
+	if (page_table) {
+
+		memset(&page_table[p*1024], 0, PAGE_SIZE);
+
+		/* translations through a previous table may be cached */
+		if (replaced) page_invalidate_range(p*1024, 1024);
 	}
 }
 
@@ -167,8 +666,8 @@ extern void page_map(page_id_t p, page_frame_id_t f) {
 	page_map_flags(p, f, 0);
 }
 
-/* map page with flags */
-extern void page_map_flags(page_id_t p, page_frame_id_t f, uint32_t flags) {
+/* set page table entry */
+static void page_map_entry(page_id_t p, page_frame_id_t f, uint32_t flags) {
 
 	page_id_t pt = p/1024;
 
@@ -179,23 +678,151 @@ extern void page_map_flags(page_id_t p, page_frame_id_t f, uint32_t flags) {
 		page_map_table_flags(pt, fr, flags);
 	}
 
-	/* map page */
-	page_table[p] = PAGE_ENT(f) | PAGE_FLAG_P | PAGE_FLAG_RW | flags;
-	page_invalidate(p);
+	/* map page (not present entries are never cached) */
+	if (p >= KERNEL_START) flags |= page_global;
+	page_tab_entry_t old = page_table[p];
+	page_table[p] = PAGE_ENT(f) | PAGE_FLAG_P | flags;
+	if ((old & PAGE_FLAG_P) || page_is_pending(p)) invlpg(p);
+
+	/* other cpus may still hold the replaced kernel entry */
+	if ((old & PAGE_FLAG_P) && p >= KERNEL_START) {
+
+		if (batch_depth) batch_global = true;
+		else smp_flush_others();
+	}
+}
+
+/* map page with flags */
+extern void page_map_flags(page_id_t p, page_frame_id_t f, uint32_t flags) {
+
+	page_map_entry(p, f, flags | PAGE_FLAG_RW);
+}
+
+/* map page read-only with flags */
+extern void page_map_readonly(page_id_t p, page_frame_id_t f, uint32_t flags) {
+
+	page_map_entry(p, f, flags & ~PAGE_FLAG_RW);
+}
+
+/* check if 4M pages are supported */
+extern bool page_has_large(void) {
+
+	return page_pse;
+}
+
+/* map 4M aligned region with a single directory entry */
+extern bool page_map_large(page_id_t p, page_frame_id_t f, uint32_t flags) {
+
+	page_id_t pt = p/1024;
+	if (!page_pse || p % 1024 || f % 1024 || page_dir_wrap[pt])
+		return false;
+
+	if (p >= KERNEL_START) flags |= page_global;
+	page_dir_wrap[pt] = PAGE_ENT(f) | PAGE_FLAG_P | PAGE_FLAG_RW | PAGE_FLAG_PS | flags;
+	invlpg(p);
+	return true;
+}
+
+/* map contiguous frames, using 4M pages where alignment allows */
+extern void page_map_range(page_id_t p, page_frame_id_t f, uint32_t count, uint32_t flags) {
+
+	for (uint32_t i = 0; i < count;) {
+
+		if (count - i >= 1024 && page_map_large(p + i, f + i, flags)) {
+
+			i += 1024;
+			continue;
+		}
+		page_map_flags(p + i, f + i, flags);
+		i++;
+	}
+}
+
+/* map contiguous frames at the kernel break point */
+extern page_id_t page_map_contig(page_frame_id_t f, uint32_t count) {
+
+	/* line up with the frames so 4M pages can be used */
+	if (page_pse && count >= 1024)
+		page_breakp = ALIGN(page_breakp, 1024) + f % 1024;
+
+	page_id_t page = page_breakp;
+	page_map_range(page, f, count, 0);
+	page_breakp += count;
+
+	return page;
+}
+
+/* map frame to temporary window */
+extern void *page_map_temp(page_frame_id_t f) {
+
+	page_table[page_temp] = PAGE_ENT(f) | PAGE_FLAG_P | PAGE_FLAG_RW | page_global;
+	invlpg(page_temp);
+	return PAGE_ADDR(page_temp);
+}
+
+/* unmap temporary window */
+extern void page_unmap_temp(void) {
+
+	page_table[page_temp] = 0;
+	invlpg(page_temp);
+}
+
+/* get frame in temporary window */
+extern page_frame_id_t page_get_temp(void) {
+
+	return page_table[page_temp] >> 12;
+}
+
+/* start mapping transaction (invalidations are deferred until commit) */
+extern void page_begin(void) {
+
+	batch_depth++;
+}
+
+/* end mapping transaction and flush deferred invalidations */
+extern void page_commit(void) {
+
+	if (!batch_depth || --batch_depth) return;
+
+	if (batch_full) {
+
+		if (batch_global) page_flush_global();
+		else page_flush();
+	}
+	else {
+
+		for (uint32_t i = 0; i < batch_count; i++)
+			invlpg(batch_pages[i]);
+	}
+	if (batch_global) smp_flush_others();
+
+	batch_count = 0;
+	batch_full = false;
+	batch_global = false;
 }
 
 /* invalidate an entry in the tlb */
 extern void page_invalidate(page_id_t p) {
 
-	uint32_t addr = p << 12;
-	asm volatile("invlpg (%0)": : "r"(addr));
+	if (!batch_depth) {
+
+		invlpg(p);
+		if (p >= KERNEL_START) smp_flush_others();
+		return;
+	}
+
+	if (p >= KERNEL_START) batch_global = true;
+	if (batch_full) return;
+
+	if (batch_count >= BATCH_MAX) batch_full = true;
+	else batch_pages[batch_count++] = p;
 }
 
 /* check if page is mapped */
 extern bool page_is_mapped(page_id_t p) {
 
-	if (page_dir_wrap[p/1024] && page_table[p])
-		return true;
+	if (!page_dir_wrap[p/1024]) return false;
+	if (PAGE_IS_LARGE(p) || page_table[p]) return true;
 	return false;
 }
 
@@ -203,24 +830,66 @@ extern bool page_is_mapped(page_id_t p) {
 extern page_frame_id_t page_get_frame(page_id_t p) {
 
 	if (!page_dir_wrap[p/1024]) return 0;
+	if (PAGE_IS_LARGE(p)) return (page_dir_wrap[p/1024] >> 12) + p % 1024;
+	if (!(page_table[p] & PAGE_FLAG_P)) return 0;
 	return page_table[p] >> 12;
 }
 
+/* get swap slot of swapped out page */
+extern uint32_t page_get_swap(page_id_t p) {
+
+	if (!page_dir_wrap[p/1024] || PAGE_IS_LARGE(p)) return 0;
+	if (!PAGE_IS_SWAPPED(page_table[p])) return 0;
+	return PAGE_SWAP_SLOT(page_table[p]);
+}
+
 /* get frame from page table */
 extern page_frame_id_t page_get_table_frame(page_id_t p) {
 
+	if (page_dir_wrap[p] & PAGE_FLAG_PS) return 0;
 	return page_dir_wrap[p] >> 12;
 }
 
-/* unmap page */
+/* unmap page (a 4M page is unmapped as a whole) */
 extern void page_unmap(page_id_t p) {
 
 	if (!page_dir_wrap[p/1024]) return;
 
-	page_table[p] = 0;
+	if (PAGE_IS_LARGE(p)) page_dir_wrap[p/1024] = 0;
+	else {
+
+		/* not present entries are never cached */
+		page_tab_entry_t ent = page_table[p];
+		page_table[p] = 0;
+
+		if (PAGE_IS_SWAPPED(ent)) swap_put(PAGE_SWAP_SLOT(ent));
+		if (!(ent & PAGE_FLAG_P)) return;
+	}
 	page_invalidate(p);
 }
 
+/* flush all non-global tlb entries */
+extern void page_flush(void) {
+
+	uint32_t cr3;
+	asm volatile("mov %%cr3, %0\n"
+		"mov %0, %%cr3": "=r"(cr3));
+}
+
+/* flush all tlb entries including global ones */
+extern void page_flush_global(void) {
+
+	uint32_t cr4 = cpu_get_cr4();
+	if (!(cr4 & CPU_CR4_PGE)) {
+
+		page_flush();
+		return;
+	}
+
+	cpu_set_cr4(cr4 & ~CPU_CR4_PGE);
+	cpu_set_cr4(cr4);
+}
+
 /* get kernel page directory */
 extern void *page_get_directory(void) {
 
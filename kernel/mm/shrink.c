@@ -0,0 +1,74 @@
+/*
+ * Copyright 2025-2026, Elliot Kohlmyer
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <kernel/types.h>
+#include <kernel/mm/shrink.h>
+
+static shrinker_t *first = NULL; /* least recently scanned cache */
+static shrinker_t *last = NULL; /* most recently scanned cache */
+static uint32_t nlock = 0; /* allocator internals in progress */
+static bool busy = false; /* shrink in progress */
+static uint32_t backoff = 0; /* early shrinks left to skip */
+
+/* add cache to registry */
+extern void shrink_register(shrinker_t *shrinker) {
+
+	/* new caches have never been scanned */
+	shrinker->next = first;
+	first = shrinker;
+	if (!last) last = shrinker;
+}
+
+/* release up to count objects from caches, returns number released */
+extern uint32_t shrink_run(uint32_t count, bool force) {
+
+	/* freeing objects must not recurse into another shrink */
+	if (!first || busy || nlock) return 0;
+
+	/* early shrinks give up for a while once the caches are empty */
+	if (!force && backoff) {
+
+		backoff--;
+		return 0;
+	}
+
+	busy = true;
+
+	/* each cache gets one scan, the one left alone the longest goes first */
+	uint32_t freed = 0;
+	shrinker_t *stop = last;
+	while (freed < count) {
+
+		shrinker_t *shrinker = first;
+		freed += shrinker->scan(count - freed);
+
+		/* move to the back */
+		if (shrinker != last) {
+
+			first = shrinker->next;
+			shrinker->next = NULL;
+			last->next = shrinker;
+			last = shrinker;
+		}
+		if (shrinker == stop) break;
+	}
+
+	busy = false;
+
+	backoff = freed? 0: SHRINK_BACKOFF;
+	return freed;
+}
+
+/* keep shrinkers out of allocator internals */
+extern void shrink_lock(void) {
+
+	nlock++;
+}
+
+/* allow shrinkers again */
+extern void shrink_unlock(void) {
+
+	nlock--;
+}
@@ -0,0 +1,194 @@
+/*
+ * Copyright 2025-2026, Elliot Kohlmyer
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <kernel/types.h>
+#include <kernel/tty.h>
+#include <kernel/mm/paging.h>
+#include <kernel/mm/heap.h>
+#include <kernel/mm/slab.h>
+
+#define SLAB_MINOBJS 8 /* minimum number of objects per slab */
+#define SLAB_MAXSIZE 0x8000 /* maximum size of a slab */
+#define SLAB_MAXEMPTY 1 /* number of empty slabs kept per cache */
+
+#define SLAB_OBJSTART ALIGN(sizeof(kmem_slab_t), 8)
+
+static kmem_cache_t *caches = NULL;
+
+/* add slab to list */
+static void slab_add_to_list(kmem_slab_t **list, kmem_slab_t *slab) {
+
+	slab->prev = NULL;
+	slab->next = *list;
+	if (*list) (*list)->prev = slab;
+	*list = slab;
+}
+
+/* remove slab from list */
+static void slab_remove_from_list(kmem_slab_t **list, kmem_slab_t *slab) {
+
+	if (slab->prev) slab->prev->next = slab->next;
+	else *list = slab->next;
+	if (slab->next) slab->next->prev = slab->prev;
+	slab->prev = NULL;
+	slab->next = NULL;
+}
+
+/* allocate new slab */
+static kmem_slab_t *slab_new(kmem_cache_t *cache) {
+
+	kmem_slab_t *slab = (kmem_slab_t *)kmalloca(cache->slabsz, cache->slabsz);
+	if (!slab) return NULL;
+
+	slab->cache = cache;
+	slab->prev = NULL;
+	slab->next = NULL;
+	slab->free = NULL;
+	slab->inuse = 0;
+
+	/* build free list (constructed objects) */
+	void *obj = (void *)slab + SLAB_OBJSTART + (cache->nobjs - 1) * cache->objsz;
+	for (uint32_t i = 0; i < cache->nobjs; i++) {
+
+		if (cache->ctor) cache->ctor(obj);
+
+		*(void **)(obj + cache->linkoff) = slab->free;
+		slab->free = obj;
+		obj -= cache->objsz;
+	}
+
+	cache->nslabs++;
+	return slab;
+}
+
+/* release slab */
+static void slab_free(kmem_slab_t *slab) {
+
+	slab->cache->nslabs--;
+	kfree(slab);
+}
+
+/* create object cache */
+extern kmem_cache_t *kmem_cache_create(const char *name, size_t size, kmem_ctor_t ctor) {
+
+	kmem_cache_t *cache = (kmem_cache_t *)kmalloc(sizeof(kmem_cache_t));
+	if (!cache) return NULL;
+
+	size = ALIGN(MAX(size, sizeof(void *)), 8);
+
+	cache->name = name;
+	cache->size = size;
+	cache->ctor = ctor;
+
+	/* constructed objects keep their state, so the free link goes after the object */
+	cache->linkoff = ctor? size: 0;
+	cache->objsz = ctor? size + 8: size;
+
+	/* fit a reasonable number of objects in each slab */
+	cache->slabsz = PAGE_SIZE;
+	while (cache->slabsz < SLAB_MAXSIZE && (cache->slabsz - SLAB_OBJSTART) / cache->objsz < SLAB_MINOBJS)
+		cache->slabsz <<= 1;
+	cache->nobjs = (cache->slabsz - SLAB_OBJSTART) / cache->objsz;
+
+	cache->full = NULL;
+	cache->partial = NULL;
+	cache->empty = NULL;
+	cache->nslabs = 0;
+	cache->nempty = 0;
+	cache->nactive = 0;
+
+	cache->next = caches;
+	caches = cache;
+
+	return cache;
+}
+
+/* allocate object */
+extern void *kmem_cache_alloc(kmem_cache_t *cache) {
+
+	kmem_slab_t *slab = cache->partial;
+
+	/* get empty or new slab */
+	if (!slab) {
+
+		if (cache->empty) {
+
+			slab = cache->empty;
+			slab_remove_from_list(&cache->empty, slab);
+			cache->nempty--;
+		}
+		else if (!(slab = slab_new(cache)))
+			return NULL;
+
+		slab_add_to_list(&cache->partial, slab);
+	}
+
+	/* take object */
+	void *obj = slab->free;
+	slab->free = *(void **)(obj + cache->linkoff);
+	slab->inuse++;
+	cache->nactive++;
+
+	if (slab->inuse == cache->nobjs) {
+
+		slab_remove_from_list(&cache->partial, slab);
+		slab_add_to_list(&cache->full, slab);
+	}
+	return obj;
+}
+
+/* free object */
+extern void kmem_cache_free(kmem_cache_t *cache, void *p) {
+
+	if (!p) return;
+
+	kmem_slab_t *slab = (kmem_slab_t *)((uintptr_t)p & ~(cache->slabsz - 1));
+
+	*(void **)(p + cache->linkoff) = slab->free;
+	slab->free = p;
+
+	if (slab->inuse == cache->nobjs) {
+
+		slab_remove_from_list(&cache->full, slab);
+		slab_add_to_list(&cache->partial, slab);
+	}
+	slab->inuse--;
+	cache->nactive--;
+
+	/* slab is unused */
+	if (!slab->inuse) {
+
+		slab_remove_from_list(&cache->partial, slab);
+		if (cache->nempty >= SLAB_MAXEMPTY) slab_free(slab);
+		else {
+
+			slab_add_to_list(&cache->empty, slab);
+			cache->nempty++;
+		}
+	}
+}
+
+/* release empty slabs */
+extern void kmem_cache_shrink(kmem_cache_t *cache) {
+
+	while (cache->empty) {
+
+		kmem_slab_t *slab = cache->empty;
+		slab_remove_from_list(&cache->empty, slab);
+		slab_free(slab);
+	}
+	cache->nempty = 0;
+}
+
+/* debug */
+extern void kmem_print(void) {
+
+	kmem_cache_t *cache = caches;
+	while (cache) {
+
+		tty_printf("%s: size: %d, active: %d, slabs: %d (%d empty), slab size: %d\n", cache->name, cache->size, cache->nactive, cache->nslabs, cache->nempty, cache->slabsz);
+		cache = cache->next;
+	}
+}
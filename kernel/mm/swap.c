@@ -0,0 +1,273 @@
+/*
+ * Copyright 2025-2026, Elliot Kohlmyer
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <kernel/types.h>
+#include <kernel/string.h>
+#include <kernel/panic.h>
+#include <kernel/boot.h>
+#include <kernel/task.h>
+#include <kernel/io/cpu.h>
+#include <kernel/mm/heap.h>
+#include <kernel/mm/zram.h>
+#include <kernel/mm/swap.h>
+#include <kernel/mm/shrink.h>
+
+/* swap area */
+typedef struct swap_area {
+	uint32_t start; /* first slot */
+	uint32_t nslots; /* number of slots */
+	uint32_t hint; /* where to look for a free slot */
+	uint32_t nused; /* number of used slots */
+	device_t *dev; /* device holding slots (NULL for the compressed pool) */
+	uint32_t lba; /* first sector */
+} swap_area_t;
+
+static swap_area_t areas[SWAP_MAXAREAS]; /* areas in order of preference */
+static uint32_t nareas = 0;
+static uint32_t nslots = 1; /* slot 0 is never used */
+static uint16_t *refs = NULL; /* references held on each slot */
+static bool busy = false; /* reclaim in progress */
+static uint32_t backoff = 0; /* early reclaims left to skip */
+
+/* make room for area */
+static swap_area_t *area_new(uint32_t count, bool first) {
+
+	count = MIN(count, SWAP_MAXSLOTS - nslots);
+	if (nareas >= SWAP_MAXAREAS || !count) return NULL;
+
+	uint16_t *nrefs = (uint16_t *)kmalloc((nslots + count) * sizeof(uint16_t));
+	if (!nrefs) return NULL;
+
+	memset(nrefs, 0, (nslots + count) * sizeof(uint16_t));
+	if (refs) {
+
+		memcpy(nrefs, refs, nslots * sizeof(uint16_t));
+		kfree(refs);
+	}
+	refs = nrefs;
+
+	/* preferred areas go to the front */
+	uint32_t i = first? 0: nareas;
+	for (uint32_t j = nareas; j > i; j--)
+		areas[j] = areas[j-1];
+	nareas++;
+
+	swap_area_t *area = &areas[i];
+	area->start = nslots;
+	area->nslots = count;
+	area->hint = 0;
+	area->nused = 0;
+	area->dev = NULL;
+	area->lba = 0;
+
+	nslots += count;
+	return area;
+}
+
+/* get area holding slot */
+static swap_area_t *area_get(uint32_t slot) {
+
+	for (uint32_t i = 0; i < nareas; i++) {
+		if (slot >= areas[i].start && slot < areas[i].start + areas[i].nslots) return &areas[i];
+	}
+	return NULL;
+}
+
+/* set up compressed pool if requested */
+extern void swap_init(void) {
+
+	boot_cmdline_t *cmdline = boot_get_cmdline();
+	if (cmdline->zram_size) swap_add_zram(cmdline->zram_size * (0x100000 / PAGE_SIZE));
+}
+
+/* use disk area for swap */
+extern bool swap_add(device_t *dev, uint32_t lba, uint32_t nsects) {
+
+	if (!dev) return false;
+
+	swap_area_t *area = area_new(nsects / SWAP_SECTS, false);
+	if (!area) return false;
+
+	area->dev = dev;
+	area->lba = lba;
+
+	kprintf(LOG_INFO, "[swap] Using %d KiB on device '%s'", (int)(area->nslots * (PAGE_SIZE / 1024)), dev->desc);
+	return true;
+}
+
+/* use compressed pool of count pages for swap (preferred over disk) */
+extern bool swap_add_zram(uint32_t count) {
+
+	for (uint32_t i = 0; i < nareas; i++) {
+		if (!areas[i].dev) return false;
+	}
+
+	count = MIN(count, SWAP_MAXSLOTS - nslots);
+	if (!zram_init(count)) return false;
+
+	swap_area_t *area = area_new(count, true);
+	if (!area) {
+
+		zram_destroy();
+		return false;
+	}
+
+	kprintf(LOG_INFO, "[swap] Using compressed pool for up to %d KiB", (int)(area->nslots * (PAGE_SIZE / 1024)));
+	return true;
+}
+
+/* check if swap space is available */
+extern bool swap_is_active(void) {
+
+	return nareas > 0;
+}
+
+/* allocate slot in area (0 if full) */
+static uint32_t area_alloc(swap_area_t *area) {
+
+	if (area->nused >= area->nslots) return 0;
+
+	for (uint32_t i = 0; i < area->nslots; i++) {
+
+		uint32_t n = (area->hint + i) % area->nslots;
+		uint32_t slot = area->start + n;
+		if (refs[slot]) continue;
+
+		refs[slot] = 1;
+		area->nused++;
+		area->hint = n + 1;
+		return slot;
+	}
+	return 0;
+}
+
+/* write frame to a new slot (0 if full) */
+extern uint32_t swap_store(page_frame_id_t f) {
+
+	/* callers might be using the window themselves */
+	uint32_t flags = cpu_irq_save();
+	page_frame_id_t prev = page_get_temp();
+
+	uint32_t slot = 0;
+	for (uint32_t i = 0; i < nareas && !slot; i++) {
+
+		swap_area_t *area = &areas[i];
+		if (!(slot = area_alloc(area))) continue;
+
+		/* a full pool passes pages on to disk */
+		if (!area->dev) {
+
+			if (!zram_store(slot - area->start, f)) {
+
+				swap_put(slot);
+				slot = 0;
+			}
+			continue;
+		}
+
+		uint8_t *buf = (uint8_t *)page_map_temp(f);
+		uint32_t lba = area->lba + (slot - area->start) * SWAP_SECTS;
+		for (uint32_t j = 0; j < SWAP_SECTS; j++)
+			device_storage_write(area->dev, lba + j, 1, buf + j * SWAP_SECTSZ);
+	}
+
+	if (prev) page_map_temp(prev);
+	else page_unmap_temp();
+	cpu_irq_restore(flags);
+	return slot;
+}
+
+/* add reference to slot */
+extern bool swap_dup(uint32_t slot) {
+
+	if (!slot || slot >= nslots || !refs[slot] || refs[slot] == SWAP_MAXREF)
+		return false;
+
+	refs[slot]++;
+	return true;
+}
+
+/* drop reference to slot, freeing it with the last one */
+extern void swap_put(uint32_t slot) {
+
+	if (!slot || slot >= nslots || !refs[slot] || --refs[slot]) return;
+
+	swap_area_t *area = area_get(slot);
+	if (!area) return;
+
+	area->nused--;
+	if (!area->dev) zram_free(slot - area->start);
+}
+
+/* get number of references to slot */
+extern uint32_t swap_count(uint32_t slot) {
+
+	if (!slot || slot >= nslots) return 0;
+	return refs[slot];
+}
+
+/* get number of slots */
+extern uint32_t swap_get_total(void) {
+
+	return nslots - 1;
+}
+
+/* get number of used slots */
+extern uint32_t swap_get_used(void) {
+
+	uint32_t used = 0;
+	for (uint32_t i = 0; i < nareas; i++)
+		used += areas[i].nused;
+	return used;
+}
+
+/* read slot into frame */
+extern void swap_read(uint32_t slot, page_frame_id_t f) {
+
+	swap_area_t *area = area_get(slot);
+	if (!area || !refs[slot]) return;
+
+	uint32_t flags = cpu_irq_save();
+	page_frame_id_t prev = page_get_temp();
+
+	if (!area->dev) zram_load(slot - area->start, f);
+	else {
+
+		uint8_t *buf = (uint8_t *)page_map_temp(f);
+		uint32_t lba = area->lba + (slot - area->start) * SWAP_SECTS;
+		for (uint32_t i = 0; i < SWAP_SECTS; i++)
+			device_storage_read(area->dev, lba + i, 1, buf + i * SWAP_SECTSZ);
+	}
+
+	if (prev) page_map_temp(prev);
+	else page_unmap_temp();
+	cpu_irq_restore(flags);
+}
+
+/* swap out pages to free frames, returns number of frames freed */
+extern uint32_t swap_reclaim(bool force) {
+
+	/* writing pages out must not recurse into another reclaim */
+	if (!nareas || busy) return 0;
+
+	/* early reclaims give up for a while once there is nothing left to swap */
+	if (!force && backoff) {
+
+		backoff--;
+		return 0;
+	}
+
+	/* page tables sit in the temp window, shrinkers must not run underneath */
+	uint32_t flags = cpu_irq_save();
+	busy = true;
+	shrink_lock();
+	uint32_t count = task_swap_out(SWAP_CLUSTER);
+	shrink_unlock();
+	busy = false;
+	cpu_irq_restore(flags);
+
+	backoff = count? 0: SWAP_BACKOFF;
+	return count;
+}
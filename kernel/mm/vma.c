@@ -0,0 +1,261 @@
+/*
+ * Copyright 2025-2026, Elliot Kohlmyer
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <kernel/types.h>
+#include <kernel/mm/slab.h>
+#include <kernel/mm/vma.h>
+
+#define VMA_MAXPAGE 0x100000 /* one past the last page */
+
+static kmem_cache_t *vma_cache = NULL;
+
+/* initialize area cache */
+extern void vma_init(void) {
+
+	vma_cache = kmem_cache_create("vma", sizeof(vma_t), NULL);
+}
+
+/* allocate area */
+extern vma_t *vma_new(page_id_t start, page_id_t end, uint32_t type) {
+
+	vma_t *vma = (vma_t *)kmem_cache_alloc(vma_cache);
+	if (!vma) return NULL;
+
+	vma->start = start;
+	vma->end = end;
+	vma->type = type;
+	vma->prot = 0;
+	vma->flags = 0;
+	vma->file = NULL;
+	vma->offset = 0;
+	vma->left = NULL;
+	vma->right = NULL;
+	vma->height = 1;
+	return vma;
+}
+
+/* free area */
+extern void vma_free(vma_t *vma) {
+
+	kmem_cache_free(vma_cache, vma);
+}
+
+/* get subtree height */
+static inline int height(vma_t *vma) {
+
+	return vma? vma->height: 0;
+}
+
+/* recalculate subtree height */
+static inline void update(vma_t *vma) {
+
+	vma->height = MAX(height(vma->left), height(vma->right)) + 1;
+}
+
+/* rotate subtree left */
+static vma_t *rotate_left(vma_t *vma) {
+
+	vma_t *r = vma->right;
+	vma->right = r->left;
+	r->left = vma;
+	update(vma);
+	update(r);
+	return r;
+}
+
+/* rotate subtree right */
+static vma_t *rotate_right(vma_t *vma) {
+
+	vma_t *l = vma->left;
+	vma->left = l->right;
+	l->right = vma;
+	update(vma);
+	update(l);
+	return l;
+}
+
+/* restore avl balance of subtree */
+static vma_t *balance(vma_t *vma) {
+
+	update(vma);
+	int bal = height(vma->left) - height(vma->right);
+
+	if (bal > 1) {
+
+		if (height(vma->left->left) < height(vma->left->right))
+			vma->left = rotate_left(vma->left);
+		return rotate_right(vma);
+	}
+	if (bal < -1) {
+
+		if (height(vma->right->right) < height(vma->right->left))
+			vma->right = rotate_right(vma->right);
+		return rotate_left(vma);
+	}
+	return vma;
+}
+
+/* find area containing page */
+extern vma_t *vma_find(vma_t *root, page_id_t p) {
+
+	while (root) {
+
+		if (p < root->start) root = root->left;
+		else if (p >= root->end) root = root->right;
+		else return root;
+	}
+	return NULL;
+}
+
+/* find lowest area overlapping range */
+extern vma_t *vma_find_overlap(vma_t *root, page_id_t start, page_id_t end) {
+
+	vma_t *found = NULL;
+	while (root) {
+
+		if (root->end <= start) root = root->right;
+		else {
+
+			/* lower areas might overlap too */
+			if (root->start < end) found = root;
+			root = root->left;
+		}
+	}
+	return found;
+}
+
+/* get first area */
+extern vma_t *vma_first(vma_t *root) {
+
+	return vma_find_overlap(root, 0, VMA_MAXPAGE);
+}
+
+/* get area after another */
+extern vma_t *vma_next(vma_t *root, vma_t *vma) {
+
+	return vma_find_overlap(root, vma->end, VMA_MAXPAGE);
+}
+
+/* find lowest free range in bounds */
+extern page_id_t vma_find_free(vma_t *root, page_id_t lo, page_id_t hi, uint32_t count) {
+
+	while (lo + count <= hi) {
+
+		vma_t *vma = vma_find_overlap(root, lo, lo + count);
+		if (!vma) return lo;
+		lo = vma->end;
+	}
+	return 0;
+}
+
+/* insert into subtree */
+static vma_t *insert(vma_t *root, vma_t *vma) {
+
+	if (!root) return vma;
+
+	if (vma->start < root->start) root->left = insert(root->left, vma);
+	else root->right = insert(root->right, vma);
+	return balance(root);
+}
+
+/* insert area (must not overlap) */
+extern void vma_insert(vma_t **root, vma_t *vma) {
+
+	vma->left = NULL;
+	vma->right = NULL;
+	vma->height = 1;
+	*root = insert(*root, vma);
+}
+
+/* detach lowest area of subtree */
+static vma_t *remove_min(vma_t *root, vma_t **min) {
+
+	if (!root->left) {
+
+		*min = root;
+		return root->right;
+	}
+	root->left = remove_min(root->left, min);
+	return balance(root);
+}
+
+/* remove from subtree */
+static vma_t *remove(vma_t *root, vma_t *vma) {
+
+	if (!root) return NULL;
+
+	if (vma->start < root->start) root->left = remove(root->left, vma);
+	else if (vma->start > root->start) root->right = remove(root->right, vma);
+	else {
+
+		/* replace with successor */
+		if (!root->right) return root->left;
+
+		vma_t *min = NULL;
+		vma_t *right = remove_min(root->right, &min);
+		min->left = root->left;
+		min->right = right;
+		return balance(min);
+	}
+	return balance(root);
+}
+
+/* remove area */
+extern void vma_remove(vma_t **root, vma_t *vma) {
+
+	*root = remove(*root, vma);
+	vma->left = NULL;
+	vma->right = NULL;
+}
+
+/* split area at page, returns upper half */
+extern vma_t *vma_split(vma_t **root, vma_t *vma, page_id_t p) {
+
+	if (p <= vma->start || p >= vma->end) return NULL;
+
+	vma_t *upper = vma_new(p, vma->end, vma->type);
+	if (!upper) return NULL;
+
+	upper->prot = vma->prot;
+	upper->flags = vma->flags;
+	upper->file = vma->file;
+	upper->offset = vma->offset + (p - vma->start);
+
+	/* the key of the lower half stays the same */
+	vma->end = p;
+	vma_insert(root, upper);
+	return upper;
+}
+
+/* copy tree */
+extern vma_t *vma_clone(vma_t *root) {
+
+	if (!root) return NULL;
+
+	vma_t *vma = (vma_t *)kmem_cache_alloc(vma_cache);
+	if (!vma) return NULL;
+	*vma = *root;
+
+	vma->left = vma_clone(root->left);
+	vma->right = vma_clone(root->right);
+
+	/* undo partial copy */
+	if ((root->left && !vma->left) || (root->right && !vma->right)) {
+
+		vma_destroy(vma);
+		return NULL;
+	}
+	return vma;
+}
+
+/* free tree */
+extern void vma_destroy(vma_t *root) {
+
+	if (!root) return;
+
+	vma_destroy(root->left);
+	vma_destroy(root->right);
+	vma_free(root);
+}
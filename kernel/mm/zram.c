@@ -0,0 +1,262 @@
+/*
+ * Copyright 2025-2026, Elliot Kohlmyer
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <kernel/types.h>
+#include <kernel/string.h>
+#include <kernel/lz.h>
+#include <kernel/io/cpu.h>
+#include <kernel/mm/heap.h>
+#include <kernel/mm/zram.h>
+
+/*
+ * Compressed pages are packed into frames of a size class, each frame
+ * holding up to 32 objects of the same size. Pages that don't compress to
+ * half a frame or less take a frame of their own.
+ */
+
+#define NONE 0xffffffff
+#define EMPTY 0xffff /* object index of slots holding nothing */
+
+/* pool frame */
+typedef struct zram_page {
+	page_frame_id_t frame; /* frame holding objects */
+	uint32_t used; /* bitmap of used objects */
+	uint32_t cls; /* size class */
+	uint32_t prev; /* previous page of class with free objects */
+	uint32_t next; /* next page of class with free objects (or next unused descriptor) */
+} zram_page_t;
+
+/* stored page */
+typedef struct zram_slot {
+	uint32_t page; /* pool frame holding object (NONE for zero filled pages) */
+	uint16_t obj; /* object index (EMPTY if nothing is stored) */
+	uint16_t size; /* compressed size */
+} zram_slot_t;
+
+static zram_slot_t *slots = NULL;
+static uint32_t nslots = 0;
+static zram_page_t *pages = NULL; /* pool frame descriptors */
+static uint32_t unused = NONE; /* first unused descriptor */
+static uint32_t partial[ZRAM_NCLASSES]; /* pages with free objects */
+static zram_stats_t stats;
+static bool has_tsc = false; /* fault time is only measured with a time stamp counter */
+
+static uint8_t buf[PAGE_SIZE]; /* staging buffer (the window only holds one frame at a time) */
+
+/* get object size of class */
+static inline uint32_t class_size(uint32_t cls) {
+
+	return (cls < ZRAM_NCLASSES - 1)? (cls + 1) * ZRAM_CLASSSZ: PAGE_SIZE;
+}
+
+/* get full object bitmap of class */
+static inline uint32_t class_mask(uint32_t cls) {
+
+	uint32_t n = PAGE_SIZE / class_size(cls);
+	return (n >= 32)? 0xffffffff: (1u << n) - 1;
+}
+
+/* add page to list of class */
+static void partial_add(uint32_t id) {
+
+	zram_page_t *pg = &pages[id];
+	pg->prev = NONE;
+	pg->next = partial[pg->cls];
+	if (pg->next != NONE) pages[pg->next].prev = id;
+	partial[pg->cls] = id;
+}
+
+/* remove page from list of class */
+static void partial_remove(uint32_t id) {
+
+	zram_page_t *pg = &pages[id];
+	if (pg->prev != NONE) pages[pg->prev].next = pg->next;
+	else partial[pg->cls] = pg->next;
+	if (pg->next != NONE) pages[pg->next].prev = pg->prev;
+}
+
+/* set up pool for count pages */
+extern bool zram_init(uint32_t count) {
+
+	if (slots || !count) return false;
+
+	/* in the worst case every page needs a frame */
+	slots = (zram_slot_t *)kmalloc(count * sizeof(zram_slot_t));
+	pages = (zram_page_t *)kmalloc(count * sizeof(zram_page_t));
+	if (!slots || !pages) {
+
+		if (slots) kfree(slots);
+		if (pages) kfree(pages);
+		slots = NULL;
+		pages = NULL;
+		return false;
+	}
+
+	nslots = count;
+	for (uint32_t i = 0; i < count; i++) {
+
+		slots[i].page = NONE;
+		slots[i].obj = EMPTY;
+		slots[i].size = 0;
+		pages[i].frame = 0;
+		pages[i].next = (i + 1 < count)? i + 1: NONE;
+	}
+	unused = 0;
+
+	for (uint32_t i = 0; i < ZRAM_NCLASSES; i++)
+		partial[i] = NONE;
+	memset(&stats, 0, sizeof(stats));
+	has_tsc = cpu_has_feature(CPU_FEATURE_TSC);
+	return true;
+}
+
+/* release pool that holds no pages */
+extern void zram_destroy(void) {
+
+	if (!slots) return;
+
+	kfree(slots);
+	kfree(pages);
+	slots = NULL;
+	pages = NULL;
+	nslots = 0;
+	unused = NONE;
+}
+
+/* take free object of class, returns descriptor */
+static uint32_t object_take(uint32_t cls, uint16_t *obj) {
+
+	uint32_t id = partial[cls];
+	if (id == NONE) {
+
+		if (unused == NONE) return NONE;
+
+		page_frame_id_t fr = page_frame_alloc();
+		if (!fr) return NONE;
+
+		id = unused;
+		unused = pages[id].next;
+
+		pages[id].frame = fr;
+		pages[id].used = 0;
+		pages[id].cls = cls;
+		partial_add(id);
+		stats.nframes++;
+	}
+
+	zram_page_t *pg = &pages[id];
+	*obj = (uint16_t)__builtin_ctz(~pg->used);
+	pg->used |= 1u << *obj;
+	if (pg->used == class_mask(cls)) partial_remove(id);
+	return id;
+}
+
+/* give object back, freeing the frame with the last one */
+static void object_put(uint32_t id, uint16_t obj) {
+
+	zram_page_t *pg = &pages[id];
+	if (pg->used == class_mask(pg->cls)) partial_add(id);
+	pg->used &= ~(1u << obj);
+	if (pg->used) return;
+
+	partial_remove(id);
+	page_frame_free(pg->frame);
+	pg->frame = 0;
+	pg->next = unused;
+	unused = id;
+	stats.nframes--;
+}
+
+/* compress frame into pool (uses the temporary window) */
+extern bool zram_store(uint32_t index, page_frame_id_t f) {
+
+	if (index >= nslots) return false;
+
+	/* zero filled pages need no room at all */
+	const uint32_t *src = (const uint32_t *)page_map_temp(f);
+	uint32_t i = 0;
+	while (i < PAGE_SIZE / 4 && !src[i]) i++;
+	if (i == PAGE_SIZE / 4) {
+
+		slots[index].page = NONE;
+		slots[index].obj = 0;
+		slots[index].size = 0;
+		stats.nstored++;
+		stats.nzero++;
+		return true;
+	}
+
+	size_t size = lz_compress(src, PAGE_SIZE, buf, PAGE_SIZE / 2);
+	if (!size) {
+
+		memcpy(buf, src, PAGE_SIZE);
+		size = PAGE_SIZE;
+	}
+
+	uint32_t cls = (size < PAGE_SIZE)? (uint32_t)(size - 1) / ZRAM_CLASSSZ: ZRAM_NCLASSES - 1;
+	uint16_t obj = 0;
+	uint32_t id = object_take(cls, &obj);
+	if (id == NONE) return false;
+
+	uint8_t *dst = (uint8_t *)page_map_temp(pages[id].frame);
+	memcpy(dst + obj * class_size(cls), buf, size);
+
+	slots[index].page = id;
+	slots[index].obj = obj;
+	slots[index].size = (uint16_t)size;
+	stats.nstored++;
+	stats.compr += (uint32_t)size;
+	return true;
+}
+
+/* decompress page into frame (uses the temporary window) */
+extern void zram_load(uint32_t index, page_frame_id_t f) {
+
+	if (index >= nslots || slots[index].obj == EMPTY) return;
+
+	uint64_t start = has_tsc? cpu_rdtsc(): 0;
+	zram_slot_t *slot = &slots[index];
+
+	if (slot->page == NONE) memset(page_map_temp(f), 0, PAGE_SIZE);
+	else {
+
+		zram_page_t *pg = &pages[slot->page];
+		uint8_t *src = (uint8_t *)page_map_temp(pg->frame) + slot->obj * class_size(pg->cls);
+		memcpy(buf, src, slot->size);
+
+		uint8_t *dst = (uint8_t *)page_map_temp(f);
+		if (slot->size == PAGE_SIZE) memcpy(dst, buf, PAGE_SIZE);
+		else if (lz_decompress(buf, slot->size, dst, PAGE_SIZE) != PAGE_SIZE)
+			memset(dst, 0, PAGE_SIZE);
+	}
+
+	stats.nfaults++;
+	if (has_tsc) stats.fault_cycles += cpu_rdtsc() - start;
+}
+
+/* release stored page */
+extern void zram_free(uint32_t index) {
+
+	if (index >= nslots || slots[index].obj == EMPTY) return;
+
+	zram_slot_t *slot = &slots[index];
+	if (slot->page == NONE) stats.nzero--;
+	else {
+
+		object_put(slot->page, slot->obj);
+		stats.compr -= slot->size;
+	}
+
+	slot->page = NONE;
+	slot->obj = EMPTY;
+	slot->size = 0;
+	stats.nstored--;
+}
+
+/* get pool statistics */
+extern void zram_get_stats(zram_stats_t *out) {
+
+	*out = stats;
+}
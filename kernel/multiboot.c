@@ -96,6 +96,8 @@ extern bool multiboot_init(void) {
 			/* mark frames that aren't available as used */
 			for (uint32_t i = 0; i < nentries; i++) {
 
+				entry = (void *)tag->entries + tag->entsize*i;
+
 				if (entry->type != MULTIBOOT_MEMMAP_AVAIL) {
 
 					page_frame_id_t start = MULTIBOOT_ADDR32(entry->addr)/PAGE_SIZE;
@@ -104,7 +106,14 @@ extern bool multiboot_init(void) {
 					for (page_frame_id_t j = start; j < end; j++)
 						page_frame_use(j);
 				}
-				entry = (void *)tag->entries + tag->entsize*i;
+
+				/* usable memory (below 4G) */
+				else if (entry->addr < 0x100000000ULL) {
+
+					uint64_t end = MIN(entry->addr + entry->length, 0x100000000ULL);
+
+					page_frame_add_region((page_frame_id_t)(ALIGN(entry->addr, PAGE_SIZE)/PAGE_SIZE), (page_frame_id_t)(end/PAGE_SIZE));
+				}
 			}
 		}
 
@@ -0,0 +1,371 @@
+/*
+ * Copyright 2025-2026, Elliot Kohlmyer
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <kernel/types.h>
+#include <kernel/smp.h>
+#include <kernel/idt.h>
+#include <kernel/panic.h>
+#include <kernel/task.h>
+#include <kernel/io/cpu.h>
+#include <kernel/mm/gdt.h>
+#include <kernel/mm/heap.h>
+#include <kernel/mm/paging.h>
+#include <kernel/driver/lapic.h>
+#include <string.h>
+
+/*
+ * All cpus share one kernel lock. A cpu takes it when it enters the kernel and
+ * keeps it for all kernel code, with interrupts enabled or not, so heap, frame
+ * allocator, caches and file systems never see two cpus at once. It is only let
+ * go on the way back to user mode, in idle loops and while waiting for an
+ * interrupt or for another cpu (smp_halt, smp_relax). A task switch leaves it
+ * with the cpu, so the next task continues in the kernel holding it.
+ */
+static spinlock_t kernel_lock = SPINLOCK_INIT;
+
+static cpu_t cpus[SMP_MAXCPUS];
+uint32_t smp_ncpus = 1;
+
+/*
+ * Kernel pages are global and shared by all cpus, so unmapping one has to
+ * reach the tlbs of the others. Each unmap bumps a generation and interrupts
+ * them; a cpu that had interrupts off catches up when it takes the kernel
+ * lock, before it can touch kernel memory again.
+ */
+static volatile uint32_t flush_gen = 0;
+
+static uint8_t table_buf[SMP_MP_TABLE_MAX]; /* configuration table, or memory being scanned */
+
+/* set up per-cpu data of the boot processor */
+extern void smp_init_bsp(void) {
+
+	cpus[0].self = &cpus[0];
+	cpus[0].id = 0;
+	gdt_init(&cpus[0]);
+
+	/* the boot processor runs kernel code from here on */
+	smp_lock();
+}
+
+/* get cpu from index */
+extern cpu_t *smp_get_cpu(uint32_t id) {
+
+	return &cpus[id];
+}
+
+/* take kernel lock (interrupts disabled by caller), returns true if the cpu already held it */
+extern bool smp_lock(void) {
+
+	cpu_t *cpu = smp_cpu();
+	if (cpu->locked) return true;
+
+	spin_lock(&kernel_lock);
+	cpu->locked = true;
+
+	/* kernel pages may have been unmapped meanwhile */
+	if (cpu->flushgen != flush_gen) {
+
+		cpu->flushgen = flush_gen;
+		page_flush_global();
+	}
+	return false;
+}
+
+/* release kernel lock if held (interrupts disabled by caller) */
+extern void smp_unlock(void) {
+
+	cpu_t *cpu = smp_cpu();
+	if (!cpu->locked) return;
+
+	cpu->locked = false;
+	spin_unlock(&kernel_lock);
+}
+
+/* wait for an interrupt without holding the kernel lock (interrupts enabled by caller) */
+extern void smp_halt(void) {
+
+	asm volatile("cli");
+	smp_unlock();
+	asm volatile("sti\n"
+		"hlt\n"
+		"cli");
+	smp_lock();
+	asm volatile("sti");
+}
+
+/* let other cpus into the kernel while waiting for them (interrupts enabled by caller) */
+extern void smp_relax(void) {
+
+	asm volatile("cli");
+	smp_unlock();
+	asm volatile("sti\n"
+		"pause\n"
+		"cli");
+	smp_lock();
+	asm volatile("sti");
+}
+
+/* drop kernel tlb entries of other cpus (kernel lock held) */
+extern void smp_flush_others(void) {
+
+	if (smp_ncpus < 2) return;
+
+	smp_cpu()->flushgen = ++flush_gen;
+	lapic_send_others(IDT_INT_FLUSH);
+}
+
+/* handle flush interrupt */
+extern void smp_flush_handler(void) {
+
+	cpu_t *cpu = smp_cpu();
+	cpu->flushgen = flush_gen;
+	page_flush_global();
+	lapic_eoi();
+}
+
+/* get other cpu to look at its run queue */
+extern void smp_send_resched(uint32_t id) {
+
+	if (id < smp_ncpus && id != smp_cpu()->id)
+		lapic_send_ipi(cpus[id].apicid, IDT_INT_RESCHED);
+}
+
+/* copy physical memory */
+static void smp_read_phys(uint32_t addr, void *buf, uint32_t len) {
+
+	uint8_t *dst = (uint8_t *)buf;
+	page_frame_id_t prev = page_get_temp();
+	while (len) {
+
+		uint32_t off = addr % PAGE_SIZE;
+		uint32_t n = MIN(len, PAGE_SIZE - off);
+		memcpy(dst, (uint8_t *)page_map_temp(addr / PAGE_SIZE) + off, n);
+
+		addr += n;
+		dst += n;
+		len -= n;
+	}
+	if (prev) page_map_temp(prev);
+	else page_unmap_temp();
+}
+
+/* check that bytes add up to zero */
+static bool smp_checksum(const void *data, uint32_t len) {
+
+	uint8_t sum = 0;
+	for (uint32_t i = 0; i < len; i++)
+		sum += ((const uint8_t *)data)[i];
+	return !sum;
+}
+
+/* look for mp floating pointer in physical memory range */
+static bool smp_scan(uint32_t start, uint32_t len, smp_mp_t *mp) {
+
+	for (uint32_t addr = start; addr < start + len; addr += PAGE_SIZE) {
+
+		uint32_t n = MIN(PAGE_SIZE, start + len - addr);
+		smp_read_phys(addr, table_buf, n);
+
+		for (uint32_t off = 0; off + sizeof(smp_mp_t) <= n; off += 16) {
+
+			smp_mp_t *cur = (smp_mp_t *)&table_buf[off];
+			if (cur->sig != SMP_MP_SIG || off + cur->len * 16 > n) continue;
+			if (!smp_checksum(cur, cur->len * 16)) continue;
+
+			*mp = *cur;
+			return true;
+		}
+	}
+	return false;
+}
+
+/* find mp floating pointer where the specification says it can be */
+static bool smp_find(smp_mp_t *mp) {
+
+	/* first kilobyte of the extended bios data area */
+	uint16_t ebda = 0;
+	smp_read_phys(0x40e, &ebda, sizeof(ebda));
+	if (ebda && smp_scan((uint32_t)ebda << 4, 1024, mp)) return true;
+
+	/* last kilobyte of base memory */
+	uint16_t basekb = 0;
+	smp_read_phys(0x413, &basekb, sizeof(basekb));
+	if (basekb && smp_scan(((uint32_t)basekb - 1) * 1024, 1024, mp)) return true;
+	if (smp_scan(0x9fc00, 1024, mp)) return true;
+
+	/* bios rom */
+	return smp_scan(0xf0000, 0x10000, mp);
+}
+
+/* wait for nanoseconds or until flag is set */
+static void smp_wait(uint64_t ns, volatile bool *flag) {
+
+	uint64_t end = task_get_global_time() + ns;
+	while ((!flag || !*flag) && task_get_global_time() < end)
+		smp_halt();
+}
+
+/* entry point of application processors, continues as their idle task */
+static void smp_ap_main(uint32_t id, void *esp) {
+
+	cpu_t *cpu = &cpus[id];
+	cpu->self = cpu;
+	gdt_init(cpu);
+	idt_load();
+	idt_load_sysenter();
+	lapic_init_ap();
+
+	if (!task_new_idle(esp)) {
+
+		kprintf(LOG_WARNING, "[smp] No task for idle loop of cpu %d", (int)id);
+		asm volatile("cli");
+		smp_unlock();
+		while (true) asm volatile("hlt");
+	}
+
+	/* cpu indices are handed out in order, so this cpu is the last one */
+	task_lockcli();
+	cpu->online = true;
+	smp_ncpus = id + 1;
+	task_unlockcli();
+
+	/* ticks and reschedule requests switch to other tasks from here, interrupting the idle loop leaves the lock free again */
+	asm volatile("cli");
+	smp_unlock();
+	asm volatile("sti");
+	while (true) asm volatile("hlt");
+}
+
+/* start application processor, returns true once it is online */
+static bool smp_start(smp_params_t *params, uint32_t apicid) {
+
+	uint32_t id = smp_ncpus;
+	cpu_t *cpu = &cpus[id];
+	cpu->id = id;
+	cpu->apicid = apicid;
+
+	task_lockcli();
+	void *stack = kmalloc(SMP_STACKSZ);
+	task_unlockcli();
+	if (!stack) return false;
+
+	params->esp = (uint32_t)stack + SMP_STACKSZ;
+	params->id = id;
+
+	/* init, then startup twice as the specification asks */
+	lapic_send_init(apicid);
+	smp_wait(SMP_INIT_DELAY, NULL);
+	lapic_send_startup(apicid, SMP_TRAMPOLINE);
+	smp_wait(SMP_STARTUP_DELAY, &cpu->online);
+	if (!cpu->online) lapic_send_startup(apicid, SMP_TRAMPOLINE);
+	smp_wait(SMP_START_TIMEOUT, &cpu->online);
+
+	/* the stack stays allocated, the cpu might still show up later */
+	return cpu->online;
+}
+
+/* read mp configuration table into table_buf, returns NULL if there is none */
+static smp_mp_table_t *smp_read_table(void) {
+
+	smp_mp_t mp;
+
+	task_lockcli();
+	bool found = smp_find(&mp);
+	task_unlockcli();
+
+	if (!found) {
+
+		kprintf(LOG_INFO, "[smp] No MP table, using one cpu");
+		return NULL;
+	}
+	if (!mp.table || mp.features[0]) {
+
+		kprintf(LOG_INFO, "[smp] Default MP configurations are not supported, using one cpu");
+		return NULL;
+	}
+
+	task_lockcli();
+	smp_read_phys(mp.table, table_buf, sizeof(smp_mp_table_t));
+	smp_mp_table_t *table = (smp_mp_table_t *)table_buf;
+	uint32_t len = MIN(table->len, SMP_MP_TABLE_MAX);
+	if (table->sig == SMP_MP_TABLE_SIG) smp_read_phys(mp.table, table_buf, len);
+	task_unlockcli();
+
+	if (table->sig != SMP_MP_TABLE_SIG || len != table->len || !smp_checksum(table_buf, len)) {
+
+		kprintf(LOG_WARNING, "[smp] Invalid MP configuration table");
+		return NULL;
+	}
+	return table;
+}
+
+/* find and start application processors */
+extern void smp_init(void) {
+
+	smp_mp_table_t *table = smp_read_table();
+
+	/* a single cpu still uses its local apic for the scheduler timer */
+	if (!lapic_init(table? table->lapic: 0)) {
+
+		kprintf(LOG_INFO, "[smp] No local APIC, using one cpu");
+		return;
+	}
+	cpus[0].apicid = lapic_id();
+	if (!table) return;
+	uint32_t len = table->len;
+
+	/* the start code has to sit in the first megabyte, reachable with paging on */
+	page_id_t page = SMP_TRAMPOLINE / PAGE_SIZE;
+	task_lockcli();
+	bool table_mapped = page_dir_wrap[0] != 0;
+	page_map(page, page);
+	task_unlockcli();
+	memcpy((void *)SMP_TRAMPOLINE, smp_trampoline, smp_trampoline_end - smp_trampoline);
+
+	smp_params_t *params = (smp_params_t *)(SMP_TRAMPOLINE + (smp_trampoline_params - smp_trampoline));
+	params->cr3 = (uint32_t)ktask->cr3;
+	params->cr4 = cpu_get_cr4();
+	params->entry = (uint32_t)smp_ap_main;
+
+	uint8_t *ent = table_buf + sizeof(smp_mp_table_t);
+	for (uint32_t i = 0; i < table->count && ent < table_buf + len; i++) {
+
+		if (*ent != SMP_MP_ENTRY_CPU) {
+
+			ent += 8;
+			continue;
+		}
+
+		smp_mp_cpu_t *mpcpu = (smp_mp_cpu_t *)ent;
+		ent += sizeof(smp_mp_cpu_t);
+		if (!(mpcpu->flags & SMP_MP_CPU_ENABLED) || mpcpu->apicid == cpus[0].apicid) continue;
+
+		if (smp_ncpus >= SMP_MAXCPUS) {
+
+			kprintf(LOG_WARNING, "[smp] Ignoring cpus after the first %d", SMP_MAXCPUS);
+			break;
+		}
+
+		/* a late cpu would run with the parameters of the next one */
+		if (!smp_start(params, mpcpu->apicid)) {
+
+			kprintf(LOG_WARNING, "[smp] Cpu with APIC id %d did not start", (int)mpcpu->apicid);
+			break;
+		}
+	}
+
+	/* drop the identity mapping again */
+	task_lockcli();
+	page_unmap(page);
+	if (!table_mapped) {
+
+		page_frame_free(page_get_table_frame(0));
+		page_dir_wrap[0] = 0;
+		page_flush();
+	}
+	task_unlockcli();
+
+	kprintf(LOG_INFO, "[smp] %d cpu(s) online", (int)smp_ncpus);
+}
@@ -0,0 +1,78 @@
+;
+; Copyright 2025-2026, Elliot Kohlmyer
+;
+; SPDX-License-Identifier: BSD-3-Clause
+;
+%define TRAMPOLINE 0x7000
+
+; address of a label once the code is copied to TRAMPOLINE ;
+%define ADDR(x) (TRAMPOLINE + (x) - smp_trampoline)
+
+	[global smp_trampoline]
+	[global smp_trampoline_params]
+	[global smp_trampoline_end]
+
+section .text
+
+; application processors start here in real mode ;
+bits 16
+smp_trampoline:
+	cli
+	cld
+	xor ax, ax
+	mov ds, ax
+
+	; enter protected mode with a flat gdt ;
+	lgdt [ADDR(tramp_gdt_desc)]
+	mov eax, cr0
+	or eax, 0x1
+	mov cr0, eax
+	jmp dword 0x08:ADDR(tramp_pmode)
+
+bits 32
+tramp_pmode:
+	mov ax, 0x10
+	mov ds, ax
+	mov es, ax
+	mov fs, ax
+	mov gs, ax
+	mov ss, ax
+
+	; enable paging with the kernel page directory ;
+	mov eax, [ADDR(smp_trampoline_params.cr4)]
+	mov cr4, eax
+	mov eax, [ADDR(smp_trampoline_params.cr3)]
+	mov cr3, eax
+	mov eax, cr0
+	or eax, 0x80010000
+	mov cr0, eax
+
+	; enter kernel with id and stack top as arguments ;
+	mov esp, [ADDR(smp_trampoline_params.esp)]
+	push dword [ADDR(smp_trampoline_params.esp)]
+	push dword [ADDR(smp_trampoline_params.id)]
+	call [ADDR(smp_trampoline_params.entry)]
+
+.loop:
+	cli
+	hlt
+	jmp .loop
+
+	; filled in by smp_init (smp_params_t) ;
+	align 4
+smp_trampoline_params:
+.cr3: dd 0
+.cr4: dd 0
+.esp: dd 0
+.id: dd 0
+.entry: dd 0
+
+	align 8
+tramp_gdt:
+	dq 0
+	dq 0x00cf9a000000ffff ; code ;
+	dq 0x00cf92000000ffff ; data ;
+tramp_gdt_desc:
+	dw tramp_gdt_desc - tramp_gdt - 1
+	dd ADDR(tramp_gdt)
+smp_trampoline_end:
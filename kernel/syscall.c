@@ -4,13 +4,15 @@
  * SPDX-License-Identifier: BSD-3-Clause
  */
 #include <kernel/types.h>
+#include <kernel/clock.h>
 #include <kernel/panic.h>
 #include <kernel/string.h>
 #include <kernel/task.h>
 #include <kernel/elf.h>
 #include <kernel/users.h>
 #include <kernel/mm/heap.h>
-#include <kernel/driver/rtc.h>
+#include <kernel/mm/swap.h>
+#include <kernel/mm/zram.h>
 #include <errno.h>
 #include <kernel/syscall.h>
 
@@ -41,6 +43,13 @@ static idt_isr_t sysh[ECN_COUNT] = {
 	[ECN_KINFO] = sys_kinfo,
 	[ECN_GETUSER] = sys_getuser,
 	[ECN_SETUSER] = sys_setuser,
+	[ECN_FORK] = sys_fork,
+	[ECN_MMAP] = sys_mmap,
+	[ECN_MUNMAP] = sys_munmap,
+	[ECN_MPROTECT] = sys_mprotect,
+	[ECN_PINFO] = sys_pinfo,
+	[ECN_SETPRIO] = sys_setprio,
+	[ECN_NICE] = sys_nice,
 };
 
 #define RETURN_ERROR(c) ({\
@@ -138,10 +147,14 @@ extern void sys_stat(idt_regs_t *regs) {
 	if (!path || !st)
 		RETURN_ERROR(-EINVAL);
 
+	task_lockcli();
 	fs_node_t *node = fs_resolve(path);
+	if (node) fs_node_pin(node);
+	task_unlockcli();
 	if (!node) RETURN_ERROR(-ENOENT);
 
 	nstat(node, st);
+	fs_node_unpin(node);
 	regs->eax = 0;
 }
 
@@ -197,11 +210,10 @@ extern void sys_gettimeofday(idt_regs_t *regs) {
 
 	ec_timeval_t *tv = (ec_timeval_t *)regs->ebx;
 
-	rtc_cmos_regs_t cmos;
-	rtc_get_registers(&cmos);
+	uint64_t wall = clock_wall_ns();
 
-	tv->sec = rtc_get_time(&cmos);
-	tv->nsec = 0;
+	tv->sec = wall / 1000000000;
+	tv->nsec = wall % 1000000000;
 
 	regs->eax = 0;
 }
@@ -211,7 +223,7 @@ extern void sys_timens(idt_regs_t *regs) {
 
 	ec_timeval_t *tv = (ec_timeval_t *)regs->ebx;
 
-	uint64_t timens = task_get_global_time();
+	uint64_t timens = clock_ns();
 
 	tv->sec = timens / 1000000000;
 	tv->nsec = timens % 1000000000;
@@ -401,51 +413,81 @@ extern void sys_readdir(idt_regs_t *regs) {
 	if (!dent) RETURN_ERROR(-EINVAL);
 
 	fs_dirent_t *fdent = NULL;
+	fs_node_t *dir = NULL;
 
 	/* find and acquire resource */
 	if (path) {
 
 		memset(dent, 0, sizeof(ec_dirent_t));
 
-		fs_node_t *node = fs_resolve(path);
-		if (!node) RETURN_ERROR(-ENOENT);
+		/* pin directory so its entries stay cached until they are copied */
+		task_lockcli();
+		dir = fs_resolve(path);
+		if (dir) {
+
+			while (dir->ptr) dir = dir->ptr;
+			fs_node_pin(dir);
+		}
+		task_unlockcli();
+		if (!dir) RETURN_ERROR(-ENOENT);
 
-		while (node->ptr) node = node->ptr;
+		if (!(dir->flags & FS_DIRECTORY)) {
 
-		if (!(node->flags & FS_DIRECTORY))
+			fs_node_unpin(dir);
 			RETURN_ERROR(-ENOTDIR);
+		}
 
 		/* update directory */
-		if (!node->first) {
+		if (!dir->first) {
 
 			task_active->stale = false;
-			task_acquire(node);
-			if (task_active->stale)
+			task_acquire(dir);
+			if (task_active->stale) {
+
+				fs_node_unpin(dir);
 				RETURN_ERROR(-EINTR);
+			}
 
-			fdent = fs_readdir(node, 0);
+			fdent = fs_readdir(dir, 0);
 			task_release();
 		}
-		else fdent = node->first;
+		else fdent = fs_readdir(dir, 0);
 		dent->_data = (void *)fdent;
+		dent->_gen = fs_generation;
 	}
 
-	/* get next entry */
+	/* get next entry, with interrupts locked until it is copied */
 	else {
 
+		task_lockcli();
+
+		/* entries might have been dropped from the cache since */
+		if (dent->_gen != fs_generation) {
+
+			task_unlockcli();
+			RETURN_ERROR(-ESTALE);
+		}
+
 		fdent = (fs_dirent_t *)dent->_data;
-		fdent = fdent->next;
+		if (fdent) fdent = fdent->next;
 		dent->_data = (void *)fdent;
+
+		/* keep directory cached while it is being read */
+		if (fdent && fdent->node && fdent->node->parent) fs_node_touch(fdent->node->parent);
 	}
 
 	/* fill dirent */
-	if (!fdent) RETURN_ERROR(1);
+	if (fdent) {
+
+		strncpy(dent->name, fdent->name, ECD_NAMESZ);
+		dent->flags = fdent->node? fdent->node->flags: 0;
+		dent->mask = fdent->node? fdent->node->mask: 0;
+	}
 
-	strncpy(dent->name, fdent->name, ECD_NAMESZ);
-	dent->flags = fdent->node? fdent->node->flags: 0;
-	dent->mask = fdent->node? fdent->node->mask: 0;
+	if (dir) fs_node_unpin(dir);
+	else task_unlockcli();
 
-	regs->eax = 0;
+	regs->eax = fdent? 0: 1;
 }
 
 /* send command to io device */
@@ -466,7 +508,20 @@ extern void sys_kinfo(idt_regs_t *regs) {
 	strcpy(info->name, "eclair-os");
 	memcpy(info->version, os_version, sizeof(uint8_t) * 3);
 	info->mem_total = (uintptr_t)page_frame_max_count * 0x1000;
-	info->mem_free = info->mem_total - ((uintptr_t)page_frame_get_used_count() * 0x1000);
+	info->mem_free = (uintptr_t)page_frame_get_free_total() * 0x1000;
+	info->nswitches = task_nswitches;
+	info->switch_cycles = task_switch_cycles;
+
+	info->swap_total = (uintptr_t)swap_get_total() * 0x1000;
+	info->swap_free = (uintptr_t)(swap_get_total() - swap_get_used()) * 0x1000;
+
+	zram_stats_t zs;
+	zram_get_stats(&zs);
+	info->zram_stored = (uintptr_t)zs.nstored * 0x1000;
+	info->zram_compr = (uintptr_t)zs.compr;
+	info->zram_used = (uintptr_t)zs.nframes * 0x1000;
+	info->zram_faults = zs.nfaults;
+	info->zram_fault_cycles = zs.fault_cycles;
 }
 
 /* get user info */
@@ -500,3 +555,101 @@ extern void sys_setuser(idt_regs_t *regs) {
 
 	regs->eax = (uint32_t)task_setuser(name, pswd);
 }
+
+/* clone current process */
+extern void sys_fork(idt_regs_t *regs) {
+
+	regs->eax = (uint32_t)task_fork(regs);
+}
+
+/* map file or anonymous memory */
+extern void sys_mmap(idt_regs_t *regs) {
+
+	ec_mmap_args_t *args = (ec_mmap_args_t *)regs->ebx;
+	if (!args) RETURN_ERROR(-EINVAL);
+
+	regs->eax = (uint32_t)task_mmap_area(args->addr, args->len, args->prot, args->flags, args->fd, args->offset);
+}
+
+/* remove memory mappings */
+extern void sys_munmap(idt_regs_t *regs) {
+
+	void *addr = (void *)regs->ebx;
+	size_t len = (size_t)regs->ecx;
+
+	regs->eax = (uint32_t)task_munmap(addr, len);
+}
+
+/* change protection of mapped memory */
+extern void sys_mprotect(idt_regs_t *regs) {
+
+	void *addr = (void *)regs->ebx;
+	size_t len = (size_t)regs->ecx;
+	int prot = (int)regs->edx;
+
+	regs->eax = (uint32_t)task_mprotect(addr, len, prot);
+}
+
+/* get process info */
+extern void sys_pinfo(idt_regs_t *regs) {
+
+	int pid = (int)regs->ebx;
+	ec_pinfo_t *info = (ec_pinfo_t *)regs->ecx;
+
+	if (!info || pid < 0) RETURN_ERROR(-EINVAL);
+
+	task_lockcli();
+
+	task_t *task = task_get_next(pid);
+	if (!task) {
+
+		task_unlockcli();
+		RETURN_ERROR(-ESRCH);
+	}
+
+	strncpy(info->name, task->name, EC_PINFO_NAMESZ);
+	info->pid = (int)task->id;
+	info->uid = task->uid;
+	info->state = (int)task->state; /* ECP_* match the task states */
+	info->policy = (int)task->policy; /* ECSCHED_* match the scheduling classes */
+	info->prio = task->prio;
+	info->level = (int)task->level;
+	info->cpu = (int)task->cpu;
+
+	info->mem_resident = (uintptr_t)task->mem.nresident * 0x1000;
+	info->mem_stack = (uintptr_t)task->mem.nstack * 0x1000;
+	info->mem_heap = task->mem.brkbase? (uintptr_t)(task->brkp - task->mem.brkbase): 0;
+	info->mem_device = (uintptr_t)task->mem.ndevice * 0x1000;
+	info->mem_swapped = (uintptr_t)task->mem.nswapped * 0x1000;
+	info->nfaults = task->mem.nfaults;
+	info->nmajfaults = task->mem.nmajfaults;
+
+	task_unlockcli();
+	regs->eax = (uint32_t)info->pid;
+}
+
+/* set scheduling class and priority */
+extern void sys_setprio(idt_regs_t *regs) {
+
+	int pid = (int)regs->ebx;
+	int policy = (int)regs->ecx;
+	int prio = (int)regs->edx;
+
+	task_t *task = task_get(pid);
+	if (!task || task->state == TASK_TERMINATED) RETURN_ERROR(-ESRCH);
+
+	regs->eax = (uint32_t)task_setprio(task, (uint32_t)policy, prio);
+}
+
+/* change nice value */
+extern void sys_nice(idt_regs_t *regs) {
+
+	int inc = (int)regs->ebx;
+
+	if (task_active->policy != TASK_SCHED_NORMAL) RETURN_ERROR(-EINVAL);
+
+	int prio = task_active->prio + MAX(MIN(inc, TASK_NICE_MAX - TASK_NICE_MIN), TASK_NICE_MIN - TASK_NICE_MAX);
+	prio = MAX(MIN(prio, TASK_NICE_MAX), TASK_NICE_MIN);
+
+	regs->eax = (uint32_t)task_setprio(task_active, TASK_SCHED_NORMAL, prio);
+}
@@ -4,6 +4,7 @@
  * SPDX-License-Identifier: BSD-3-Clause
  */
 #include <kernel/types.h>
+#include <kernel/clock.h>
 #include <kernel/panic.h>
 #include <kernel/string.h>
 #include <kernel/users.h>
@@ -12,6 +13,11 @@
 #include <kernel/mm/gdt.h>
 #include <kernel/mm/paging.h>
 #include <kernel/mm/heap.h>
+#include <kernel/mm/slab.h>
+#include <kernel/mm/filemap.h>
+#include <kernel/mm/swap.h>
+#include <kernel/io/cpu.h>
+#include <kernel/driver/lapic.h>
 #include <ec.h>
 #include <kernel/task.h>
 
@@ -27,28 +33,63 @@ static const char *signames[TASK_NSIG] = {
 
 #define KSTACKSZ 32768 /* process kernel stack size */
 
-#define NTICKS 5
+#define SLICE_NS 5000000 /* time slice of the highest levels */
+#define BOOST_NS 1000000000 /* interval between resetting normal tasks to their base level */
+#define POLL_NS 1000000 /* retry interval for tasks waiting outside of wait queues */
 
+/* pit tick, only used without a local apic */
 #define FREQ 1193
 static const uint64_t FREQ_HZ = PIT_FREQ(FREQ);
 
 task_t *ktask = NULL;
-task_t *task_active = NULL;
 
 /* task lists */
-struct task_list {
-	task_t *first; /* first item in list */
-	task_t *last; /* last item in list */
-} lists[TASK_NSTATES];
-
-static struct task_list *ready = &lists[TASK_READY];
-static struct task_list *paused = &lists[TASK_PAUSED];
-static struct task_list *sleeping = &lists[TASK_SLEEPING];
+struct task_list lists[TASK_NSTATES];
+
+/*
+ * Ready tasks wait in one run queue per priority level, the lowest
+ * non-empty queue runs first. Real-time tasks sit in the top queues
+ * at a fixed level. Normal tasks start at a level picked by their nice
+ * value, drop a level each time they use up a time slice and climb back
+ * when they block early, so interactive tasks stay ahead of CPU hogs.
+ * Slices get longer further down, and every BOOST_NS all normal tasks
+ * go back to their base level so nothing starves.
+ *
+ * Every cpu has its own set of run queues. Woken tasks go back to the
+ * cpu they last ran on unless it is busy and another one sits idle, and
+ * a cpu that runs out of work steals the best ready task from the cpu
+ * with the most tasks waiting. The kernel idle loop stays on the boot
+ * processor, application processors have an idle task of their own that
+ * never enters a run queue.
+ */
+static struct {
+	struct task_list queues[TASK_NQUEUES];
+	uint32_t map; /* queues with tasks */
+	uint32_t count; /* tasks queued */
+} runqs[SMP_MAXCPUS];
+static uint64_t boosttime = BOOST_NS; /* time of next priority boost */
+
 static struct task_list *terminated = &lists[TASK_TERMINATED];
 static struct task_list *signaled = &lists[TASK_SIGNALED];
-static struct task_list *pwaiting = &lists[TASK_PWAIT];
 
-static uint64_t timens = 0; /* time in nanoseconds */
+/*
+ * Tasks waiting to acquire a node sit on the wait queue of the node and
+ * are woken when it is released. File systems can also be busy below the
+ * node level (the file system or disk is in use), those waiters go to a
+ * shared queue that every release and, as a fallback for holds taken
+ * outside of task_acquire, the clock polls every POLL_NS.
+ */
+static struct task_list busy;
+
+/*
+ * With a local apic every cpu programs its timer in one-shot mode for its
+ * next event instead of taking a periodic tick: the end of the time slice
+ * when something else could run, and on the boot processor the earliest
+ * kernel timer. Idle cpus are not woken at all. Time is read from the
+ * clock, so this needs a time stamp counter.
+ */
+static bool tickless = false; /* local apic timers instead of the pit */
+static uint64_t nextevent = UINT64_MAX; /* time the boot processor timer fires */
 
 /* task map */
 #define NTASKS 128
@@ -60,11 +101,14 @@ static struct {
 } pagedirs[NTASKS]; /* per-task memory space */
 static int taskres[NTASKS]; /* task result codes */
 
-/* lock counters */
-static uint32_t nlockcli = 0;
+static kmem_cache_t *task_cache = NULL; /* task control block cache */
+static page_frame_id_t zero_frame = 0; /* shared read-only zero page */
 
-uint32_t task_nlockpost = 0;
-uint32_t task_postponed = 0; /* postponed task switches */
+/* swap clock hand */
+static struct {
+	uint32_t id; /* task being scanned */
+	page_id_t page; /* next page to look at */
+} swap_hand = {1, 0};
 
 extern uint32_t kernel_stack_top; /* top of .bss kernel stack */
 
@@ -96,55 +140,472 @@ static void task_move_to_list(struct task_list *dest, struct task_list *src, tas
 	task_add_to_list(dest, task);
 }
 
+/* get run queue for task priority */
+static uint32_t task_level(task_t *task) {
+
+	if (task->policy == TASK_SCHED_RT) return (uint32_t)(TASK_NRTPRIO - task->prio);
+
+	/* nice values spread over the upper half of the levels */
+	uint32_t base = (uint32_t)(task->prio - TASK_NICE_MIN) * (TASK_NLEVELS / 2) / (TASK_NICE_MAX - TASK_NICE_MIN + 1);
+	return TASK_NRTPRIO + MIN(base + task->ndecay, TASK_NLEVELS - 1);
+}
+
+/* get time slice in nanoseconds */
+static uint64_t task_quantum(task_t *task) {
+
+	if (task->policy == TASK_SCHED_RT) return SLICE_NS;
+	return (uint64_t)SLICE_NS << ((task->level - TASK_NRTPRIO) / 2);
+}
+
+/* add task to run queue of its cpu, at the front if it was preempted */
+static void runq_add(task_t *task, bool front) {
+
+	struct task_list *list = &runqs[task->cpu].queues[task->level];
+	if (front && list->first) {
+
+		task->prev = NULL;
+		task->next = list->first;
+		list->first->prev = task;
+		list->first = task;
+	}
+	else task_add_to_list(list, task);
+
+	runqs[task->cpu].map |= 1 << task->level;
+	runqs[task->cpu].count++;
+}
+
+/* remove task from run queue of its cpu */
+static void runq_remove(task_t *task) {
+
+	struct task_list *list = &runqs[task->cpu].queues[task->level];
+	task_remove_from_list(list, task);
+	if (!list->first) runqs[task->cpu].map &= ~(1 << task->level);
+	runqs[task->cpu].count--;
+}
+
+/* get number of queued tasks other cpus could take */
+static uint32_t runq_movable(uint32_t id) {
+
+	uint32_t count = runqs[id].count;
+	if (ktask && ktask->state == TASK_READY && ktask->cpu == id) count--;
+	return count;
+}
+
+/* check if cpu only runs and has queued idle work */
+static bool task_cpu_idle(uint32_t id) {
+
+	cpu_t *cpu = smp_get_cpu(id);
+	return (cpu->task == cpu->idle || cpu->task == ktask) && !runq_movable(id);
+}
+
+/* remove task from list of its state */
+static void task_dequeue(task_t *task) {
+
+	if (task->state == TASK_READY) runq_remove(task);
+	else task_remove_from_list(task->waitq, task);
+	task->waitq = NULL;
+}
+
+/* move task to run queue of its current priority */
+static void task_requeue(task_t *task) {
+
+	uint32_t level = task_level(task);
+	if (level == task->level) return;
+
+	if (task->state == TASK_READY) {
+
+		runq_remove(task);
+		task->level = level;
+		runq_add(task, false);
+	}
+	else task->level = level;
+}
+
+/* check if a task in a higher run queue than the active task of cpu is ready */
+static bool task_should_preempt(uint32_t id) {
+
+	if (!runqs[id].map) return false;
+
+	/* idle loops yield to anything, they might not have a timer running */
+	task_t *active = smp_get_cpu(id)->task;
+	uint32_t level = (uint32_t)__builtin_ctz(runqs[id].map);
+	return active == smp_get_cpu(id)->idle || active == ktask || level < active->level;
+}
+
+/* switch away from active task if a task in a higher run queue is ready */
+static void task_preempt(void) {
+
+	cpu_t *cpu = smp_cpu();
+	if (!task_should_preempt(cpu->id)) return;
+
+	/* switching with nested locks would hand them to the next task */
+	if (cpu->nlockcli > 1 && !cpu->nlockpost) cpu->preempt = true;
+	else task_schedule();
+}
+
+/* pick cpu for a task that becomes ready */
+static uint32_t task_place(task_t *task) {
+
+	/* the kernel idle loop belongs to the boot processor */
+	if (task == ktask) return 0;
+
+	/* stay with a warm cache unless another cpu has nothing to do */
+	if (task_cpu_idle(task->cpu)) return task->cpu;
+
+	for (uint32_t i = 0; i < smp_ncpus; i++) {
+		if (task_cpu_idle(i)) return i;
+	}
+	return task->cpu;
+}
+
+/* queue task on a cpu and get that cpu to look at it */
+static void task_ready(task_t *task) {
+
+	task->cpu = task_place(task);
+	task->state = TASK_READY;
+	runq_add(task, false);
+
+	if (task->cpu == smp_cpu()->id) task_preempt();
+	else if (task_should_preempt(task->cpu)) smp_send_resched(task->cpu);
+}
+
+/* move the best ready task of the busiest other cpu to cpu */
+static bool task_steal(cpu_t *cpu) {
+
+	uint32_t victim = cpu->id, most = 0;
+	for (uint32_t i = 0; i < smp_ncpus; i++) {
+
+		uint32_t n = runq_movable(i);
+		if (i != cpu->id && n > most) {
+
+			victim = i;
+			most = n;
+		}
+	}
+	if (!most) return false;
+
+	/* highest run queue first, the kernel idle loop stays where it is */
+	for (uint32_t map = runqs[victim].map; map; map &= map - 1) {
+		for (task_t *task = runqs[victim].queues[__builtin_ctz(map)].first; task; task = task->next) {
+
+			if (task == ktask) continue;
+
+			runq_remove(task);
+			task->cpu = cpu->id;
+			runq_add(task, false);
+			return true;
+		}
+	}
+	return false;
+}
+
+/* reset normal tasks to their base level */
+static void task_boost(void) {
+
+	for (uint32_t i = 0; i < NTASKS; i++) {
+
+		task_t *task = taskmap[i];
+		if (!task || !task->ndecay) continue;
+
+		task->ndecay = 0;
+		task_requeue(task);
+	}
+}
+
+/* count frames mapped into (n > 0) or out of task */
+extern void task_account(task_t *task, page_id_t p, int n) {
+
+	task->mem.nresident += (uint32_t)n;
+	if (p >= TASK_STACK_START && p < TASK_STACK_END) task->mem.nstack += (uint32_t)n;
+}
+
 /* cpu exception isr */
 static void task_isr(idt_regs_t *regs) {
 	
 	task_raise(TASK_SIGSEGV);
 
 	/* wait until the signal is handled completely */
-	while (!task_active->sigdone) asm volatile("hlt");
+	while (!task_active->sigdone) smp_halt();
 }
 
-/* pit irq */
-static void task_irq(idt_regs_t *regs) {
+/* check if page is reserved by current task but mapped on demand */
+static bool task_is_reserved(page_id_t p) {
 
-	task_lockpost();
-	idt_send_eoi();
+	if (task_active == ktask) return false;
 
-	timens += 1000000000 / FREQ_HZ;
+	if (p >= TASK_STACK_START && p < TASK_STACK_END) return true;
+	if (p >= TASK_PROG_START && p < ALIGN(task_active->brkp, 0x1000) >> 12) return true;
+	return false;
+}
 
-	/* wake up sleepers */
-	task_t *cur = sleeping->first;
-	while (cur) {
+/* map zeroed frame to page */
+static bool task_map_zeroed(page_id_t p) {
 
-		task_t *next = cur->next;
+	page_frame_id_t fr = page_frame_alloc_zeroed();
+	if (!fr) return false;
+
+	page_map_flags(p, fr, PAGE_FLAG_US);
+	task_account(task_active, p, 1);
+	return true;
+}
 
-		if (timens >= cur->waketime) {
+/* give page a private copy of a shared frame */
+static bool task_copy_on_write(page_id_t p) {
 
-			cur->waketime = 0;
-			task_unblock(cur);
+	page_frame_id_t fr = page_get_frame(p);
+
+	/* last reference (a copy left in swap goes stale) */
+	if (page_frame_get_refcnt(fr) <= 1) {
+
+		page_frame_set_swap(fr, 0);
+		page_map_flags(p, fr, PAGE_FLAG_US);
+		return true;
+	}
+
+	page_frame_id_t nfr = page_frame_alloc();
+	if (!nfr) return false;
+
+	memcpy(page_map_temp(nfr), PAGE_ADDR(p), PAGE_SIZE);
+	page_unmap_temp();
+
+	page_map_flags(p, nfr, PAGE_FLAG_US);
+	page_frame_unref(fr);
+	return true;
+}
+
+/* map cached file page */
+static bool task_map_file(vma_t *vma, page_id_t p) {
+
+	page_frame_id_t fr = filemap_get(vma->file, vma->offset + (p - vma->start));
+	if (!fr) return false;
+
+	/* private pages are copied on the first write */
+	page_frame_ref(fr);
+	page_map_readonly(p, fr, PAGE_FLAG_US | ((vma->flags & ECM_MAP_PRIVATE)? PAGE_FLAG_COW: 0));
+	task_account(task_active, p, 1);
+	return true;
+}
+
+/* handle fault in mapped area */
+static bool task_vma_fault(vma_t *vma, page_id_t p, uint32_t err) {
+
+	bool write = err & PAGE_FAULT_W;
+
+	/* protection */
+	if (!(vma->prot & (ECM_PROT_READ | ECM_PROT_WRITE | ECM_PROT_EXEC))) return false;
+	if (write && !(vma->prot & ECM_PROT_WRITE)) return false;
+
+	if (err & PAGE_FAULT_P) {
+
+		if (!write) return false;
+
+		/* write enabled again by mprotect */
+		if (vma->flags & ECM_MAP_SHARED) {
+
+			page_map_flags(p, page_get_frame(p), PAGE_FLAG_US);
+			return true;
 		}
 
-		cur = next;
+		/* first write to the zero page or a shared frame */
+		if (page_get_frame(p) == zero_frame) return task_map_zeroed(p);
+		if (page_table[p] & PAGE_FLAG_COW) return task_copy_on_write(p);
+		return false;
 	}
 
-	/* wake up paused tasks */
-	cur = paused->first;
-	while (cur) {
+	/* first access */
+	if (vma->type == VMA_FILE) return task_map_file(vma, p);
 
-		task_t *next = cur->next;
+	/* shared anonymous pages always get their own frame so that forked tasks see writes */
+	if (!write && !(vma->flags & ECM_MAP_SHARED)) {
 
-		if (cur->res && !fs_isheld(cur->res)) {
+		page_map_readonly(p, zero_frame, PAGE_FLAG_US);
+		return true;
+	}
+	if (!task_map_zeroed(p)) return false;
 
-			cur->res->held = true;
-			task_unblock(cur);
+	if (!(vma->prot & ECM_PROT_WRITE)) page_map_readonly(p, page_get_frame(p), PAGE_FLAG_US);
+	return true;
+}
+
+/* read swapped out page back in */
+static bool task_swap_in(page_id_t p, uint32_t err) {
+
+	vma_t *vma = vma_find(task_active->vmas, p);
+	if (vma && !(vma->prot & (ECM_PROT_READ | ECM_PROT_WRITE | ECM_PROT_EXEC))) return false;
+
+	bool writable = !vma || (vma->prot & ECM_PROT_WRITE);
+	if ((err & PAGE_FAULT_W) && !writable) return false;
+
+	page_frame_id_t fr = page_frame_alloc();
+	if (!fr) return false;
+
+	uint32_t slot = page_get_swap(p);
+	swap_read(slot, fr);
+
+	task_account(task_active, p, 1);
+	task_active->mem.nswapped--;
+	task_active->mem.nmajfaults++;
+
+	/* the slot reference of the entry goes away with a write */
+	if (err & PAGE_FAULT_W) {
+
+		page_map_flags(p, fr, PAGE_FLAG_US);
+		swap_put(slot);
+		return true;
+	}
+
+	/* otherwise the frame keeps it, so it can be dropped again without writing it out */
+	page_frame_set_swap(fr, slot);
+	page_map_readonly(p, fr, PAGE_FLAG_US | (writable? PAGE_FLAG_COW: 0));
+	return true;
+}
+
+/* page fault isr */
+static void task_pgfault(idt_regs_t *regs) {
+
+	uint32_t addr;
+	asm volatile("mov %%cr2, %0": "=r"(addr));
+	page_id_t p = addr >> 12;
+
+	if (task_active != ktask) {
+
+		task_active->mem.nfaults++;
+
+		/* swapped out page */
+		if (!(regs->err_code & PAGE_FAULT_P) && page_get_swap(p)) {
+
+			if (task_swap_in(p, regs->err_code)) return;
+			task_isr(regs);
+			return;
 		}
 
-		cur = next;
+		/* mapped area */
+		vma_t *vma = vma_find(task_active->vmas, p);
+		if (vma && vma->type != VMA_DEVICE) {
+
+			if (task_vma_fault(vma, p, regs->err_code)) return;
+			task_isr(regs);
+			return;
+		}
+
+		/* write to shared frame */
+		if ((regs->err_code & (PAGE_FAULT_P | PAGE_FAULT_W)) == (PAGE_FAULT_P | PAGE_FAULT_W) &&
+		    (page_table[p] & PAGE_FLAG_COW)) {
+
+			if (task_copy_on_write(p)) return;
+		}
+	}
+
+	if (task_is_reserved(p)) {
+
+		/* first access (reads share the zero page) */
+		if (!(regs->err_code & PAGE_FAULT_P)) {
+
+			if (!(regs->err_code & PAGE_FAULT_W)) {
+
+				page_map_readonly(p, zero_frame, PAGE_FLAG_US);
+				return;
+			}
+			if (task_map_zeroed(p)) return;
+		}
+
+		/* first write to the zero page */
+		else if ((regs->err_code & PAGE_FAULT_W) && page_get_frame(p) == zero_frame) {
+
+			if (task_map_zeroed(p)) return;
+		}
 	}
 
+	task_isr(regs);
+}
+
+/* wake task when its sleep or wait runs out */
+static void task_timeout(timer_t *timer) {
+
+	task_t *task = (task_t *)timer->data;
+
+	if (task->state == TASK_PWAIT) task->wstatus = ECW_TIMEOUT;
+	if (task->state == TASK_PWAIT || task->state == TASK_SLEEPING) task_unblock(task);
+}
+
+/* check if a task waits in any run queue */
+static bool task_queued(void) {
+
+	for (uint32_t i = 0; i < smp_ncpus; i++) {
+		if (runqs[i].count) return true;
+	}
+	return false;
+}
+
+/* charge time since the last charge to the active task */
+static void task_timer_charge(cpu_t *cpu) {
+
+	if (!tickless) return;
+
+	uint64_t now = clock_ns();
+	uint64_t ns = now - cpu->since;
+	cpu->since = now;
+
+	cpu->task->slice -= MIN(ns, cpu->task->slice);
+}
+
+/* program timer of running cpu for the next event while task runs (interrupts locked) */
+static void task_timer_arm(cpu_t *cpu, task_t *task) {
+
+	if (!tickless) return;
+	task_timer_charge(cpu);
+
+	/* idle loops only need a time slice when something waits behind them */
+	uint64_t next = UINT64_MAX;
+	if (task != cpu->idle && (task != ktask || runqs[cpu->id].map)) next = task->slice;
+
+	if (!cpu->id) {
+
+		/* kernel timers, polling for tasks outside of wait queues and priority boosts */
+		uint64_t now = cpu->since;
+		uint64_t deadline = timer_next();
+		if (deadline != UINT64_MAX) next = MIN(next, deadline > now? deadline - now: 0);
+		if (busy.first || signaled->first) next = MIN(next, POLL_NS);
+		if (task_queued()) next = MIN(next, boosttime > now? boosttime - now: 0);
+
+		nextevent = next == UINT64_MAX? UINT64_MAX: now + next;
+	}
+
+	if (next == UINT64_MAX) lapic_timer_stop();
+	else lapic_timer_set(next);
+}
+
+/* get the boot processor timer to fire no later than when (interrupts locked) */
+extern void task_timer_kick(uint64_t when) {
+
+	if (!tickless || when >= nextevent) return;
+
+	cpu_t *cpu = smp_cpu();
+	if (cpu->id) smp_send_resched(0);
+	else task_timer_arm(cpu, cpu->task);
+}
+
+/* end time slice of active task if it ran out (task switches locked) */
+static void task_slice(void) {
+
+	cpu_t *cpu = smp_cpu();
+	if (!cpu->task->slice) task_schedule();
+	else task_timer_arm(cpu, cpu->task);
+}
+
+/* work done when the clock advances (boot processor) */
+static void task_clock(void) {
+
+	uint64_t now = clock_ns();
+
+	/* wake up sleepers and timed out waits */
+	timer_run(now);
+
+	/* retry file systems busy outside of task_acquire */
+	if (busy.first) task_wake_all(&busy);
+
 	/* wake up signaled tasks */
-	cur = signaled->first;
+	task_t *cur = signaled->first;
 	while (cur) {
 
 		task_t *next = cur->next;
@@ -153,62 +614,94 @@ static void task_irq(idt_regs_t *regs) {
 		cur = next;
 	}
 
-	/* wake up tasks waiting on other tasks */
-	cur = pwaiting->first;
-	while (cur) {
+	/* keep cpu hogs from starving */
+	if (now >= boosttime) {
 
-		task_t *next = cur->next;
+		boosttime = now + BOOST_NS;
+		task_boost();
+	}
+}
 
-		if (cur->waketime && timens >= cur->waketime) {
+/* deliver pending signal of active task */
+static void task_check_signal(idt_regs_t *regs) {
 
-			cur->waketime = 0;
-			cur->wstatus = ECW_TIMEOUT;
-			task_unblock(cur);
-		}
-		else {
+	if (!task_active->sig) return;
 
-			task_t *wtask = task_get(cur->pwait);
-			if (!wtask || wtask->state == TASK_TERMINATED) {
+	task_lockcli();
 
-				int res = (cur->pwait < 0 || cur->pwait >= NTASKS)? 0: taskres[cur->pwait];
-				cur->wstatus = res | ECW_EXITED;
-				task_unblock(cur);
-			}
-		}
-		cur = next;
+	uint32_t sig = task_active->sig;
+	task_active->sig = 0;
+
+	task_sig_t sigh = task_active->sigh[sig];
+	if (!sigh) {
+
+		kprintf(LOG_WARNING, "[task] Signal %d received (%s, task %d); Aborting...", (int)sig, signames[sig], (int)task_active->id);
+
+		task_unlockcli();
+		task_terminate();
 	}
 
-	/* end of time slice */
-	if (!task_active->nticks || !--task_active->nticks)
-		task_schedule();
+	*TASK_STACK_ADDR_SIGHANDLER = (uint32_t)sigh;
+	*TASK_STACK_ADDR_SIGEIP = regs->eip;
+
+	regs->eip = (uint32_t)TASK_SIGH_ADDR;
+
+	task_active->sigdone = true;
+	task_unlockcli();
+}
+
+/* pit irq (without a local apic) */
+static void task_irq(idt_regs_t *regs) {
+
+	task_lockpost();
+	idt_send_eoi();
+
+	/* a last tick can arrive after switching to the local apic timer */
+	if (tickless) {
+
+		task_unlockpost();
+		return;
+	}
+
+	uint64_t ns = 1000000000 / FREQ_HZ;
+	clock_advance(ns);
+	task_active->slice -= MIN(ns, task_active->slice);
 
+	task_clock();
+	task_slice();
 	task_unlockpost();
 
-	/* task was signaled */
-	if (task_active->sig) {
+	task_check_signal(regs);
+}
 
-		task_lockcli();
+/* local apic timer */
+static void task_timer_irq(idt_regs_t *regs) {
 
-		uint32_t sig = task_active->sig;
-		task_active->sig = 0;
+	task_lockpost();
+	lapic_eoi();
 
-		task_sig_t sigh = task_active->sigh[sig];
-		if (!sigh) {
+	cpu_t *cpu = smp_cpu();
+	task_timer_charge(cpu);
+	if (!cpu->id) task_clock();
 
-			kprintf(LOG_WARNING, "[task] Signal %d received (%s, task %d); Aborting...", (int)sig, signames[sig], (int)task_active->id);
+	task_slice();
+	task_unlockpost();
 
-			task_unlockcli();
-			task_terminate();
-		}
+	task_check_signal(regs);
+}
 
-		*TASK_STACK_ADDR_SIGHANDLER = (uint32_t)sigh;
-		*TASK_STACK_ADDR_SIGEIP = regs->eip;
+/* run queue or clock deadlines changed by another cpu */
+static void task_ipi_resched(idt_regs_t *regs) {
 
-		regs->eip = (uint32_t)TASK_SIGH_ADDR;
+	task_lockpost();
+	lapic_eoi();
 
-		task_active->sigdone = true;
-		task_unlockcli();
-	}
+	cpu_t *cpu = smp_cpu();
+	task_timer_arm(cpu, cpu->task);
+	task_preempt();
+	task_unlockpost();
+
+	task_check_signal(regs);
 }
 
 /* allocate necessary memory before heap */
@@ -225,18 +718,31 @@ extern void task_init_memory(void) {
 /* initialize multitasking */
 extern void task_init(void) {
 
+	task_cache = kmem_cache_create("task", sizeof(task_t), NULL);
+	task_switch_tsc = cpu_has_feature(CPU_FEATURE_TSC);
+	vma_init();
+	timer_init(NTASKS + TIMER_EXTRA); /* every task has a timer */
+
+	/* shared zero page */
+	void *zero = kmalloca(PAGE_SIZE, PAGE_SIZE);
+	memset(zero, 0, PAGE_SIZE);
+	zero_frame = page_get_frame((uint32_t)zero >> 12);
+
 	ktask = task_new(&kernel_stack_top, NULL);
 	ktask->cr3 = page_get_directory();
 	ktask->dir = page_dir_wrap;
+	runq_remove(ktask); /* remove from run queue */
 	ktask->state = TASK_RUNNING;
-	ktask->nticks = NTICKS;
-	task_remove_from_list(ready, ktask); /* remove from ready list */
+	ktask->slice = task_quantum(ktask);
+	task_set_name(ktask, "kernel");
 
-	task_active = ktask;
+	smp_cpu()->task = ktask;
 
 	/* setup isrs */
 	idt_set_isr_callback(IDT_ISR_GPFAULT, task_isr);
-	idt_set_isr_callback(IDT_ISR_PGFAULT, task_isr);
+	idt_set_isr_callback(IDT_ISR_PGFAULT, task_pgfault);
+	idt_set_int_callback(IDT_INT_TIMER, task_timer_irq);
+	idt_set_int_callback(IDT_INT_RESCHED, task_ipi_resched);
 
 	/* setup pit */
 	idt_disable_irq_eoi(PIT_IRQ);
@@ -248,6 +754,29 @@ extern void task_init(void) {
 	pit_set_channel(PIT_CHANNEL0, (FREQ >> 8) & 0xff);
 }
 
+/* switch from the pit tick to one-shot local apic timers */
+extern void task_init_tickless(void) {
+
+	task_lockcli();
+
+	if (!lapic_present() || !clock_has_tsc() || !lapic_timer_init()) {
+
+		task_unlockcli();
+		kprintf(LOG_INFO, "[task] No local APIC timer or time stamp counter, using the PIT tick");
+		return;
+	}
+
+	pit_stop();
+	tickless = true;
+
+	/* application processors arm their timers when they get work */
+	cpu_t *cpu = smp_cpu();
+	cpu->since = clock_ns();
+	lapic_timer_set(0);
+
+	task_unlockcli();
+}
+
 /* create task */
 extern task_t *task_new(void *esp, void *seteip) {
 
@@ -263,7 +792,7 @@ extern task_t *task_new(void *esp, void *seteip) {
 	}
 
 	/* create task */
-	task_t *task = (task_t *)kmalloc(sizeof(task_t));
+	task_t *task = (task_t *)kmem_cache_alloc(task_cache);
 
 	task->ownstack = false;
 	if (!esp) {
@@ -279,8 +808,9 @@ extern task_t *task_new(void *esp, void *seteip) {
 	task->cr3 = NULL;
 	task->dir = NULL;
 	task->state = TASK_READY;
-	task->waketime = 0;
-	task->nticks = NTICKS;
+	task->waitq = NULL;
+	timer_setup(&task->timer, task_timeout, task);
+	task->slice = 0;
 	task->id = id;
 	task->res = NULL;
 	task->sig = 0;
@@ -300,15 +830,25 @@ extern task_t *task_new(void *esp, void *seteip) {
 	task->envp = NULL;
 	task->freeargs = false;
 	task->pwait = 0;
+	task->waiters.first = NULL;
+	task->waiters.last = NULL;
 	task->wstatus = 0;
-	for (uint32_t i = 0; i < TASK_MAXMAPPINGS; i++) {
-		task->mappings[i].used = false;
-		task->mappings[i].start = 0;
-		task->mappings[i].end = 0;
-	}
+	task->vmas = NULL;
 	task->uid = 0;
-
-	task_add_to_list(ready, task);
+	task->forkregs = NULL;
+	task->name[0] = 0;
+	memset(&task->mem, 0, sizeof(task_mem_t));
+
+	/* scheduling class is inherited */
+	task->policy = task_active? task_active->policy: TASK_SCHED_NORMAL;
+	task->prio = task_active? task_active->prio: 0;
+	task->ndecay = 0;
+	task->level = task_level(task);
+
+	/* new tasks go to an idle cpu if there is one */
+	task->cpu = smp_cpu()->id;
+	task->cpu = task_place(task);
+	runq_add(task, false);
 	taskmap[id] = task;
 
 	/* clone page directory */
@@ -326,6 +866,38 @@ extern task_t *task_new(void *esp, void *seteip) {
 		task->esp -= 16;
 	}
 
+	if (task->cpu != smp_cpu()->id) smp_send_resched(task->cpu);
+
+	task_unlockcli();
+	return task;
+}
+
+/* turn running application processor into its idle task (esp is the top of its boot stack) */
+extern task_t *task_new_idle(void *esp) {
+
+	task_lockcli();
+
+	task_t *task = task_new(esp, NULL);
+	if (!task) {
+
+		task_unlockcli();
+		return NULL;
+	}
+
+	/* idle tasks never wait in a run queue and run in the kernel address space */
+	cpu_t *cpu = smp_cpu();
+	runq_remove(task);
+	task->cpu = cpu->id;
+	task->cr3 = ktask->cr3;
+	task->dir = ktask->dir;
+	task->state = TASK_RUNNING;
+	task_set_name(task, "idle");
+
+	cpu->idle = task;
+	cpu->task = task;
+	cpu->dir = ktask->dir;
+	cpu->since = clock_ns();
+
 	task_unlockcli();
 	return task;
 }
@@ -333,117 +905,241 @@ extern task_t *task_new(void *esp, void *seteip) {
 /* schedule next task */
 extern void task_schedule(void) {
 
-	if (task_nlockpost) {
+	cpu_t *cpu = smp_cpu();
+	if (cpu->nlockpost) {
 
-		task_postponed = 1;
+		cpu->postponed = 1;
 		return;
 	}
 
-	/* only schedule if task is available */
-	if (ready->first != NULL) {
+	task_t *active = cpu->task;
+	task_timer_charge(cpu);
+
+	/* idle and blocked cpus look for work elsewhere first */
+	bool idle = active == cpu->idle || active == ktask || active->state != TASK_RUNNING;
+	if (idle && !runq_movable(cpu->id)) task_steal(cpu);
+
+	task_t *next;
+	if (!runqs[cpu->id].map) {
+
+		/* only schedule if task is available, application processors fall back to their idle task */
+		if (active->state == TASK_RUNNING || !cpu->idle) {
+
+			if (!active->slice) active->slice = task_quantum(active);
+			task_timer_arm(cpu, active);
+			return;
+		}
+		next = cpu->idle;
+	}
+	else {
+
+		if (active->state == TASK_RUNNING && active != cpu->idle) {
 
-		task_t *next = ready->first;
-		task_remove_from_list(ready, next);
-		next->state = TASK_RUNNING;
-		next->nticks = NTICKS;
+			/* using up the time slice drops a level */
+			if (!active->slice && active->policy == TASK_SCHED_NORMAL && active->ndecay < TASK_NLEVELS-1) {
 
-		if (task_active->state == TASK_RUNNING) {
+				active->ndecay++;
+				active->level = task_level(active);
+			}
 
-			task_add_to_list(ready, task_active);
-			task_active->state = TASK_READY;
-			task_active->nticks = NTICKS;
+			/* preempted tasks keep their place, except for the idle loop */
+			active->state = TASK_READY;
+			runq_add(active, active->slice && active != ktask);
 		}
 
-		task_switch(next);
+		next = runqs[cpu->id].queues[__builtin_ctz(runqs[cpu->id].map)].first;
+		runq_remove(next);
 	}
+
+	if (active == cpu->idle) active->state = TASK_READY;
+	next->state = TASK_RUNNING;
+	if (!next->slice) next->slice = task_quantum(next);
+	task_timer_arm(cpu, next);
+
+	if (next != active) task_switch(next);
 }
 
-/* lock interrupts */
+/* lock interrupts (an application processor starting up takes the kernel lock here) */
 extern void task_lockcli(void) {
 
 	asm volatile("cli");
-	nlockcli++;
+	smp_lock();
+	smp_cpu()->nlockcli++;
 }
 
 /* unlock interrupts */
 extern void task_unlockcli(void) {
 
-	if (!(--nlockcli))
+	cpu_t *cpu = smp_cpu();
+	if (!(--cpu->nlockcli)) {
+
+		/* run preemption that had to wait for the locks */
+		if (cpu->preempt) {
+
+			cpu->preempt = false;
+			cpu->nlockcli++;
+			task_schedule();
+
+			/* the task may continue on another cpu */
+			cpu = smp_cpu();
+			cpu->nlockcli--;
+		}
 		asm volatile("sti");
+	}
 }
 
 /* get number of locks */
 extern uint32_t task_getlockcli(void) {
 
-	return nlockcli;
+	/* a cpu with interrupts enabled holds none, and the task could move to another one */
+	uint32_t eflags;
+	asm volatile("pushf\n"
+		"pop %0": "=r"(eflags));
+	return (eflags & CPU_EFLAGS_IF)? 0: smp_cpu()->nlockcli;
 }
 
 /* lock task switches */
 extern void task_lockpost(void) {
 
 	asm volatile("cli");
-	nlockcli++;
-	task_nlockpost++;
+	smp_lock();
+
+	cpu_t *cpu = smp_cpu();
+	cpu->nlockcli++;
+	cpu->nlockpost++;
 }
 
 /* unlock task switches */
 extern void task_unlockpost(void) {
 
-	if (!(--task_nlockpost) && task_postponed) {
+	cpu_t *cpu = smp_cpu();
+	if (!(--cpu->nlockpost) && cpu->postponed) {
 
-		task_postponed = 0;
+		cpu->postponed = 0;
 		task_schedule();
+		cpu = smp_cpu();
 	}
 
-	if (!(--nlockcli))
-		asm volatile("sti");
+	if (!(--cpu->nlockcli)) asm volatile("sti");
 }
 
-/* block current task */
-extern void task_block(uint32_t reason) {
+/* block current task on list (interrupts locked by caller) */
+static void task_block_locked(struct task_list *list, uint32_t reason) {
 
-	task_lockcli();
+	/* blocking early climbs a level */
+	if (task_active->ndecay && task_active->slice > task_quantum(task_active) / 2) {
+
+		task_active->ndecay--;
+		task_active->level = task_level(task_active);
+	}
+	task_active->slice = 0;
 
 	task_active->state = reason;
-	task_add_to_list(&lists[reason], task_active);
+	task_active->waitq = list;
+	task_add_to_list(list, task_active);
 	task_schedule();
+}
 
+/* block current task */
+extern void task_block(uint32_t reason) {
+
+	task_lockcli();
+	task_block_locked(&lists[reason], reason);
 	task_unlockcli();
 }
 
+/* block current task on list until woken or deadline (interrupts locked by caller) */
+static int task_block_until(struct task_list *list, uint32_t reason, uint64_t deadline) {
+
+	/* the lock keeps the timer from running out before the task is blocked */
+	int res = deadline == UINT64_MAX? 0: timer_add(&task_active->timer, deadline);
+	if (!res) task_block_locked(list, reason);
+
+	timer_cancel(&task_active->timer);
+	return res;
+}
+
 /* unblock task */
 extern void task_unblock(task_t *task) {
 
-	if (task == task_active || task->state == TASK_READY)
+	/* running covers tasks active on other cpus */
+	if (task == task_active || task->state == TASK_READY || task->state == TASK_RUNNING)
 		return;
 
 	task_lockcli();
 
-	task_t *first = ready->first;
-	
-	task_remove_from_list(&lists[task->state], task);
-	task->state = TASK_READY;
-	task_add_to_list(ready, task);
+	task_dequeue(task);
+	task_ready(task);
 
-	if (!first) task_schedule();
+	task_unlockcli();
+}
+
+/* unblock all tasks on wait queue */
+extern void task_wake_all(waitq_t *wq) {
+
+	task_lockcli();
+
+	task_t *cur = wq->first;
+	while (cur) {
+
+		task_t *next = cur->next;
+		task_unblock(cur);
+		cur = next;
+	}
+
+	task_unlockcli();
+}
+
+/* set scheduling class and priority */
+extern int task_setprio(task_t *task, uint32_t policy, int prio) {
+
+	if (policy == TASK_SCHED_NORMAL) {
+		if (prio < TASK_NICE_MIN || prio > TASK_NICE_MAX) return -EINVAL;
+	}
+	else if (policy == TASK_SCHED_RT) {
+		if (prio < 1 || prio > TASK_NRTPRIO) return -EINVAL;
+	}
+	else return -EINVAL;
+
+	/* only root raises priorities or touches other users' tasks */
+	if (task_active->uid) {
+
+		if (task->uid != task_active->uid) return -EPERM;
+		if (policy == TASK_SCHED_RT || (task->policy == TASK_SCHED_NORMAL && prio < task->prio)) return -EPERM;
+	}
+
+	task_lockcli();
+
+	if (policy != task->policy) task->ndecay = 0;
+	task->policy = policy;
+	task->prio = prio;
+
+	if (task->state == TASK_RUNNING) task->level = task_level(task);
+	else task_requeue(task);
+
+	task_preempt();
+	if (task->state == TASK_READY && task->cpu != smp_cpu()->id && task_should_preempt(task->cpu))
+		smp_send_resched(task->cpu);
 
 	task_unlockcli();
+	return 0;
 }
 
 /* sleep in nanoseconds until */
 extern void task_nano_sleep_until(uint64_t waketime) {
 
-	if (waketime < timens)
+	if (waketime < task_get_global_time())
 		return;
 
-	task_active->waketime = waketime;
-	task_block(TASK_SLEEPING);
+	task_lockcli();
+	(void)task_block_until(&lists[TASK_SLEEPING], TASK_SLEEPING, waketime);
+	task_unlockcli();
 }
 
 /* sleep in nanoseconds */
 extern void task_nano_sleep(uint64_t ns) {
 
-	task_nano_sleep_until(timens + ns);
+	task_nano_sleep_until(task_get_global_time() + ns);
 }
 
 /* sleep in seconds */
@@ -452,25 +1148,51 @@ extern void task_sleep(uint32_t s) {
 	task_nano_sleep((uint64_t)s * 1000000000);
 }
 
+/* remove mapped area of current task */
+static void task_unmap(vma_t *vma) {
+
+	for (page_id_t p = vma->start; p < vma->end; p++) {
+
+		/* skip missing tables */
+		if (!page_dir_wrap[p >> 10]) {
+
+			p |= 0x3ff;
+			continue;
+		}
+
+		/* device frames are not owned by the task */
+		page_frame_id_t f = page_get_frame(p);
+		if (vma->type != VMA_DEVICE && f && f != zero_frame) {
+
+			page_frame_unref(f);
+			task_account(task_active, p, -1);
+		}
+		else if (!f && page_get_swap(p)) task_active->mem.nswapped--;
+		page_unmap(p);
+	}
+
+	if (vma->type == VMA_DEVICE) task_active->mem.ndevice -= vma->end - vma->start;
+	if (vma->file) fs_close(vma->file);
+	vma_remove(&task_active->vmas, vma);
+	vma_free(vma);
+}
+
 /* free pages used by current task */
 extern void task_free(void) {
 
 	task_lockcli();
+	page_begin();
 
-	/* unmap mappings */
-	for (uint32_t i = 0; i < TASK_MAXMAPPINGS; i++) {
-		if (task_active->mappings[i].used) {
-			for (uint32_t j = task_active->mappings[i].start; j < task_active->mappings[i].end; j++)
-				page_unmap(j);
-		}
-	}
+	/* unmap areas */
+	while (task_active->vmas) task_unmap(task_active->vmas);
 
 	/* free frames */
 	uint32_t brkp = ALIGN(task_active->brkp, 0x1000) >> 12;
 	for (uint32_t i = 0; i < brkp; i++) {
 
 		page_frame_id_t f = page_get_frame(i);
-		if (f) page_frame_free(f);
+		if (f && f != zero_frame) page_frame_unref(f);
+		else if (page_get_swap(i)) page_unmap(i);
 	}
 
 	/* fun fact: the lack of this block of code was the cause of a memory leak */
@@ -479,7 +1201,16 @@ extern void task_free(void) {
 
 		page_frame_id_t f = page_get_table_frame(i);
 		if (f) page_frame_free(f);
+		page_dir_wrap[i] = 0; /* keep the swap clock out of freed tables */
 	}
+	for (uint32_t i = TASK_MMAP_START >> 10; i < TASK_MMAP_END >> 10; i++) {
+
+		page_frame_id_t f = page_get_table_frame(i);
+		if (f) page_frame_free(f);
+		page_dir_wrap[i] = 0; /* keep the swap clock out of freed tables */
+	}
+	page_commit();
+	page_flush();
 
 	/* close files */
 	for (int i = 0; i < TASK_MAXFILES; i++) {
@@ -488,6 +1219,12 @@ extern void task_free(void) {
 			(void)task_fs_close(i);
 	}
 
+	/* fault counts stay for the record */
+	task_active->mem.nresident = 0;
+	task_active->mem.nstack = 0;
+	task_active->mem.ndevice = 0;
+	task_active->mem.nswapped = 0;
+
 	task_unlockcli();
 }
 
@@ -496,6 +1233,14 @@ extern void task_terminate(void) {
 
 	taskres[task_active->id] = task_active->load.res & 0xff;
 	task_free();
+
+	/* hand the result to waiting tasks */
+	task_lockcli();
+	for (task_t *cur = task_active->waiters.first; cur; cur = cur->next)
+		cur->wstatus = taskres[task_active->id] | ECW_EXITED;
+	task_wake_all(&task_active->waiters);
+	task_unlockcli();
+
 	task_block(TASK_TERMINATED);
 }
 
@@ -512,9 +1257,10 @@ extern void task_cleanup(void) {
 
 			/* free stack and other resources */
 			taskmap[task->id] = NULL;
+			timer_cancel(&task->timer);
 
 			if (task->ownstack) kfree(task->esp0-KSTACKSZ);
-			kfree(task);
+			kmem_cache_free(task_cache, task);
 		}
 		task_unlockcli();
 	}
@@ -526,19 +1272,23 @@ extern void task_acquire(fs_node_t *node) {
 	task_lockcli();
 	task_active->res = node;
 
-	/* other task held */
-	if (fs_isheld(node)) {
+	/* the releasing task wakes us up */
+	while (fs_isheld(node)) {
 
-		task_unlockcli();
-		task_block(TASK_PAUSED);
-	}
+		/* the busy queue also needs polling, holds can be taken outside of task_acquire */
+		if (!node->held) task_timer_kick(task_get_global_time() + POLL_NS);
+		task_block_locked(node->held? &node->waiters: &busy, TASK_PAUSED);
 
-	/* available */
-	else {
+		/* a signal interrupted the wait */
+		if (task_active->stale) {
 
-		node->held = true;
-		task_unlockcli();
+			task_unlockcli();
+			return;
+		}
 	}
+
+	node->held = true;
+	task_unlockcli();
 }
 
 /* release held resource */
@@ -548,15 +1298,31 @@ extern void task_release(void) {
 		return;
 
 	task_lockcli();
-	task_active->res->held = false;
+
+	fs_node_t *node = task_active->res;
+	node->held = false;
 	task_active->res = NULL;
+
+	task_wake_all(&node->waiters);
+	task_wake_all(&busy);
+
 	task_unlockcli();
 }
 
+/* check if a task is waiting for resource */
+extern bool task_res_waiting(fs_node_t *node) {
+
+	if (node->waiters.first) return true;
+	for (task_t *cur = busy.first; cur; cur = cur->next) {
+		if (cur->res == node) return true;
+	}
+	return false;
+}
+
 /* get time for all tasks */
 extern uint64_t task_get_global_time(void) {
 
-	return timens;
+	return clock_ns();
 }
 
 /* generic task entry point */
@@ -564,22 +1330,24 @@ extern void task_entry(void) {
 
 	task_unlockcli();
 
-	/* map user stack */
-	for (uint32_t i = TASK_STACK_START; i < TASK_STACK_END; i++)
-		page_map_flags(i, page_frame_alloc(), PAGE_FLAG_US);
-
-	void *stack = TASK_STACK_ADDR;
-	memset(stack, 0, TASK_STACK_SIZE);
-	stack += TASK_STACK_SIZE;
-
-	gdt_tss.esp0 = (uint32_t)task_active->esp0;
+	/* user stack is mapped on demand */
+	void *stack = TASK_STACK_ADDR + TASK_STACK_SIZE;
 
 	/* copy task_handle_signal function to be able to run it in userspace */
-	for (uint32_t i = TASK_SIGH_START; i < TASK_SIGH_END; i++)
+	for (uint32_t i = TASK_SIGH_START; i < TASK_SIGH_END; i++) {
+
 		page_map_flags(i, page_frame_alloc(), PAGE_FLAG_US);
+		task_account(task_active, i, 1);
+	}
 
 	memcpy(TASK_SIGH_ADDR, task_handle_signal, task_handle_signal_size);
 
+	/* time page is shared by all tasks (the kernel keeps a reference of its own) */
+	task_lockcli();
+	page_frame_id_t timefr = clock_get_page_frame();
+	if (timefr && page_frame_ref(timefr)) page_map_readonly(TASK_TIME_START, timefr, PAGE_FLAG_US);
+	task_unlockcli();
+
 	/* copy arguments and environment */
 	if (task_active->argv && task_active->envp) {
 
@@ -606,8 +1374,11 @@ extern void task_entry(void) {
 
 		/* allocate memory for environment */
 		size_t npages = ALIGN(size, 0x1000) >> 12;
-		for (uint32_t j = TASK_ENV_START; j < TASK_ENV_START+npages; j++)
+		for (uint32_t j = TASK_ENV_START; j < TASK_ENV_START+npages; j++) {
+
 			page_map_flags(j, page_frame_alloc(), PAGE_FLAG_US);
+			task_account(task_active, j, 1);
+		}
 
 		/* copy data */
 		const char **ptr = (const char **)TASK_ENV_ADDR;
@@ -649,7 +1420,9 @@ extern void task_entry(void) {
 		}
 	}
 
-	/* go to user mode */
+	/* go to user mode, leaving the kernel lock behind */
+	asm volatile("cli");
+	smp_unlock();
 	asm volatile(
 		"cli\n"
 		"mov %0, %%esp\n"
@@ -672,9 +1445,14 @@ extern void task_entry(void) {
 /* raise signal on current task */
 extern void task_raise(uint32_t sig) {
 
+	task_lockcli();
+
 	task_active->sig = sig;
 	task_active->sigdone = false;
-	task_block(TASK_SIGNALED);
+	task_timer_kick(task_get_global_time() + POLL_NS);
+	task_block_locked(signaled, TASK_SIGNALED);
+
+	task_unlockcli();
 }
 
 /* raise signal on other task */
@@ -688,9 +1466,15 @@ extern void task_signal(task_t *task, uint32_t sig) {
 
 	task_lockcli();
 
-	task_remove_from_list(&lists[task->state], task);
-	task->state = TASK_SIGNALED;
-	task_add_to_list(signaled, task);
+	/* tasks running on other cpus get the signal with their next timer interrupt */
+	if (task->state != TASK_RUNNING) {
+
+		task_dequeue(task);
+		task->state = TASK_SIGNALED;
+		task->waitq = signaled;
+		task_add_to_list(signaled, task);
+		task_timer_kick(task_get_global_time() + POLL_NS);
+	}
 
 	task->stale = true;
 	task->sigdone = false;
@@ -707,6 +1491,26 @@ extern task_t *task_get(int id) {
 	return taskmap[id];
 }
 
+/* get task with the lowest id from id on */
+extern task_t *task_get_next(int id) {
+
+	for (; id >= 0 && id < NTASKS; id++) {
+		if (taskmap[id]) return taskmap[id];
+	}
+	return NULL;
+}
+
+/* name task after executable */
+extern void task_set_name(task_t *task, const char *path) {
+
+	const char *name = path;
+	for (const char *c = path; (c = strchr(c, '/')); c++)
+		name = c+1;
+
+	strncpy(task->name, name, TASK_NAMESZ-1);
+	task->name[TASK_NAMESZ-1] = 0;
+}
+
 /* increment or decrement breakpoint */
 extern void *task_sbrk(intptr_t inc) {
 
@@ -723,32 +1527,25 @@ extern void *task_sbrk(intptr_t inc) {
 	
 	uint32_t obrkp = task_active->brkp;
 
-	/* allocate pages */
-	if (brkp > obrkp) {
-
-		uint32_t start = ALIGN(obrkp, 0x1000) >> 12;
-		uint32_t end = ALIGN(brkp, 0x1000) >> 12;
-
-		for (uint32_t i = start; i < end; i++) {
-			if (!page_is_mapped(i))
-				page_map_flags(i, page_frame_alloc(), PAGE_FLAG_US);
-		}
-	}
-
-	/* free pages */
-	else {
+	/* free pages (new pages are mapped on demand) */
+	if (brkp < obrkp) {
 
 		uint32_t start = ALIGN(brkp, 0x1000) >> 12;
 		uint32_t end = ALIGN(obrkp, 0x1000) >> 12;
 
+		page_begin();
 		for (uint32_t i = start; i < end; i++) {
 
 			page_frame_id_t fr = page_get_frame(i);
-			if (fr) {
-				page_frame_free(fr);
-				page_unmap(i);
+			if (fr && fr != zero_frame) {
+
+				page_frame_unref(fr);
+				task_account(task_active, i, -1);
 			}
+			else if (!fr && page_get_swap(i)) task_active->mem.nswapped--;
+			page_unmap(i);
 		}
+		page_commit();
 	}
 
 	task_active->brkp = brkp;
@@ -770,61 +1567,444 @@ extern int task_pwait(int pid, uint64_t timeout) {
 	}
 	task_active->pwait = pid;
 	task_active->wstatus = 0;
-	task_active->waketime = timeout + timens;
-	task_unlockcli();
-	
 	task_active->stale = false;
-	task_block(TASK_PWAIT);
+
+	/* the task wakes its waiters when it terminates */
+	int res = task_block_until(&task->waiters, TASK_PWAIT, timeout + task_get_global_time());
+	task_unlockcli();
+
+	if (res < 0) return res;
 	if (task_active->stale) return -EINTR;
 
 	return task_active->wstatus;
 }
 
-/* make special memory mapping for task */
-extern int task_mmap(page_id_t area, page_frame_id_t start, page_frame_id_t count) {
+/* entry point of forked task */
+static void task_fork_entry(void) {
+
+	task_unlockcli();
+
+	/* fork failed */
+	if (!task_active->forkregs) task_terminate();
+
+	idt_regs_t regs = *task_active->forkregs;
 
 	task_lockcli();
-	int mapping = -1;
+	kfree(task_active->forkregs);
+	task_active->forkregs = NULL;
+	task_unlockcli();
 
-	/* determine mapping to use */
-	for (int i = 0; i < TASK_MAXMAPPINGS; i++) {
-		if (task_active->mappings[i].used) {
+	/* the kernel stack in the tss was set by task_switch */
+	asm volatile("cli");
+	smp_unlock();
+	task_resume_user(&regs);
+}
 
-			/* check if area overlaps */
-			if ((area >= task_active->mappings[i].start && area < task_active->mappings[i].end) ||
-			    (area+count >= task_active->mappings[i].start && area+count < task_active->mappings[i].end)) {
+/* share user page table with forked task */
+static bool task_fork_table(task_t *task, page_id_t pt) {
 
-				task_unlockcli();
-				return -EINVAL;
-			}
+	page_frame_id_t fr = page_frame_alloc();
+	if (!fr) return false;
+
+	page_tab_entry_t *tab = (page_tab_entry_t *)page_map_temp(fr);
+	for (page_id_t i = 0; i < 1024; i++) {
+
+		page_id_t p = pt*1024 + i;
+		page_tab_entry_t ent = page_table[p];
+		page_frame_id_t f = ent >> 12;
+		if (!(ent & PAGE_FLAG_P)) {
+
+			if (PAGE_IS_SWAPPED(ent)) swap_dup(PAGE_SWAP_SLOT(ent));
+			tab[i] = ent;
+			continue;
+		}
+
+		/* device memory and the zero page are shared as is */
+		vma_t *vma = vma_find(task_active->vmas, p);
+		if (f == zero_frame || (vma && vma->type == VMA_DEVICE)) {
+
+			tab[i] = ent;
+			continue;
+		}
+		page_frame_ref(f);
+
+		/* both tasks copy the frame on the next write, unless the area is shared */
+		if ((ent & PAGE_FLAG_RW) && !(vma && (vma->flags & ECM_MAP_SHARED))) {
+
+			ent = (ent & ~PAGE_FLAG_RW) | PAGE_FLAG_COW;
+			page_table[p] = ent;
 		}
-		else if (mapping < 0) mapping = i;
+		tab[i] = ent;
+	}
+	page_unmap_temp();
+
+	task->dir[pt] = PAGE_ENT(fr) | PAGE_FLAG_P | PAGE_FLAG_RW | PAGE_FLAG_US;
+	return true;
+}
+
+/* clone current task copy-on-write */
+extern int task_fork(idt_regs_t *regs) {
+
+	if (!page_frame_can_share()) return -ENOSYS;
+
+	task_lockcli();
+
+	idt_regs_t *forkregs = (idt_regs_t *)kmalloc(sizeof(idt_regs_t));
+	if (!forkregs) {
+
+		task_unlockcli();
+		return -ENOMEM;
 	}
-	if (mapping < 0) {
 
+	task_t *task = task_new(NULL, task_fork_entry);
+	if (!task) {
+
+		kfree(forkregs);
 		task_unlockcli();
-		return -ENOBUFS;
+		return -EAGAIN;
 	}
 
-	/* map memory */
-	task_active->mappings[mapping].used = true;
-	task_active->mappings[mapping].start = area;
-	task_active->mappings[mapping].end = area+count;
+	/* share address space */
+	task->brkp = task_active->brkp;
+	if (task_active->vmas && !(task->vmas = vma_clone(task_active->vmas))) {
 
+		kfree(forkregs);
+		task_unlockcli();
+		return -ENOMEM;
+	}
+	for (vma_t *vma = vma_first(task->vmas); vma; vma = vma_next(task->vmas, vma)) {
+		if (vma->file) fs_open(vma->file, vma->file->oflags);
+	}
+
+	uint32_t ntables = ALIGN(task_active->brkp, 0x400000) >> 22;
+	for (page_id_t pt = 0; pt < (TASK_MMAP_END >> 10); pt++) {
+
+		/* skip gap between break point and mapped areas */
+		if (pt == ntables) pt = TASK_MMAP_START >> 10;
+
+		/* child frees what it got and exits */
+		/* 4M pages only hold device memory */
+		if (page_dir_wrap[pt] & PAGE_FLAG_PS) {
+
+			task->dir[pt] = page_dir_wrap[pt];
+			continue;
+		}
+
+		if (page_dir_wrap[pt] && !task_fork_table(task, pt)) {
+
+			page_flush();
+			kfree(forkregs);
+			task_unlockcli();
+			return -ENOMEM;
+		}
+	}
+	page_flush();
+
+	/* child returns zero */
+	*forkregs = *regs;
+	forkregs->eax = 0;
+	task->forkregs = forkregs;
+
+	/* copy task state */
+	for (uint32_t i = 0; i < TASK_NSIG; i++)
+		task->sigh[i] = task_active->sigh[i];
+	for (uint32_t i = 0; i < TASK_MAXFILES; i++) {
+
+		fs_node_t *node = task_active->files[i].file;
+		if (!node) continue;
+
+		fs_open(node, node->oflags);
+		task->files[i] = task_active->files[i];
+	}
+
+	task->entp = task_active->entp;
+	task->uid = task_active->uid;
+
+	/* the child starts out with the same pages */
+	memcpy(task->name, task_active->name, TASK_NAMESZ);
+	task->mem = task_active->mem;
+	task->mem.nfaults = 0;
+	task->mem.nmajfaults = 0;
+
+	task_unlockcli();
+	return (int)task->id;
+}
+
+/* make special memory mapping for task */
+extern int task_mmap(page_id_t area, page_frame_id_t start, page_frame_id_t count) {
+
+	task_lockcli();
+
+	/* check if area overlaps */
+	if (vma_find_overlap(task_active->vmas, area, area+count)) {
+
+		task_unlockcli();
+		return -EINVAL;
+	}
+
+	vma_t *vma = vma_new(area, area+count, VMA_DEVICE);
+	if (!vma) {
+
+		task_unlockcli();
+		return -ENOMEM;
+	}
+	vma->prot = ECM_PROT_READ | ECM_PROT_WRITE;
+	vma->flags = ECM_MAP_SHARED;
+	vma_insert(&task_active->vmas, vma);
+
+	/* map memory */
 	for (page_frame_id_t i = 0; i < count; i++) {
 
+		/* untouched 4M aligned stretches take a single directory entry */
+		if (count - i >= 1024 && task_is_reserved(area+i+1023) && page_map_large(area+i, start+i, PAGE_FLAG_US)) {
+
+			i += 1023;
+			continue;
+		}
+
+		if (page_get_swap(area+i)) {
+
+			page_unmap(area+i);
+			task_active->mem.nswapped--;
+		}
+
 		page_frame_id_t active = page_get_frame(area+i);
-		if (active) {
+		if (active || task_is_reserved(area+i)) {
+
+			if (active && active != zero_frame) {
 
-			page_frame_free(active);
+				page_frame_unref(active);
+				task_account(task_active, area+i, -1);
+			}
 			page_map_flags(area+i, start+i, PAGE_FLAG_US);
 		}
 	}
+	task_active->mem.ndevice += count;
 
 	task_unlockcli();
 	return 0;
 }
 
+/* split mapped area at page */
+static vma_t *task_split(vma_t *vma, page_id_t p) {
+
+	vma_t *upper = vma_split(&task_active->vmas, vma, p);
+	if (upper && upper->file) fs_open(upper->file, upper->file->oflags);
+	return upper;
+}
+
+/* apply protection of area to mapped pages */
+static void task_protect(vma_t *vma) {
+
+	for (page_id_t p = vma->start; p < vma->end; p++) {
+
+		if (!page_dir_wrap[p >> 10]) {
+
+			p |= 0x3ff;
+			continue;
+		}
+
+		page_tab_entry_t ent = page_table[p];
+		if (!(ent & PAGE_FLAG_P)) continue;
+
+		/* no access is done by hiding the page from user mode */
+		page_tab_entry_t nent = ent | PAGE_FLAG_US;
+		if (!(vma->prot & (ECM_PROT_READ | ECM_PROT_WRITE | ECM_PROT_EXEC)))
+			nent &= ~PAGE_FLAG_US;
+
+		/* private pages might be shared by the time write access comes back */
+		if (!(vma->prot & ECM_PROT_WRITE) && (ent & PAGE_FLAG_RW)) {
+
+			nent &= ~PAGE_FLAG_RW;
+			if (vma->flags & ECM_MAP_PRIVATE) nent |= PAGE_FLAG_COW;
+		}
+
+		if (nent != ent) {
+
+			page_table[p] = nent;
+			page_invalidate(p);
+		}
+	}
+}
+
+/* map file or anonymous memory */
+extern intptr_t task_mmap_area(void *addr, size_t len, int prot, int flags, int fd, koff_t offset) {
+
+	if (!len || offset < 0 || offset % PAGE_SIZE || (uint32_t)addr % PAGE_SIZE) return -EINVAL;
+	if (prot & ~(ECM_PROT_READ | ECM_PROT_WRITE | ECM_PROT_EXEC)) return -EINVAL;
+	if (len > (TASK_MMAP_END - TASK_MMAP_START) * PAGE_SIZE) return -ENOMEM;
+
+	/* exactly one of shared or private */
+	int share = flags & (ECM_MAP_SHARED | ECM_MAP_PRIVATE);
+	if (share != ECM_MAP_SHARED && share != ECM_MAP_PRIVATE) return -EINVAL;
+
+	/* shared file mappings are read-only */
+	fs_node_t *node = NULL;
+	if (!(flags & ECM_MAP_ANON)) {
+
+		if (share == ECM_MAP_SHARED && (prot & ECM_PROT_WRITE)) return -ENOTSUP;
+
+		if (fd < 0 || fd >= TASK_MAXFILES || !task_active->files[fd].file)
+			return -EBADF;
+		if (!(task_active->files[fd].flags & FS_READ)) return -EACCES;
+
+		node = task_active->files[fd].file;
+		if (!(node->flags & FS_FILE)) return -ENODEV;
+	}
+
+	/* mapped pages are shared with the file cache and forked tasks */
+	if (!page_frame_can_share()) return -ENOSYS;
+
+	uint32_t count = ALIGN(len, PAGE_SIZE) / PAGE_SIZE;
+
+	task_lockcli();
+
+	/* pick area */
+	page_id_t area = 0;
+	if (flags & ECM_MAP_FIXED) {
+
+		area = (uint32_t)addr >> 12;
+		if (area < TASK_MMAP_START || area + count > TASK_MMAP_END ||
+		    vma_find_overlap(task_active->vmas, area, area + count)) {
+
+			task_unlockcli();
+			return -EINVAL;
+		}
+	}
+	else if (!(area = vma_find_free(task_active->vmas, TASK_MMAP_START, TASK_MMAP_END, count))) {
+
+		task_unlockcli();
+		return -ENOMEM;
+	}
+
+	vma_t *vma = vma_new(area, area + count, node? VMA_FILE: VMA_ANON);
+	if (!vma) {
+
+		task_unlockcli();
+		return -ENOMEM;
+	}
+
+	/* pages are filled in on first access */
+	vma->prot = (uint32_t)prot;
+	vma->flags = (uint32_t)share;
+	vma->file = node;
+	vma->offset = (uint32_t)offset / PAGE_SIZE;
+	vma_insert(&task_active->vmas, vma);
+
+	if (node) fs_open(node, node->oflags);
+
+	task_unlockcli();
+	return (intptr_t)PAGE_ADDR(area);
+}
+
+/* remove memory mappings in range */
+extern int task_munmap(void *addr, size_t len) {
+
+	if (!len || (uint32_t)addr % PAGE_SIZE) return -EINVAL;
+	if ((uint32_t)addr + len < (uint32_t)addr || (uint32_t)addr + len > (uint32_t)PAGE_ADDR(TASK_MMAP_END)) return -EINVAL;
+
+	page_id_t start = (uint32_t)addr >> 12;
+	page_id_t end = start + ALIGN(len, PAGE_SIZE) / PAGE_SIZE;
+
+	task_lockcli();
+
+	/* device memory stays mapped */
+	for (vma_t *vma = vma_find_overlap(task_active->vmas, start, end); vma && vma->start < end; vma = vma_next(task_active->vmas, vma)) {
+		if (vma->type == VMA_DEVICE) {
+
+			task_unlockcli();
+			return -EINVAL;
+		}
+	}
+
+	page_begin();
+
+	vma_t *vma;
+	int res = 0;
+	while ((vma = vma_find_overlap(task_active->vmas, start, end))) {
+
+		/* cut off parts outside of range */
+		if (vma->start < start && !(vma = task_split(vma, start))) {
+
+			res = -ENOMEM;
+			break;
+		}
+		if (vma->end > end && !task_split(vma, end)) {
+
+			res = -ENOMEM;
+			break;
+		}
+		task_unmap(vma);
+	}
+
+	page_commit();
+
+	task_unlockcli();
+	return res;
+}
+
+/* change protection of mapped range */
+extern int task_mprotect(void *addr, size_t len, int prot) {
+
+	if (!len || (uint32_t)addr % PAGE_SIZE) return -EINVAL;
+	if (prot & ~(ECM_PROT_READ | ECM_PROT_WRITE | ECM_PROT_EXEC)) return -EINVAL;
+	if ((uint32_t)addr + len < (uint32_t)addr || (uint32_t)addr + len > (uint32_t)PAGE_ADDR(TASK_MMAP_END)) return -ENOMEM;
+
+	page_id_t start = (uint32_t)addr >> 12;
+	page_id_t end = start + ALIGN(len, PAGE_SIZE) / PAGE_SIZE;
+
+	task_lockcli();
+
+	/* whole range has to be mapped */
+	page_id_t p = start;
+	for (vma_t *vma = vma_find_overlap(task_active->vmas, start, end); vma && vma->start < end; vma = vma_next(task_active->vmas, vma)) {
+
+		if (vma->start > p) break;
+
+		int res = 0;
+		if (vma->type == VMA_DEVICE) res = -EINVAL;
+		else if (vma->type == VMA_FILE && (vma->flags & ECM_MAP_SHARED) && (prot & ECM_PROT_WRITE)) res = -EACCES;
+		if (res) {
+
+			task_unlockcli();
+			return res;
+		}
+		p = vma->end;
+	}
+	if (p < end) {
+
+		task_unlockcli();
+		return -ENOMEM;
+	}
+
+	page_begin();
+
+	int res = 0;
+	vma_t *vma = vma_find_overlap(task_active->vmas, start, end);
+	while (vma && vma->start < end) {
+
+		if (vma->start < start && !(vma = task_split(vma, start))) {
+
+			res = -ENOMEM;
+			break;
+		}
+		if (vma->end > end && !task_split(vma, end)) {
+
+			res = -ENOMEM;
+			break;
+		}
+
+		vma->prot = (uint32_t)prot;
+		task_protect(vma);
+		vma = vma_next(task_active->vmas, vma);
+	}
+
+	page_commit();
+
+	task_unlockcli();
+	return res;
+}
+
 /* set user for task */
 extern int task_setuser(const char *name, const char *pswd) {
 
@@ -893,18 +2073,26 @@ extern int task_fs_open(const char *path, uint32_t flags, uint32_t mask) {
 	const char *fname = NULL;
 	fs_node_t *node = fs_resolve_full(path, &create, &fname);
 
+	/* the shrinker must not free the node before it is held */
+	if (node) fs_node_pin(node);
 	task_unlockcli();
-	if ((create && !(flags & FS_CREATE)) || !node)
+	if (!node) return -ENOENT;
+	if (create && !(flags & FS_CREATE)) {
+
+		fs_node_unpin(node);
 		return -ENOENT;
+	}
 
 	task_active->stale = false;
 	task_acquire(node);
+	fs_node_unpin(node);
 	if (task_active->stale) return -EAGAIN;
 
 	/* create file */
 	if (create && (flags & FS_CREATE)) {
 
 		fs_node_t *next = fs_create(node, fname, FS_FILE, mask);
+		if (next) fs_node_pin(next);
 		task_release();
 
 		if (!next) return -EACCES;
@@ -915,6 +2103,7 @@ extern int task_fs_open(const char *path, uint32_t flags, uint32_t mask) {
 
 		task_active->stale = false;
 		task_acquire(node);
+		fs_node_unpin(node);
 		if (task_active->stale) return -EAGAIN;
 	}
 
@@ -1035,11 +2224,11 @@ extern int task_fs_close(int fd) {
 	fs_node_t *node = task_active->files[fd].file;
 
 	task_active->stale = false;
-	if (!nlockcli) task_acquire(node);
+	if (!task_getlockcli()) task_acquire(node);
 	if (task_active->stale) return -EAGAIN;
 
 	fs_close(node);
-	if (!nlockcli) task_release();
+	if (!task_getlockcli()) task_release();
 
 	task_active->files[fd].file = NULL;
 	return 0;
@@ -1061,3 +2250,106 @@ extern int task_fs_ioctl(int fd, int op, uintptr_t arg) {
 
 	return res;
 }
+
+/* check if page of task can be swapped out */
+static bool task_can_swap(task_t *task, page_id_t p, page_frame_id_t f) {
+
+	/* shared frames would have to be found in every address space */
+	if (f == zero_frame || page_frame_get_refcnt(f) != 1) return false;
+
+	vma_t *vma = vma_find(task->vmas, p);
+	if (vma) return vma->type != VMA_DEVICE && !(vma->flags & ECM_MAP_SHARED);
+
+	if (p >= TASK_STACK_START && p < TASK_STACK_END) return true;
+	return p >= TASK_PROG_START && p < ALIGN(task->brkp, 0x1000) >> 12;
+}
+
+/* get slot holding contents of frame, writing it out if needed */
+static uint32_t task_swap_slot(page_frame_id_t f, page_tab_entry_t ent) {
+
+	/* pages read back in stay clean until they are copied on write */
+	uint32_t slot = page_frame_get_swap(f);
+	if (slot && !(ent & PAGE_FLAG_D) && swap_dup(slot)) return slot;
+	return swap_store(f);
+}
+
+/* swap out up to count pages of user tasks, returns number of frames freed */
+extern uint32_t task_swap_out(uint32_t count) {
+
+	if (!swap_is_active()) return 0;
+
+	/* the window is borrowed for page tables of other tasks */
+	uint32_t flags = cpu_irq_save();
+	page_frame_id_t temp = page_get_temp();
+
+	uint32_t freed = 0;
+	bool flush = false;
+	bool full = false;
+
+	/* the hand passes every task twice before giving up, referenced pages get a second chance */
+	for (uint32_t turns = 0; freed < count && !full && turns <= 2 * NTASKS;) {
+
+		task_t *task = taskmap[swap_hand.id];
+		bool live = task && task->dir && task->state != TASK_TERMINATED;
+
+		/* other cpus would keep using stale translations of their running task */
+		if (live && task != task_active && task->state == TASK_RUNNING) live = false;
+
+		while (live && swap_hand.page < TASK_MMAP_END && freed < count && !full) {
+
+			page_id_t pt = swap_hand.page >> 10;
+			page_dir_entry_t pde = task->dir[pt];
+			if (!(pde & PAGE_FLAG_P) || (pde & PAGE_FLAG_PS)) {
+
+				swap_hand.page = (pt + 1) << 10;
+				continue;
+			}
+
+			page_tab_entry_t *tab = (page_tab_entry_t *)page_map_temp(pde >> 12);
+			for (; swap_hand.page >> 10 == pt && freed < count; swap_hand.page++) {
+
+				page_id_t p = swap_hand.page;
+				page_tab_entry_t ent = tab[p & 0x3ff];
+				if (!(ent & PAGE_FLAG_P)) continue;
+
+				if (ent & PAGE_FLAG_A) {
+
+					tab[p & 0x3ff] = ent & ~PAGE_FLAG_A;
+					if (task == task_active) flush = true;
+					continue;
+				}
+
+				page_frame_id_t f = ent >> 12;
+				if (!task_can_swap(task, p, f)) continue;
+
+				uint32_t slot = task_swap_slot(f, ent);
+				if (!slot) {
+
+					full = true;
+					break;
+				}
+
+				tab[p & 0x3ff] = PAGE_SWAP_ENT(slot);
+				if (task == task_active) flush = true;
+				page_frame_unref(f);
+				task_account(task, p, -1);
+				task->mem.nswapped++;
+				freed++;
+			}
+		}
+
+		/* move on to the next task (the kernel task has no user pages) */
+		if (!live || swap_hand.page >= TASK_MMAP_END) {
+
+			swap_hand.id = swap_hand.id % (NTASKS - 1) + 1;
+			swap_hand.page = 0;
+			turns++;
+		}
+	}
+
+	if (flush) page_flush();
+	if (temp) page_map_temp(temp);
+	else page_unmap_temp();
+	cpu_irq_restore(flags);
+	return freed;
+}
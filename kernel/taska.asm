@@ -6,16 +6,12 @@
 	[global task_switch]
 	[global task_handle_signal]
 	[global task_handle_signal_size]
+	[global task_resume_user]
+	[global task_nswitches]
+	[global task_switch_cycles]
+	[global task_switch_tsc]
 	[global task_test]
 	
-	[extern task_active]
-	[extern task_nlockpost]
-	[extern task_postponed]
-	
-	[extern page_dir_wrap]
-	
-	[extern gdt_tss]
-	
 	struc task
 		.esp0: resd 1
 		.esp: resd 1
@@ -26,6 +22,35 @@
 		.state: resd 1
 	endstruc
 	
+	struc regs
+		.ds: resd 1
+		.edi: resd 1
+		.esi: resd 1
+		.ebp: resd 1
+		.esp: resd 1
+		.ebx: resd 1
+		.edx: resd 1
+		.ecx: resd 1
+		.eax: resd 1
+		.n_int: resd 1
+		.err_code: resd 1
+		.eip: resd 1
+		.cs: resd 1
+		.eflags: resd 1
+		.useresp: resd 1
+		.ss: resd 1
+	endstruc
+	
+	; per-cpu data (gs) ;
+	struc cpu
+		.self: resd 1
+		.task: resd 1
+		.dir: resd 1
+		.tss: resd 1
+		.nlockpost: resd 1
+		.postponed: resd 1
+	endstruc
+	
 	struc tss
 		.prev: resd 1
 		.esp0: resd 1
@@ -36,9 +61,9 @@ section .text
 
 ; switch to task ;
 task_switch:
-	cmp dword[task_nlockpost], 0
+	cmp dword[gs:cpu.nlockpost], 0
 	je .cont
-	mov dword[task_postponed], 1
+	mov dword[gs:cpu.postponed], 1
 	ret
 .cont:
 	push ebx
@@ -46,14 +71,23 @@ task_switch:
 	push edi
 	push ebp
 	
-	mov edi, [task_active]
+	; older cpus have no time stamp counter ;
+	cmp dword[task_switch_tsc], 0
+	je .start
+	rdtsc
+	mov [switch_start], eax
+	mov [switch_start+4], edx
+.start:
+	
+	mov edi, [gs:cpu.task]
 	mov [edi+task.esp], esp
 	
 	mov esi,[esp+(4+1)*4]
-	mov [task_active], esi
+	mov [gs:cpu.task], esi
 	
 	mov eax, [esi+task.esp0]
-	mov [gdt_tss+tss.esp0], eax
+	mov ecx, [gs:cpu.tss]
+	mov [ecx+tss.esp0], eax
 	
 	mov esp, [esi+task.esp]
 	
@@ -64,15 +98,53 @@ task_switch:
 	
 	mov cr3, eax
 	mov eax, [esi+task.dir]
-	mov dword[page_dir_wrap], eax
+	mov [gs:cpu.dir], eax
 .done:
 	pop ebp
 	pop edi
 	pop esi
 	pop ebx
 	
+	; account switch cost (including first touch of new kernel stack) ;
+	cmp dword[task_switch_tsc], 0
+	je .count
+	rdtsc
+	sub eax, [switch_start]
+	sbb edx, [switch_start+4]
+	add [task_switch_cycles], eax
+	adc [task_switch_cycles+4], edx
+.count:
+	add dword[task_nswitches], 1
+	adc dword[task_nswitches+4], 0
+	
 	ret
 
+; return to user mode with saved registers ;
+task_resume_user:
+	cli
+	mov esi, [esp+4]
+	
+	push dword[esi+regs.ss]
+	push dword[esi+regs.useresp]
+	push dword[esi+regs.eflags]
+	push dword[esi+regs.cs]
+	push dword[esi+regs.eip]
+	
+	mov eax, [esi+regs.ds]
+	mov ds, ax
+	mov es, ax
+	mov fs, ax
+	mov gs, ax
+	
+	mov edi, [esi+regs.edi]
+	mov ebp, [esi+regs.ebp]
+	mov ebx, [esi+regs.ebx]
+	mov edx, [esi+regs.edx]
+	mov ecx, [esi+regs.ecx]
+	mov eax, [esi+regs.eax]
+	mov esi, [esi+regs.esi]
+	iret
+
 ; userspace signal handler ;
 %define TASK_STACK_ADDR_SIGHANDLER 0x8000
 %define TASK_STACK_ADDR_SIGEIP 0x8004
@@ -93,3 +165,9 @@ task_test:
 
 section .data
 	task_handle_signal_size dd task_handle_signal.end-task_handle_signal
+	task_nswitches dq 0
+	task_switch_cycles dq 0
+	task_switch_tsc dd 0
+
+section .bss
+	switch_start resq 1
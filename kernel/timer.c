@@ -0,0 +1,153 @@
+/*
+ * Copyright 2025-2026, Elliot Kohlmyer
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <kernel/types.h>
+#include <kernel/panic.h>
+#include <kernel/task.h>
+#include <kernel/timer.h>
+#include <kernel/mm/heap.h>
+#include <errno.h>
+
+/*
+ * Pending timers sit in a binary min-heap ordered by deadline, so a tick
+ * only looks at the timers that ran out and the earliest deadline is
+ * always at the root. Each timer remembers its heap index to be
+ * cancelled without a search.
+ */
+
+static timer_t **heap = NULL;
+static uint32_t count = 0; /* pending timers */
+static uint32_t capacity = 0;
+
+/* place timer at heap index */
+static inline void heap_set(uint32_t i, timer_t *timer) {
+
+	heap[i] = timer;
+	timer->index = i;
+}
+
+/* move timer towards the root */
+static void sift_up(uint32_t i) {
+
+	timer_t *timer = heap[i];
+	while (i) {
+
+		uint32_t parent = (i - 1) / 2;
+		if (heap[parent]->expires <= timer->expires) break;
+
+		heap_set(i, heap[parent]);
+		i = parent;
+	}
+	heap_set(i, timer);
+}
+
+/* move timer towards the leaves */
+static void sift_down(uint32_t i) {
+
+	timer_t *timer = heap[i];
+	while (true) {
+
+		uint32_t child = i * 2 + 1;
+		if (child >= count) break;
+		if (child + 1 < count && heap[child+1]->expires < heap[child]->expires) child++;
+		if (timer->expires <= heap[child]->expires) break;
+
+		heap_set(i, heap[child]);
+		i = child;
+	}
+	heap_set(i, timer);
+}
+
+/* take timer out of heap */
+static void heap_remove(timer_t *timer) {
+
+	uint32_t i = timer->index;
+	timer->index = TIMER_NONE;
+
+	/* fill the hole with the last timer */
+	if (i == --count) return;
+	heap_set(i, heap[count]);
+
+	if (i && heap[(i - 1) / 2]->expires > heap[i]->expires) sift_up(i);
+	else sift_down(i);
+}
+
+/* initialize timers with room for max pending ones */
+extern void timer_init(uint32_t max) {
+
+	heap = (timer_t **)kmalloc(max * sizeof(timer_t *));
+	if (!heap) kpanic(PANIC_CODE_NONE, "Failed to allocate timer heap", NULL);
+	capacity = max;
+}
+
+/* set up inactive timer */
+extern void timer_setup(timer_t *timer, timer_func_t func, void *data) {
+
+	timer->expires = 0;
+	timer->func = func;
+	timer->data = data;
+	timer->index = TIMER_NONE;
+}
+
+/* (re)arm timer */
+extern int timer_add(timer_t *timer, uint64_t expires) {
+
+	task_lockcli();
+
+	if (timer->index != TIMER_NONE) heap_remove(timer);
+
+	/* the heap never grows, callers may have interrupts locked and allocating could reclaim memory */
+	if (count == capacity) {
+
+		task_unlockcli();
+		return -ENOMEM;
+	}
+
+	timer->expires = expires;
+	heap_set(count++, timer);
+	sift_up(timer->index);
+
+	/* a new earliest deadline needs the clock to fire earlier */
+	if (!timer->index) task_timer_kick(expires);
+
+	task_unlockcli();
+	return 0;
+}
+
+/* disarm timer */
+extern bool timer_cancel(timer_t *timer) {
+
+	task_lockcli();
+
+	bool pending = timer->index != TIMER_NONE;
+	if (pending) heap_remove(timer);
+
+	task_unlockcli();
+	return pending;
+}
+
+/* check if timer is armed */
+extern bool timer_pending(timer_t *timer) {
+
+	return timer->index != TIMER_NONE;
+}
+
+/* get earliest deadline */
+extern uint64_t timer_next(void) {
+
+	return count? heap[0]->expires: UINT64_MAX;
+}
+
+/* run expired timers */
+extern void timer_run(uint64_t now) {
+
+	/* callbacks may add timers again */
+	while (count && heap[0]->expires <= now) {
+
+		timer_t *timer = heap[0];
+		heap_remove(timer);
+		timer->func(timer);
+	}
+}
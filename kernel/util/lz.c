@@ -0,0 +1,158 @@
+/*
+ * Copyright 2025-2026, Elliot Kohlmyer
+ *
+ * SPDX-License-Identifier: BSD-3-Clause
+ */
+#include <kernel/types.h>
+#include <kernel/string.h>
+#include <kernel/lz.h>
+
+#define HASHBITS 12
+
+static uint16_t table[1 << HASHBITS]; /* last position of each hashed 4 byte sequence (callers are serialized) */
+
+/* read 4 bytes */
+static inline uint32_t read32(const uint8_t *p) {
+
+	return *(const uint32_t *)p;
+}
+
+/* hash 4 bytes */
+static inline uint32_t hash(uint32_t v) {
+
+	return (v * 2654435761u) >> (32 - HASHBITS);
+}
+
+/* write extra length bytes */
+static uint8_t *put_len(uint8_t *op, size_t len) {
+
+	for (; len >= 255; len -= 255) *op++ = 255;
+	*op++ = (uint8_t)len;
+	return op;
+}
+
+/* read extra length bytes */
+static bool get_len(const uint8_t **ip, const uint8_t *iend, size_t *len) {
+
+	uint8_t b;
+	do {
+		if (*ip >= iend) return false;
+		b = *(*ip)++;
+		*len += b;
+	} while (b == 255);
+	return true;
+}
+
+/* write sequence of literals followed by a match (none if mlen is zero) */
+static uint8_t *put_sequence(uint8_t *op, uint8_t *oend, const uint8_t *lits, size_t nlits, size_t offset, size_t mlen) {
+
+	size_t need = 1 + nlits + nlits / 255 + 1 + (mlen? 2 + mlen / 255 + 1: 0);
+	if (need > (size_t)(oend - op)) return NULL;
+
+	uint8_t *token = op++;
+	*token = (uint8_t)(MIN(nlits, 15) << 4);
+	if (nlits >= 15) op = put_len(op, nlits - 15);
+
+	memcpy(op, lits, nlits);
+	op += nlits;
+
+	if (mlen) {
+
+		*op++ = (uint8_t)(offset & 0xff);
+		*op++ = (uint8_t)(offset >> 8);
+
+		mlen -= LZ_MINMATCH;
+		*token |= (uint8_t)MIN(mlen, 15);
+		if (mlen >= 15) op = put_len(op, mlen - 15);
+	}
+	return op;
+}
+
+/* compress buffer, returns size or 0 if it doesn't fit */
+extern size_t lz_compress(const void *src, size_t len, void *dst, size_t cap) {
+
+	if (len > LZ_MAXLEN) return 0;
+
+	const uint8_t *base = (const uint8_t *)src;
+	const uint8_t *ip = base;
+	const uint8_t *anchor = base;
+	const uint8_t *iend = base + len;
+	uint8_t *op = (uint8_t *)dst;
+	uint8_t *oend = op + cap;
+
+	/* stale entries are caught by comparing the bytes */
+	memset(table, 0, sizeof(table));
+
+	while (ip + LZ_MINMATCH <= iend) {
+
+		uint32_t h = hash(read32(ip));
+		const uint8_t *ref = base + table[h];
+		table[h] = (uint16_t)(ip - base);
+
+		if (ref >= ip || read32(ref) != read32(ip)) {
+
+			ip++;
+			continue;
+		}
+
+		/* extend match (it may run into the bytes it copies) */
+		const uint8_t *mp = ip + LZ_MINMATCH;
+		const uint8_t *rp = ref + LZ_MINMATCH;
+		while (mp < iend && *mp == *rp) {
+
+			mp++;
+			rp++;
+		}
+
+		op = put_sequence(op, oend, anchor, (size_t)(ip - anchor), (size_t)(ip - ref), (size_t)(mp - ip));
+		if (!op) return 0;
+		ip = anchor = mp;
+	}
+
+	/* remaining literals */
+	op = put_sequence(op, oend, anchor, (size_t)(iend - anchor), 0, 0);
+	if (!op) return 0;
+	return (size_t)(op - (uint8_t *)dst);
+}
+
+/* decompress buffer, returns size or 0 if it is corrupt */
+extern size_t lz_decompress(const void *src, size_t len, void *dst, size_t cap) {
+
+	const uint8_t *ip = (const uint8_t *)src;
+	const uint8_t *iend = ip + len;
+	uint8_t *base = (uint8_t *)dst;
+	uint8_t *op = base;
+	uint8_t *oend = op + cap;
+
+	while (ip < iend) {
+
+		uint8_t token = *ip++;
+
+		/* literals */
+		size_t nlits = token >> 4;
+		if (nlits == 15 && !get_len(&ip, iend, &nlits)) return 0;
+		if (nlits > (size_t)(iend - ip) || nlits > (size_t)(oend - op)) return 0;
+
+		memcpy(op, ip, nlits);
+		op += nlits;
+		ip += nlits;
+
+		/* last sequence */
+		if (ip >= iend) break;
+
+		/* match */
+		if (iend - ip < 2) return 0;
+		size_t offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+		ip += 2;
+
+		size_t mlen = token & 0xf;
+		if (mlen == 15 && !get_len(&ip, iend, &mlen)) return 0;
+		mlen += LZ_MINMATCH;
+
+		if (!offset || offset > (size_t)(op - base) || mlen > (size_t)(oend - op)) return 0;
+
+		const uint8_t *ref = op - offset;
+		while (mlen--) *op++ = *ref++;
+	}
+	return (size_t)(op - base);
+}
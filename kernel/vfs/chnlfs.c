@@ -88,7 +88,7 @@ static kssize_t write_fs(fs_node_t *node, uint32_t offset, size_t nbytes, uint8_
 	if (task && task->state == TASK_SLEEPING) {
 
 		task->stale = true;
-		task->waketime = 0;
+		task_unblock(task);
 	}
 	task_unlockcli();
 
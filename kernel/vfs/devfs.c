@@ -12,6 +12,7 @@
 #include <kernel/driver/ata.h>
 #include <kernel/driver/fb.h>
 #include <kernel/driver/pci.h>
+#include <kernel/mm/heap.h>
 #include <kernel/vfs/chnlfs.h>
 #include <kernel/vfs/devfs.h>
 
@@ -68,6 +69,7 @@ extern void devfs_init(void) {
 	if (fb_addr) fb_init_devfs();
 
 	pci_init_devfs();
+	heap_init_devfs();
 
 	/* initialize channel filesystem */
 	chnl = fs_node_new(NULL, FS_DIRECTORY);
@@ -8,16 +8,176 @@
 #include <kernel/string.h>
 #include <kernel/tty.h>
 #include <kernel/mm/heap.h>
+#include <kernel/mm/slab.h>
+#include <kernel/mm/filemap.h>
+#include <kernel/mm/shrink.h>
 #include <kernel/vfs/fs.h>
+#include <kernel/elf.h>
+#include <kernel/task.h>
 
 #define PATHBUFSZ 1024
 static char pathbuf[PATHBUFSZ];
 
 fs_node_t *fs_root; /* root node */
+uint32_t fs_generation = 0; /* bumped whenever cached directory entries are dropped */
+
+/* object caches */
+#define NNODECACHES 4
+
+static kmem_cache_t *dirent_cache = NULL;
+static struct {
+	size_t size; /* node size */
+	kmem_cache_t *cache; /* cache */
+} nodecaches[NNODECACHES];
+
+/* get cache for node size */
+static kmem_cache_t *node_cache(size_t sz) {
+
+	int i = 0;
+	for (; i < NNODECACHES && nodecaches[i].cache; i++) {
+		if (nodecaches[i].size == sz)
+			return nodecaches[i].cache;
+	}
+	if (i >= NNODECACHES) return NULL;
+
+	nodecaches[i].size = sz;
+	nodecaches[i].cache = kmem_cache_create("fs_node", sz, NULL);
+	return nodecaches[i].cache;
+}
+
+/* directories filled from disk, in order of last lookup */
+static fs_node_t *oldest = NULL;
+static fs_node_t *newest = NULL;
+
+static uint32_t cache_scan(uint32_t count);
+static shrinker_t shrinker = {
+	.name = "fs_dirent",
+	.scan = cache_scan,
+};
+
+/* remove directory from lru list */
+static void cache_unlink(fs_node_t *node) {
+
+	if (node != oldest && !node->older) return;
+
+	if (node->older) node->older->newer = node->newer;
+	else oldest = node->newer;
+	if (node->newer) node->newer->older = node->older;
+	else newest = node->older;
+
+	node->older = NULL;
+	node->newer = NULL;
+}
+
+/* mark directory as recently used */
+extern void fs_node_touch(fs_node_t *node) {
+
+	node->atime = task_get_global_time();
+
+	/* only entries that can be read back in again are cached */
+	if (!node->filldir || !node->first || node == newest) return;
+
+	cache_unlink(node);
+	node->older = newest;
+	if (newest) newest->newer = node;
+	else oldest = node;
+	newest = node;
+}
+
+/* keep node from being evicted until it is unpinned */
+extern void fs_node_pin(fs_node_t *node) {
+
+	node->pins++;
+}
+
+/* let node be evicted again */
+extern void fs_node_unpin(fs_node_t *node) {
+
+	if (node->pins) node->pins--;
+}
+
+/* check if entries below directory can be dropped */
+static bool cache_can_evict(fs_node_t *dir, uint64_t before) {
+
+	if (dir->atime > before || dir->pins || fs_isheld(dir) || task_res_waiting(dir)) return false;
+
+	for (fs_dirent_t *dent = dir->first; dent; dent = dent->next) {
+
+		fs_node_t *node = dent->node;
+		if (!node) continue;
+
+		/* open files, mount points, busy nodes and nodes a lookup returned stay */
+		if (node->refcnt || node->pins || node->ptr || fs_isheld(node) || task_res_waiting(node)) return false;
+		if (node->first && !cache_can_evict(node, before)) return false;
+	}
+	return true;
+}
+
+/* drop entries below directory, returns number of objects freed */
+static uint32_t cache_evict(fs_node_t *dir) {
+
+	uint32_t count = 0;
+	fs_dirent_t *dent = dir->first;
+	while (dent) {
+
+		fs_dirent_t *next = dent->next;
+		fs_node_t *node = dent->node;
+		if (node) {
+
+			if (node->first) count += cache_evict(node);
+			fs_node_free(node);
+			count++;
+		}
+		fs_dirent_free(dent);
+		count++;
+
+		dent = next;
+	}
+
+	/* filled in again on the next lookup */
+	dir->first = NULL;
+	dir->last = NULL;
+	cache_unlink(dir);
+	return count;
+}
+
+/* release least recently used directory entries */
+static uint32_t cache_scan(uint32_t count) {
+
+	/* recently used directories are likely to be looked up again */
+	uint64_t now = task_get_global_time();
+	if (now < FS_CACHE_AGE) return 0;
+	uint64_t before = now - FS_CACHE_AGE;
+
+	task_lockcli();
+
+	uint32_t freed = 0;
+	fs_node_t *dir = oldest;
+	while (dir && freed < count && dir->atime <= before) {
+
+		if (!cache_can_evict(dir, before)) {
+
+			dir = dir->newer;
+			continue;
+		}
+		freed += cache_evict(dir);
+		fs_generation++;
+
+		/* newer directories might have been below this one */
+		dir = oldest;
+	}
+
+	task_unlockcli();
+	return freed;
+}
 
 /* initialize vfs */
 extern void fs_init(void) {
 
+	dirent_cache = kmem_cache_create("fs_dirent", sizeof(fs_dirent_t), NULL);
+	(void)node_cache(sizeof(fs_node_t));
+	shrink_register(&shrinker);
+
 	fs_root = fs_node_new(NULL, FS_MOUNTPOINT);
 	fs_root->mask = 0755;
 }
@@ -25,7 +185,8 @@ extern void fs_init(void) {
 /* create new directory entry */
 extern fs_dirent_t *fs_dirent_new(const char *name) {
 
-	fs_dirent_t *dent = (fs_dirent_t *)kmalloc(sizeof(fs_dirent_t));
+	if (!dirent_cache) dirent_cache = kmem_cache_create("fs_dirent", sizeof(fs_dirent_t), NULL);
+	fs_dirent_t *dent = (fs_dirent_t *)kmem_cache_alloc(dirent_cache);
 
 	if (name) strncpy(dent->name, name, FS_NAMESZ);
 	else dent->name[0] = 0;
@@ -36,6 +197,12 @@ extern fs_dirent_t *fs_dirent_new(const char *name) {
 	return dent;
 }
 
+/* free directory entry */
+extern void fs_dirent_free(fs_dirent_t *dent) {
+
+	kmem_cache_free(dirent_cache, dent);
+}
+
 /* create new node */
 extern fs_node_t *fs_node_new(fs_node_t *parent, uint32_t flags) {
 
@@ -45,8 +212,10 @@ extern fs_node_t *fs_node_new(fs_node_t *parent, uint32_t flags) {
 /* create new node with size */
 extern fs_node_t *fs_node_new_ext(fs_node_t *parent, uint32_t flags, size_t sz) {
 
-	fs_node_t *node = (fs_node_t *)kmalloc(sz);
+	kmem_cache_t *cache = node_cache(sz);
+	fs_node_t *node = (fs_node_t *)(cache? kmem_cache_alloc(cache): kmalloc(sz));
 	memset(node, 0, sz);
+	node->objsz = sz;
 	node->flags = flags;
 
 	/* copy file operations and fs specific stuff */
@@ -71,6 +240,18 @@ extern fs_node_t *fs_node_new_ext(fs_node_t *parent, uint32_t flags, size_t sz)
 	return node;
 }
 
+/* free unreferenced node and its cached pages */
+extern void fs_node_free(fs_node_t *node) {
+
+	if (node->text) elf_drop_text(node);
+	if (node->map) filemap_drop(node);
+	cache_unlink(node);
+
+	kmem_cache_t *cache = node_cache(node->objsz);
+	if (cache) kmem_cache_free(cache, node);
+	else kfree(node);
+}
+
 /* add dirent */
 extern void fs_node_add_dirent(fs_node_t *node, fs_dirent_t *dent) {
 
@@ -118,6 +299,8 @@ extern kssize_t fs_read(fs_node_t *node, uint32_t offset, size_t nbytes, uint8_t
 extern kssize_t fs_write(fs_node_t *node, uint32_t offset, size_t nbytes, uint8_t *buf) {
 
 	if (!node->refcnt || !(node->oflags & FS_WRITE) || !node->write) return 0;
+	if (node->text) elf_drop_text(node);
+	if (node->map) filemap_drop(node);
 	return node->write(node, offset, nbytes, buf);
 }
 
@@ -125,6 +308,8 @@ extern kssize_t fs_write(fs_node_t *node, uint32_t offset, size_t nbytes, uint8_
 extern void fs_open(fs_node_t *node, uint32_t flags) {
 
 	if (node->refcnt && node->oflags != flags) return;
+	if ((flags & FS_TRUNCATE) && node->text) elf_drop_text(node);
+	if ((flags & FS_TRUNCATE) && node->map) filemap_drop(node);
 
 	if (node->open) node->open(node, flags);
 	node->oflags = flags;
@@ -138,6 +323,9 @@ extern void fs_close(fs_node_t *node) {
 
 	if (node->close) node->close(node);
 	node->refcnt--;
+
+	/* nobody can map the pages anymore */
+	if (!node->refcnt && node->map) filemap_drop(node);
 }
 
 /* read directory entry */
@@ -146,8 +334,14 @@ extern fs_dirent_t *fs_readdir(fs_node_t *node, uint32_t idx) {
 	if (!node) return NULL;
 	while (node->ptr) node = node->ptr;
 
-	/* fill directory entries (should have . and ..) */
-	if (!node->first) node->filldir(node);
+	/* fill directory entries (should have . and ..), a shrink while filling must skip the directory */
+	if (!node->first) {
+
+		fs_node_pin(node);
+		node->filldir(node);
+		fs_node_unpin(node);
+	}
+	fs_node_touch(node);
 
 	/* dirents */
 	fs_dirent_t *dent = node->first;
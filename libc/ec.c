@@ -12,6 +12,8 @@
 static char pathbuf[EC_PATHSZ];
 static char tempbuf[EC_PATHSZ];
 
+static int sysenter = -1; /* system calls go through sysenter, -1 until checked */
+
 /* fix path */
 static const char *fixpath(const char *path) {
 
@@ -59,8 +61,51 @@ static const char *fixpath(const char *path) {
 	return tempbuf;
 }
 
+/* check if sysenter works (early cpus report it without having it) */
+static int has_sysenter(void) {
+
+	uint32_t eax, ebx, ecx, edx;
+	asm volatile("cpuid": "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx): "a"(1), "c"(0));
+	if (!(edx & 0x800)) return 0;
+
+	/* pentium pro before model 3, stepping 3 */
+	uint32_t family = (eax >> 8) & 0xf, model = (eax >> 4) & 0xf, stepping = eax & 0xf;
+	return !(family == 6 && model < 3 && stepping < 3);
+}
+
+/* system call through sysenter, the kernel returns the second value in esi */
+static uint32_t ec_sysenter(uint32_t i, uint32_t a, uint32_t b, uint32_t c, uint32_t *ret2) {
+
+	uint32_t hi;
+	asm volatile(
+		"push %%ebp\n"
+		"mov %%esp, %%ebp\n"
+		"mov $1f, %%esi\n"
+		"sysenter\n"
+		"1:\n"
+		"pop %%ebp\n"
+		: "+a"(i), "=S"(hi), "+b"(a), "+c"(b), "+d"(c)
+		:
+		: "memory", "cc"
+		);
+	if (ret2) *ret2 = hi;
+	return i;
+}
+
+extern int ec_has_sysenter(void) {
+
+	if (sysenter < 0) sysenter = has_sysenter();
+	return sysenter;
+}
+
 extern uint32_t ec_syscall3(uint32_t i, uint32_t a, uint32_t b, uint32_t c) {
 
+	if (ec_has_sysenter()) return ec_sysenter(i, a, b, c, NULL);
+	return ec_syscall3_int(i, a, b, c);
+}
+
+extern uint32_t ec_syscall3_int(uint32_t i, uint32_t a, uint32_t b, uint32_t c) {
+
 	uint32_t ret = 0;
 	asm volatile(
 		"push %%ebx\n"
@@ -79,6 +124,12 @@ extern uint32_t ec_syscall3(uint32_t i, uint32_t a, uint32_t b, uint32_t c) {
 extern uint64_t ec_syscall3r2(uint32_t i, uint32_t a, uint32_t b, uint32_t c) {
 
 	uint32_t reta = 0, retb = 0;
+	if (ec_has_sysenter()) {
+
+		reta = ec_sysenter(i, a, b, c, &retb);
+		return ((uint64_t)retb << 32) | (uint64_t)reta;
+	}
+
 	asm volatile(
 		"push %%ebx\n"
 		"mov %0, %%eax\n"
@@ -151,14 +202,51 @@ extern void *ec_sbrk(intptr_t inc) {
 	return (void *)ec_syscall3(ECN_SBRK, (uint32_t)inc, 0, 0);
 }
 
+/* read time page, returns nanoseconds since boot */
+static uint64_t timepage_read(uint64_t *wall) {
+
+	const volatile ec_timepage_t *tp = EC_TIME_ADDR;
+	uint32_t seq;
+	uint64_t ns;
+
+	do {
+		while ((seq = tp->seq) & 1);
+
+		ns = tp->ns;
+		if (tp->tsc) {
+
+			uint32_t lo, hi;
+			asm volatile("rdtsc": "=a"(lo), "=d"(hi));
+
+			uint64_t cycles = (((uint64_t)hi << 32) | lo) - tp->tsc_base;
+			uint32_t mult = tp->mult, shift = tp->shift;
+			ns += (((cycles >> 32) * mult) << (32 - shift)) + (((cycles & 0xffffffff) * mult) >> shift);
+		}
+		*wall = tp->wall;
+	} while (tp->seq != seq);
+
+	return ns;
+}
+
 extern int ec_gettimeofday(ec_timeval_t *tv) {
 
-	__ec_seterrno(int, ec_syscall3(ECN_GETTIMEOFDAY, (uint32_t)tv, 0, 0));
+	uint64_t wall;
+	uint64_t ns = timepage_read(&wall);
+	wall += ns;
+
+	tv->sec = wall / 1000000000;
+	tv->nsec = wall % 1000000000;
+	return 0;
 }
 
 extern int ec_timens(ec_timeval_t *tv) {
 
-	__ec_seterrno(int, ec_syscall3(ECN_TIMENS, (uint32_t)tv, 0, 0));
+	uint64_t wall;
+	uint64_t ns = timepage_read(&wall);
+
+	tv->sec = ns / 1000000000;
+	tv->nsec = ns % 1000000000;
+	return 0;
 }
 
 extern int ec_isatty(int fd) {
@@ -218,6 +306,50 @@ extern int ec_setuser(const char *name, const char *pswd) {
 	__ec_seterrno(int, ec_syscall3(ECN_SETUSER, (uint32_t)name, (uint32_t)pswd, 0));
 }
 
+extern int ec_fork(void) {
+
+	__ec_seterrno(int, ec_syscall3(ECN_FORK, 0, 0, 0));
+}
+
+extern void *ec_mmap(void *addr, size_t len, int prot, int flags, int fd, ec_off_t offset) {
+
+	ec_mmap_args_t args = {addr, len, prot, flags, fd, offset};
+	uint32_t res = ec_syscall3(ECN_MMAP, (uint32_t)&args, 0, 0);
+
+	/* addresses never reach the error range */
+	if (res >= (uint32_t)-4095) {
+
+		errno = -(int)res;
+		return ECM_FAILED;
+	}
+	return (void *)res;
+}
+
+extern int ec_munmap(void *addr, size_t len) {
+
+	__ec_seterrno(int, ec_syscall3(ECN_MUNMAP, (uint32_t)addr, (uint32_t)len, 0));
+}
+
+extern int ec_mprotect(void *addr, size_t len, int prot) {
+
+	__ec_seterrno(int, ec_syscall3(ECN_MPROTECT, (uint32_t)addr, (uint32_t)len, (uint32_t)prot));
+}
+
+extern int ec_pinfo(int pid, ec_pinfo_t *info) {
+
+	__ec_seterrno(int, ec_syscall3(ECN_PINFO, (uint32_t)pid, (uint32_t)info, 0));
+}
+
+extern int ec_setprio(int pid, int policy, int prio) {
+
+	__ec_seterrno(int, ec_syscall3(ECN_SETPRIO, (uint32_t)pid, (uint32_t)policy, (uint32_t)prio));
+}
+
+extern int ec_nice(int inc) {
+
+	__ec_seterrno(int, ec_syscall3(ECN_NICE, (uint32_t)inc, 0, 0));
+}
+
 extern int ec_chdir(const char *path) {
 
 	if (!path) {
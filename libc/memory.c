@@ -9,10 +9,13 @@
 #include <errno.h>
 #include <ec.h>
 
+#define MMAP_THRESHOLD 0x20000 /* allocations of this size get their own mapping */
+
 /* memory block */
 struct hblock {
 	size_t size; /* size of block */
 	bool avail; /* is available */
+	bool mapped; /* has its own mapping */
 	struct hblock *prev; /* previous block */
 	struct hblock *next; /* next block */
 };
@@ -26,6 +29,7 @@ extern int __libc_init_heap(void) {
 
 	first->size = 0;
 	first->avail = false;
+	first->mapped = false;
 	first->prev = NULL;
 	first->next = NULL;
 
@@ -56,6 +60,7 @@ static struct hblock *find_block(struct hblock *head, size_t size) {
 
 	l->next->size = 0;
 	l->next->avail = true;
+	l->next->mapped = false;
 	l->next->prev = l;
 	l->next->next = NULL;
 
@@ -71,6 +76,7 @@ static void split_block(struct hblock *block, size_t size) {
 	
 	next->size = block->size - size - sizeof(struct hblock);
 	next->avail = true;
+	next->mapped = false;
 	next->next = block->next;
 	next->prev = block;
 
@@ -116,11 +122,36 @@ static struct hblock *merge_block(struct hblock *block) {
 	return block;
 }
 
+/* allocate block with its own mapping */
+static struct hblock *map_block(size_t size) {
+
+	struct hblock *block = (struct hblock *)ec_mmap(NULL, sizeof(struct hblock) + size,
+		ECM_PROT_READ | ECM_PROT_WRITE, ECM_MAP_PRIVATE | ECM_MAP_ANON, -1, 0);
+	if (block == ECM_FAILED) return NULL;
+
+	block->size = size;
+	block->avail = false;
+	block->mapped = true;
+	block->prev = NULL;
+	block->next = NULL;
+
+	return block;
+}
+
 /* memory allocation functions */
 extern void free(void *ptr) {
 
+	if (!ptr) return;
+
 	struct hblock *block = (struct hblock *)ptr - 1;
 
+	/* large blocks go straight back to the kernel */
+	if (block->mapped) {
+
+		ec_munmap(block, sizeof(struct hblock) + block->size);
+		return;
+	}
+
 	block->avail = true;
 	block = merge_block(block);
 
@@ -135,6 +166,13 @@ extern void *malloc(size_t size) {
 
 	size = EC_ALIGN(size, 4);
 
+	/* fall back to the break point if mappings are not available */
+	if (size >= MMAP_THRESHOLD) {
+
+		struct hblock *block = map_block(size);
+		if (block) return (void *)(block + 1);
+	}
+
 	struct hblock *block = find_block(first, size);
 	if (!block) return NULL;
 
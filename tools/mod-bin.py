@@ -52,10 +52,12 @@ def module():
                 gen_bin('init'),
                 gen_bin('ls'),
                 gen_bin('playsnd', links=('sound',)),
+                gen_bin('ps'),
                 gen_bin('sh'),
                 gen_bin('sleep'),
                 gen_bin('stat'),
                 gen_bin('su'),
+                gen_bin('sysbench'),
                 gen_bin('sysinfo'),
                 gen_bin('touch'),
 
@@ -3,7 +3,8 @@ import enum
 USAGE_STRING="""Kernel Arguments:
     kernel-drivers=<drivers>  Specify a (comma separated) list of optional drivers to include in build:
                                 all (default), bga, uhci, ext2, ac97
-    kernel-debug              Build the kernel with debug symbols"""
+    kernel-debug              Build the kernel with debug symbols
+    kernel-heaptrace          Record the caller of every live kernel heap allocation"""
 
 class Driver(enum.Enum):
     BGA = 0x1
@@ -56,6 +57,8 @@ def module():
 
     debug = pybuild.get_arg('kernel-debug')
     if debug: print('Kernel debug symbols enabled')
+    heaptrace = pybuild.get_arg('kernel-heaptrace')
+    if heaptrace: print('Kernel heap tracing enabled')
 
     return {
         'name': 'kernel',
@@ -68,7 +71,7 @@ def module():
                     'depsdir': 'include/kernel',
 
                     # flags #
-                    'cflags': f'-ffreestanding -Iinclude {" ".join(driver_cflags)}' + (' -g' if debug else ''),
+                    'cflags': f'-ffreestanding -Iinclude {" ".join(driver_cflags)}' + (' -g' if debug else '') + (' -DHEAP_TRACE' if heaptrace else ''),
                     'asmflags': '-f$(ASMARCH)',
                     'ldflags': '-T kernel/linker.ld -ffreestanding -nostdlib -lgcc' + (' -g' if debug else ''),
 
@@ -84,6 +87,7 @@ def module():
                             ('driver/fb.c', 'driver/fb.h'),
                             ('driver/fbcon.c', 'driver/fbcon.h'),
                             ('driver/fbfont.c', 'driver/fbfont.h'),
+                            ('driver/lapic.c', 'driver/lapic.h'),
                             ('driver/pci.c', 'driver/pci.h'),
                             ('driver/pit.c', 'driver/pit.h'),
                             ('driver/ps2.c', 'driver/ps2.h'),
@@ -97,14 +101,22 @@ def module():
                             ('fs/tarfs.c', 'fs/tarfs.h'),
 
                             # architecture io #
+                            ('io/cpu.c', 'io/cpu.h'),
                             ('io/port.c', 'io/port.h'),
 
                             # memory management #
+                            ('mm/filemap.c', 'mm/filemap.h'),
                             ('mm/gdt.c', 'mm/gdt.h'),
                             ('mm/heap.c', 'mm/heap.h'),
                             ('mm/paging.c', 'mm/paging.h'),
+                            ('mm/shrink.c', 'mm/shrink.h'),
+                            ('mm/slab.c', 'mm/slab.h'),
+                            ('mm/swap.c', 'mm/swap.h'),
+                            ('mm/zram.c', 'mm/zram.h'),
+                            ('mm/vma.c', 'mm/vma.h'),
 
                             # utilities #
+                            ('util/lz.c', 'lz.h'),
                             ('util/string.c', 'string.h'),
 
                             # virtual file system #
@@ -115,14 +127,17 @@ def module():
 
                             # general #
                             ('boot.c', 'boot.h'),
+                            ('clock.c', 'clock.h'),
                             ('elf.c', 'elf.h'),
                             ('idt.c', 'idt.h'),
                             ('init.c', 'init.h'),
                             ('main.c'),
                             ('multiboot.c', 'multiboot.h'),
                             ('panic.c', 'panic.h'),
+                            ('smp.c', 'smp.h'),
                             ('syscall.c', 'syscall.h'),
                             ('task.c', 'task.h'),
+                            ('timer.c', 'timer.h'),
                             ('tty.c', 'tty.h'),
                             ('users.c', 'users.h'),
 
@@ -132,6 +147,7 @@ def module():
                     'asm-files': (
                             ('idta.asm', 'idt.h'),
                             ('multiboota.asm', 'multiboot.h'),
+                            ('smpa.asm', 'smp.h'),
                             ('taska.asm', 'task.h'),
                         ),
                 },